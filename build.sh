@@ -15,6 +15,7 @@ GPP="/usr/bin/arm-none-eabi-g++"
     -S. \
     -B./${BUILD_DIR} \
     -G "Unix Makefiles" \
+    "$@" \
 
 STATUS=$?
 if [ $STATUS -ne 0 ]; then
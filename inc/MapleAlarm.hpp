@@ -0,0 +1,117 @@
+#ifndef __MAPLE_ALARM_H__
+#define __MAPLE_ALARM_H__
+
+#include <stdint.h>
+
+//! The timeout alarm of one bus, scheduled in an alarm pool shared by every bus.
+//!
+//! An alarm pool slot stays taken until the alarm's callback returns, and a bus re-arms its alarm
+//! from within that callback (the open line check is followed by the write timeout, a finished
+//! transaction by the next one's open line check). A bus may therefore hold two slots at once, so
+//! the pool needs POOL_SLOTS_PER_BUS slots for each bus. Should the pool still run out, the alarm is
+//! deferred rather than fired: the owner then polls deferredExpired() until the time passes. That
+//! is late by however long the owner takes to poll, but a write still in progress is never cut off.
+//! This is not thread safe on its own; the owner must serialize access.
+//! @tparam Pool  Provides int32_t add(uint64_t timeUs, void* userData), which returns a positive
+//!               id, 0 if the time already passed, or a negative value if no slot is free, and
+//!               void cancel(int32_t id)
+template <typename Pool>
+class MapleAlarm
+{
+    public:
+        //! Number of pool slots to allow for each bus
+        static const uint32_t POOL_SLOTS_PER_BUS = 2;
+
+        //! Outcome of arm()
+        enum Result
+        {
+            //! The alarm fires at the given time
+            RESULT_ARMED = 0,
+            //! The given time already passed, so the alarm was not scheduled
+            RESULT_EXPIRED,
+            //! No slot was free; the time is checked by deferredExpired() instead
+            RESULT_DEFERRED
+        };
+
+        //! Constructor - nothing is scheduled
+        MapleAlarm() :
+            mId(0),
+            mDeferredTimeUs(0)
+        {}
+
+        //! Schedules the alarm, replacing any which is already scheduled
+        //! @param[in] pool  The pool to schedule in
+        //! @param[in] timeUs  The time at which the alarm fires
+        //! @param[in] userData  Passed to the alarm's callback
+        //! @returns whether the alarm was scheduled
+        inline Result arm(Pool& pool, uint64_t timeUs, void* userData)
+        {
+            disarm(pool);
+            Result result = RESULT_ARMED;
+            int32_t id = pool.add(timeUs, userData);
+            if (id > 0)
+            {
+                mId = id;
+            }
+            else if (id == 0)
+            {
+                result = RESULT_EXPIRED;
+            }
+            else
+            {
+                mDeferredTimeUs = timeUs;
+                result = RESULT_DEFERRED;
+            }
+            return result;
+        }
+
+        //! Cancels the alarm if one is scheduled or deferred
+        //! @param[in] pool  The pool the alarm was scheduled in
+        inline void disarm(Pool& pool)
+        {
+            if (mId > 0)
+            {
+                pool.cancel(mId);
+                mId = 0;
+            }
+            mDeferredTimeUs = 0;
+        }
+
+        //! Called from the alarm's callback
+        //! @param[in] id  The alarm which fired
+        //! @returns true iff it is the alarm currently scheduled (not one superseded as it fired)
+        inline bool fired(int32_t id)
+        {
+            bool rv = false;
+            if (id > 0 && id == mId)
+            {
+                mId = 0;
+                rv = true;
+            }
+            return rv;
+        }
+
+        //! @param[in] currentTimeUs  The current time
+        //! @returns true iff a deferred alarm has come due; it is then no longer deferred
+        inline bool deferredExpired(uint64_t currentTimeUs)
+        {
+            bool rv = false;
+            if (mDeferredTimeUs > 0 && currentTimeUs >= mDeferredTimeUs)
+            {
+                mDeferredTimeUs = 0;
+                rv = true;
+            }
+            return rv;
+        }
+
+        //! @returns true iff the alarm is waiting on deferredExpired()
+        inline bool isDeferred() const { return (mDeferredTimeUs > 0); }
+
+    private:
+        //! The scheduled alarm (0 when none is scheduled)
+        int32_t mId;
+        //! When a deferred alarm is due (0 when none is deferred)
+        uint64_t mDeferredTimeUs;
+};
+
+#endif // __MAPLE_ALARM_H__
@@ -0,0 +1,177 @@
+#ifndef __MAPLE_BUFFER_POOL_H__
+#define __MAPLE_BUFFER_POOL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+//! A fixed set of word buffers which busses borrow for the length of a transaction instead of each
+//! owning enough for the largest possible packet. Buffers come in two sizes so that the common case
+//! (controller polls which send 1 word and receive 3) doesn't tie up a buffer big enough for a full
+//! packet. The storage of each size is given by the owner, so its RAM is fixed at link time and may
+//! be placed in whichever memory bank suits; any buffer may be handed to DMA.
+//!
+//! A borrower which finds nothing free may mark itself as waiting. Once any buffer is given back,
+//! every waiting borrower is reported by takeWoken() so that it can try again right away rather
+//! than the next time it happens to look.
+//!
+//! This is not thread safe on its own; every borrow and return must be serialized by the owner.
+//! @tparam SMALL_WORDS  Number of words in each small buffer
+//! @tparam NUM_SMALL  Number of small buffers (no more than 32)
+//! @tparam LARGE_WORDS  Number of words in each large buffer
+//! @tparam NUM_LARGE  Number of large buffers (no more than 32)
+template <uint32_t SMALL_WORDS, uint32_t NUM_SMALL, uint32_t LARGE_WORDS, uint32_t NUM_LARGE>
+class MapleBufferPool
+{
+    public:
+        static_assert(SMALL_WORDS <= LARGE_WORDS, "Small buffers must not be larger than large");
+        static_assert(NUM_SMALL <= 32 && NUM_LARGE <= 32, "Too many buffers to track");
+
+        //! Constructor - every buffer starts out free
+        //! @param[in] small  Storage for the small buffers (must outlive this pool)
+        //! @param[in] large  Storage for the large buffers (must outlive this pool)
+        MapleBufferPool(uint32_t (&small)[NUM_SMALL][SMALL_WORDS],
+                        uint32_t (&large)[NUM_LARGE][LARGE_WORDS]) :
+            mSmall(small),
+            mLarge(large),
+            mSmallFree(allFree(NUM_SMALL)),
+            mLargeFree(allFree(NUM_LARGE)),
+            mWaiting(0),
+            mWoken(0)
+        {}
+
+        //! Borrows the smallest free buffer which can hold the given number of words
+        //! @param[in] numWords  Number of words needed
+        //! @param[out] capacity  Number of words in the returned buffer (0 if none)
+        //! @returns the buffer or NULL if none which is large enough is free
+        uint32_t* borrow(uint32_t numWords, uint32_t& capacity)
+        {
+            uint32_t* buffer = NULL;
+            capacity = 0;
+            if (numWords <= SMALL_WORDS)
+            {
+                buffer = take(mSmallFree, mSmall[0], SMALL_WORDS);
+                capacity = SMALL_WORDS;
+            }
+            if (buffer == NULL && numWords <= LARGE_WORDS)
+            {
+                buffer = take(mLargeFree, mLarge[0], LARGE_WORDS);
+                capacity = LARGE_WORDS;
+            }
+            if (buffer == NULL)
+            {
+                capacity = 0;
+            }
+            return buffer;
+        }
+
+        //! Returns a borrowed buffer to the pool
+        //! @param[in] buffer  A buffer returned by borrow() (NULL is ignored)
+        void giveBack(const uint32_t* buffer)
+        {
+            bool given = true;
+            if (buffer >= mSmall[0] && buffer < mSmall[0] + (NUM_SMALL * SMALL_WORDS))
+            {
+                mSmallFree |= (1U << ((buffer - mSmall[0]) / SMALL_WORDS));
+            }
+            else if (buffer >= mLarge[0] && buffer < mLarge[0] + (NUM_LARGE * LARGE_WORDS))
+            {
+                mLargeFree |= (1U << ((buffer - mLarge[0]) / LARGE_WORDS));
+            }
+            else
+            {
+                given = false;
+            }
+
+            if (given)
+            {
+                mWoken |= mWaiting;
+                mWaiting = 0;
+            }
+        }
+
+        //! Marks a borrower as waiting for a buffer to be given back
+        //! @param[in] borrowerIdx  Index of the borrower (less than 32)
+        inline void markWaiting(uint32_t borrowerIdx)
+        {
+            mWaiting |= (1U << borrowerIdx);
+        }
+
+        //! @returns a mask of the borrowers which were waiting when a buffer was given back (bit n
+        //!          for borrower n); they are no longer reported after this
+        inline uint32_t takeWoken()
+        {
+            uint32_t woken = mWoken;
+            mWoken = 0;
+            return woken;
+        }
+
+        //! @returns the number of small buffers not on loan
+        inline uint32_t getNumFreeSmall() const { return countBits(mSmallFree); }
+
+        //! @returns the number of large buffers not on loan
+        inline uint32_t getNumFreeLarge() const { return countBits(mLargeFree); }
+
+    private:
+        //! @param[in] num  Number of buffers
+        //! @returns a free mask with the given number of buffers marked free
+        static inline uint32_t allFree(uint32_t num)
+        {
+            return (num >= 32) ? 0xFFFFFFFF : ((1U << num) - 1);
+        }
+
+        //! @param[in] mask  A free mask
+        //! @returns the number of buffers marked free in the given mask
+        static inline uint32_t countBits(uint32_t mask)
+        {
+            uint32_t count = 0;
+            for (; mask != 0; mask &= (mask - 1))
+            {
+                ++count;
+            }
+            return count;
+        }
+
+        //! Takes the first free buffer of one size
+        //! @param[in,out] freeMask  Which of the buffers are free
+        //! @param[in] first  The first of the buffers
+        //! @param[in] numWords  Number of words in each buffer
+        //! @returns the buffer taken or NULL if none is free
+        static inline uint32_t* take(uint32_t& freeMask, uint32_t* first, uint32_t numWords)
+        {
+            uint32_t* buffer = NULL;
+            if (freeMask != 0)
+            {
+                uint32_t i = 0;
+                while ((freeMask & (1U << i)) == 0)
+                {
+                    ++i;
+                }
+                freeMask &= ~(1U << i);
+                buffer = first + (i * numWords);
+            }
+            return buffer;
+        }
+
+    private:
+        //! Copy constructor - not implemented
+        MapleBufferPool(const MapleBufferPool&);
+
+        //! Assignment operator - not implemented
+        MapleBufferPool& operator=(const MapleBufferPool&);
+
+    private:
+        //! The small buffers
+        uint32_t (*const mSmall)[SMALL_WORDS];
+        //! The large buffers
+        uint32_t (*const mLarge)[LARGE_WORDS];
+        //! Bit n is set while small buffer n is free
+        uint32_t mSmallFree;
+        //! Bit n is set while large buffer n is free
+        uint32_t mLargeFree;
+        //! Bit n is set while borrower n waits for a buffer to be given back
+        uint32_t mWaiting;
+        //! Bit n is set once a buffer was given back while borrower n waited
+        uint32_t mWoken;
+};
+
+#endif // __MAPLE_BUFFER_POOL_H__
@@ -4,6 +4,9 @@
 #include <stdint.h>
 #include "configuration.h"
 #include "utils.h"
+#include "MapleEncodedPacket.hpp"
+#include "MapleTransaction.hpp"
+#include "MapleTiming.hpp"
 
 //! Maple Bus interface class
 class MapleBusInterface
@@ -28,6 +31,23 @@ class MapleBusInterface
                            bool expectResponse,
                            uint32_t readTimeoutUs=DEFAULT_MAPLE_READ_TIMEOUT_US) = 0;
 
+        //! Writes a command whose payload is gathered from several segments (ex: function code,
+        //! address word, and a pointer to bulk data). Each segment is encoded straight from its own
+        //! storage into the write buffer, so nothing needs to be staged beforehand.
+        //! @param[in] command  The command byte - should be a value in Command enumeration
+        //! @param[in] recipientAddr  The address of the device receiving this command
+        //! @param[in] segments  The payload segments, in order (no more than 255 words in total)
+        //! @param[in] numSegments  Number of segments
+        //! @param[in] expectResponse  Set to true in order to start receive after send is complete
+        //! @param[in] readTimeoutUs  When response is expected, the receive timeout in microseconds
+        //! @returns true iff the bus was "open" and send has started
+        virtual bool write(uint8_t command,
+                           uint8_t recipientAddr,
+                           const MapleCodec::Segment* segments,
+                           uint8_t numSegments,
+                           bool expectResponse,
+                           uint32_t readTimeoutUs=DEFAULT_MAPLE_READ_TIMEOUT_US) = 0;
+
         //! Writes a command with the given custom frame word. The internal sender address is
         //! ignored and instead the given frame word is sent verbatim.
         //! @param[in] frameWord  The first word to put out on the bus
@@ -54,20 +74,60 @@ class MapleBusInterface
                            bool expectResponse,
                            uint32_t readTimeoutUs=DEFAULT_MAPLE_READ_TIMEOUT_US) = 0;
 
-        //! Retrieves the last valid set of data read.
-        //! @param[out] len  The number of words received
+        //! Writes a packet which was encoded ahead of time. No copy is made - the packet's words are
+        //! read directly by DMA, so the packet must not be modified or destroyed until the write
+        //! completes. The same packet may be written on several busses at once.
+        //! @param[in] packet  The encoded packet to send
+        //! @param[in] expectResponse  Set to true in order to start receive after send is complete
+        //! @param[in] readTimeoutUs  When response is expected, the receive timeout in microseconds
+        //! @returns true iff the bus was "open" and send has started
+        virtual bool write(const MapleEncodedPacket& packet,
+                           bool expectResponse,
+                           uint32_t readTimeoutUs=DEFAULT_MAPLE_READ_TIMEOUT_US) = 0;
+
+        //! Queues a transaction. It starts the instant every transaction queued ahead of it has
+        //! completed, which may be before this returns. The observer is notified of the outcome
+        //! from within processEvents().
+        //! @param[in] transaction  The transaction to queue
+        //! @returns true iff the transaction was queued
+        virtual bool submit(const MapleTransaction& transaction) = 0;
+
+        //! Removes all queued transactions for the given observer and ensures that it isn't
+        //! notified of any transaction which is already in progress. This must be called before an
+        //! observer with outstanding transactions is destroyed.
+        //! @param[in] observer  The observer to cancel
+        virtual void cancel(const MapleTransactionObserver* observer) = 0;
+
+        //! Holds the bus for a latency critical transaction which will be submitted at the given
+        //! time. Until then, a bulk transaction which would still be running more than
+        //! MAPLE_MAX_POLL_JITTER_US past that time is held back, but only once - a bulk transaction
+        //! which was already held back for a reservation isn't held back again. The reservation
+        //! ends when a latency critical transaction starts or the time passes.
+        //! @param[in] timeUs  When the latency critical transaction will be submitted
+        virtual void reserve(uint64_t timeUs) = 0;
+
+        //! Retrieves the last valid packet received since the last call.
+        //! @param[out] len  The number of words received (0 if no new data)
         //! @param[out] newData  Set to true iff new data was received since the last call
-        //! @returns a pointer to the bytes read.
-        //! @warning this call should be serialized with calls to write() as those calls may change
-        //!          the data in the underlying buffer which is returned.
+        //! @returns a pointer to the whole packet, which is only valid until the next call (NULL if
+        //!          no new data)
         virtual const uint32_t* getReadData(uint32_t& len, bool& newData) = 0;
 
-        //! Processes timing events for the current time.
+        //! Processes timing events for the current time and notifies observers of any transactions
+        //! which have completed.
         //! @param[in] currentTimeUs  The current time to process for (0 to internally get time)
-        virtual void processEvents(uint64_t currentTimeUs=0) = 0;
+        //! @returns the number of completed transactions which were handed out
+        virtual uint32_t processEvents(uint64_t currentTimeUs=0) = 0;
 
         //! @returns true iff the bus is currently busy reading or writing.
         virtual bool isBusy() = 0;
+
+        //! @param[in] responseLen  Number of payload words expected in the response
+        //! @returns the time to allow for receiving a response of the given length once it starts
+        static constexpr uint32_t readTimeoutUs(uint32_t responseLen)
+        {
+            return MapleBusTiming::readTimeoutUs(responseLen);
+        }
 };
 
 #endif // __MAPLE_BUS_INTERFACE_H__
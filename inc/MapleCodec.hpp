@@ -0,0 +1,179 @@
+#ifndef __MAPLE_CODEC_H__
+#define __MAPLE_CODEC_H__
+
+#include <stdint.h>
+
+//! Encodes and validates Maple Bus frames a whole word at a time.
+//!
+//! The PIO state machines shift words out and in most significant byte first, but the data on the
+//! bus is little endian. Every word therefore needs its byte order swapped on the way out and on
+//! the way in. The CRC is the XOR of every byte in the frame, and since XOR doesn't care about
+//! order, it may be computed by XOR-ing whole words together and folding the result down to 8 bits
+//! only once at the end of the frame.
+class MapleCodec
+{
+    public:
+        //! A run of contiguous source words. A frame's payload may be gathered from several of
+        //! these so that each piece is encoded straight from where it is stored.
+        struct Segment
+        {
+            //! The source words
+            const uint32_t* words;
+            //! Number of words in this segment
+            uint32_t len;
+        };
+
+        //! @param[in] word  The word to swap
+        //! @returns the given word with its byte order reversed (a single REV on Cortex-M0+)
+        static inline uint32_t swapByteOrder(uint32_t word)
+        {
+            return __builtin_bswap32(word);
+        }
+
+        //! Folds a 32-bit XOR accumulator down to the 8-bit Maple Bus CRC
+        //! @param[in] acc  XOR of all words in the frame
+        //! @returns the CRC byte
+        static inline uint8_t foldCrc(uint32_t acc)
+        {
+            acc ^= acc >> 16;
+            acc ^= acc >> 8;
+            return static_cast<uint8_t>(acc);
+        }
+
+        //! @param[in] payloadLen  Number of payload words
+        //! @returns the number of bits the maple_out state machine needs to shift out (frame word,
+        //!          payload, and CRC byte)
+        static constexpr uint32_t numBits(uint32_t payloadLen)
+        {
+            return (payloadLen * 4 + 5) * 8;
+        }
+
+        //! @param[in] payloadLen  Number of payload words
+        //! @returns the number of words in an encoded frame (bit count, frame word, payload, CRC)
+        static inline uint32_t numEncodedWords(uint32_t payloadLen)
+        {
+            return payloadLen + 3;
+        }
+
+        //! @param[in] segments  The segments to count
+        //! @param[in] numSegments  Number of segments
+        //! @returns the total number of words in the given segments
+        static inline uint32_t payloadLen(const Segment* segments, uint32_t numSegments)
+        {
+            uint32_t len = 0;
+            for (uint32_t i = numSegments; i > 0; --i, ++segments)
+            {
+                len += segments->len;
+            }
+            return len;
+        }
+
+        //! Encodes a frame into the format expected by the maple_out state machine.
+        //! @param[out] dest  Where the encoded frame is written (at least payloadLen + 3 words)
+        //! @param[in] frameWord  The frame word (command, recipient, sender, length)
+        //! @param[in] payload  The payload words
+        //! @param[in] payloadLen  Number of words in payload
+        //! @returns the number of words written to dest
+        static inline uint32_t encode(volatile uint32_t* dest,
+                                      uint32_t frameWord,
+                                      const uint32_t* payload,
+                                      uint32_t payloadLen)
+        {
+            // First 32 bits sent to the state machine is how many bits to output
+            dest[0] = numBits(payloadLen);
+            uint32_t acc = frameWord;
+            dest[1] = swapByteOrder(frameWord);
+            volatile uint32_t* pDest = encodeWords(&dest[2], payload, payloadLen, acc);
+            // Last byte left shifted out is the CRC
+            *pDest = static_cast<uint32_t>(foldCrc(acc)) << 24;
+            return numEncodedWords(payloadLen);
+        }
+
+        //! Encodes a frame whose payload is gathered from several segments, in order, without
+        //! first staging them in one place.
+        //! @param[out] dest  Where the encoded frame is written (at least payload length + 3 words)
+        //! @param[in] frameWord  The frame word (its length must be the sum of segment lengths)
+        //! @param[in] segments  The payload segments
+        //! @param[in] numSegments  Number of segments
+        //! @returns the number of words written to dest
+        static inline uint32_t encode(volatile uint32_t* dest,
+                                      uint32_t frameWord,
+                                      const Segment* segments,
+                                      uint32_t numSegments)
+        {
+            uint32_t acc = frameWord;
+            dest[1] = swapByteOrder(frameWord);
+            volatile uint32_t* pDest = &dest[2];
+            for (uint32_t i = numSegments; i > 0; --i, ++segments)
+            {
+                pDest = encodeWords(pDest, segments->words, segments->len, acc);
+            }
+            uint32_t payloadLen = pDest - &dest[2];
+            dest[0] = numBits(payloadLen);
+            *pDest = static_cast<uint32_t>(foldCrc(acc)) << 24;
+            return numEncodedWords(payloadLen);
+        }
+
+        //! Byte swaps the given words into dest while XOR-ing them into a CRC accumulator
+        //! @param[out] dest  Where swapped words are written
+        //! @param[in] src  The source words
+        //! @param[in] len  Number of words
+        //! @param[in,out] acc  The CRC accumulator
+        //! @returns the position in dest following the last word written
+        static inline volatile uint32_t* encodeWords(volatile uint32_t* dest,
+                                                     const uint32_t* src,
+                                                     uint32_t len,
+                                                     uint32_t& acc)
+        {
+            for (uint32_t i = len; i > 0; --i)
+            {
+                uint32_t word = *src++;
+                acc ^= word;
+                *dest++ = swapByteOrder(word);
+            }
+            return dest;
+        }
+
+        //! Validates a frame received by the maple_in state machine and writes out its words in
+        //! host byte order. dest and src may point to the same buffer to decode in place.
+        //! @param[out] dest  Where the frame word and payload are written
+        //! @param[in] src  The words as received (frame word, payload, CRC word)
+        //! @param[in] maxWords  Number of words which may be read from src
+        //! @param[out] len  Number of words written to dest, including the frame word
+        //! @returns true iff the frame is complete and its CRC is valid
+        static inline bool decode(uint32_t* dest,
+                                  const volatile uint32_t* src,
+                                  uint32_t maxWords,
+                                  uint32_t& len)
+        {
+            len = 0;
+            if (maxWords < 2 || src[0] == 0)
+            {
+                // Nothing received (command 0 is invalid)
+                return false;
+            }
+            // The first byte received is the LSB of the frame word which holds the number of words
+            // proceeding it
+            uint32_t numWords = (src[0] >> 24) + 1;
+            if (numWords + 1 > maxWords)
+            {
+                return false;
+            }
+            uint32_t acc = 0;
+            for (uint32_t i = 0; i < numWords; ++i)
+            {
+                uint32_t word = swapByteOrder(src[i]);
+                acc ^= word;
+                dest[i] = word;
+            }
+            // The CRC byte is shifted into the bottom of the last word, so it doesn't need swapping
+            if (foldCrc(acc) != src[numWords])
+            {
+                return false;
+            }
+            len = numWords;
+            return true;
+        }
+};
+
+#endif // __MAPLE_CODEC_H__
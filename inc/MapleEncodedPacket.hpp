@@ -0,0 +1,179 @@
+#ifndef __MAPLE_ENCODED_PACKET_H__
+#define __MAPLE_ENCODED_PACKET_H__
+
+#include <stdint.h>
+#include <string.h>
+#include "MapleCodec.hpp"
+#include "MaplePacket.hpp"
+
+//! A Maple Bus packet which is encoded once and may then be written any number of times.
+//!
+//! The encoded words (bit count, byte swapped frame word and payload, CRC) are exactly what the
+//! maple_out state machine consumes, so a bus hands them to DMA without copying. The bus only ever
+//! reads the words, so the same packet may be in flight on several busses at once. The storage must
+//! not be modified or destroyed while any write which uses it is in progress.
+class MapleEncodedPacket
+{
+    public:
+        //! Constructor - the packet starts out empty
+        //! @param[in] storage  Where the encoded words are kept (at least maxPayloadLen + 3 words)
+        //! @param[in] maxPayloadLen  Maximum number of payload words this packet may hold
+        MapleEncodedPacket(uint32_t* storage, uint32_t maxPayloadLen) :
+            mStorage(storage),
+            mMaxPayloadLen(maxPayloadLen),
+            mNumWords(0)
+        {}
+
+        //! Encodes the given frame word and payload into this packet
+        //! @param[in] frameWord  The frame word (command, recipient, sender, length)
+        //! @param[in] payload  The payload words to send
+        //! @param[in] len  Number of words in payload (no more than the max payload length)
+        void set(uint32_t frameWord, const uint32_t* payload, uint8_t len)
+        {
+            if (len <= mMaxPayloadLen)
+            {
+                mNumWords = MapleCodec::encode(mStorage, frameWord, payload, len);
+            }
+            else
+            {
+                mNumWords = 0;
+            }
+        }
+
+        //! Encodes a packet with the given command, recipient and sender address
+        //! @param[in] command  The command byte - should be a value in Command enumeration
+        //! @param[in] recipientAddr  The address of the device receiving this command
+        //! @param[in] senderAddr  The address of the device sending this command
+        //! @param[in] payload  The payload words to send
+        //! @param[in] len  Number of words in payload (no more than the max payload length)
+        void set(uint8_t command,
+                 uint8_t recipientAddr,
+                 uint8_t senderAddr,
+                 const uint32_t* payload,
+                 uint8_t len)
+        {
+            set(makeFrameWord(command, recipientAddr, senderAddr, len), payload, len);
+        }
+
+        //! Encodes a packet whose payload is gathered from several segments, each encoded straight
+        //! from its own storage
+        //! @param[in] command  The command byte - should be a value in Command enumeration
+        //! @param[in] recipientAddr  The address of the device receiving this command
+        //! @param[in] senderAddr  The address of the device sending this command
+        //! @param[in] segments  The payload segments, in order
+        //! @param[in] numSegments  Number of segments
+        void set(uint8_t command,
+                 uint8_t recipientAddr,
+                 uint8_t senderAddr,
+                 const MapleCodec::Segment* segments,
+                 uint8_t numSegments)
+        {
+            uint32_t len = MapleCodec::payloadLen(segments, numSegments);
+            if (len <= mMaxPayloadLen && len <= 0xFF)
+            {
+                uint32_t frameWord = makeFrameWord(command, recipientAddr, senderAddr, len);
+                mNumWords = MapleCodec::encode(mStorage, frameWord, segments, numSegments);
+            }
+            else
+            {
+                mNumWords = 0;
+            }
+        }
+
+        //! Replaces the frame word without touching the encoded payload. This lets one encoding of
+        //! a large payload be reused for a different recipient in constant time.
+        //! @param[in] frameWord  The new frame word (its length must match the current payload)
+        void setFrameWord(uint32_t frameWord)
+        {
+            if (mNumWords > 0)
+            {
+                uint32_t oldFrameWord = getFrameWord();
+                mStorage[1] = MapleCodec::swapByteOrder(frameWord);
+                // CRC is an XOR of all bytes, so only the difference between frame words matters
+                mStorage[mNumWords - 1] ^=
+                    static_cast<uint32_t>(MapleCodec::foldCrc(oldFrameWord ^ frameWord)) << 24;
+            }
+        }
+
+        //! Copies the encoded words of another packet into this one, then replaces the frame word.
+        //! The payload is neither swapped nor CRC'd again.
+        //! @param[in] other  The packet to copy
+        //! @param[in] frameWord  The frame word to use for this packet
+        void copy(const MapleEncodedPacket& other, uint32_t frameWord)
+        {
+            if (other.mNumWords > 0 && other.getPayloadLen() <= mMaxPayloadLen)
+            {
+                memcpy(mStorage, other.mStorage, other.mNumWords * sizeof(mStorage[0]));
+                mNumWords = other.mNumWords;
+                setFrameWord(frameWord);
+            }
+            else
+            {
+                mNumWords = 0;
+            }
+        }
+
+        //! @returns true iff this packet holds an encoded frame
+        inline bool isValid() const { return (mNumWords > 0); }
+
+        //! @returns the encoded words, ready to be handed to DMA
+        inline const uint32_t* getWords() const { return mStorage; }
+
+        //! @returns the number of encoded words (0 if not valid)
+        inline uint32_t getNumWords() const { return mNumWords; }
+
+        //! @returns the number of bits the maple_out state machine will shift out
+        inline uint32_t getNumBits() const { return (mNumWords > 0) ? mStorage[0] : 0; }
+
+        //! @returns the number of payload words
+        inline uint32_t getPayloadLen() const { return (mNumWords > 0) ? (mNumWords - 3) : 0; }
+
+        //! @returns the frame word, in host byte order
+        inline uint32_t getFrameWord() const
+        {
+            return (mNumWords > 0) ? MapleCodec::swapByteOrder(mStorage[1]) : 0;
+        }
+
+        //! @returns a frame word with the given fields
+        static inline uint32_t makeFrameWord(uint8_t command,
+                                             uint8_t recipientAddr,
+                                             uint8_t senderAddr,
+                                             uint8_t len)
+        {
+            return MaplePacket::makeFrameWord(command, recipientAddr, senderAddr, len);
+        }
+
+    private:
+        //! Default constructor - not implemented
+        MapleEncodedPacket();
+        //! Copy constructor - not implemented (storage is not owned)
+        MapleEncodedPacket(const MapleEncodedPacket&);
+        //! Assignment operator - not implemented (use copy())
+        MapleEncodedPacket& operator=(const MapleEncodedPacket&);
+
+    private:
+        //! The encoded words
+        uint32_t* const mStorage;
+        //! Maximum number of payload words that mStorage can hold
+        const uint32_t mMaxPayloadLen;
+        //! Number of valid words in mStorage
+        uint32_t mNumWords;
+};
+
+//! A MapleEncodedPacket which holds its own storage
+template <uint32_t MAX_PAYLOAD_LEN>
+class MapleEncodedPacketBuffer : public MapleEncodedPacket
+{
+    public:
+        //! Constructor - the packet starts out empty
+        MapleEncodedPacketBuffer() :
+            MapleEncodedPacket(mBuffer, MAX_PAYLOAD_LEN),
+            mBuffer()
+        {}
+
+    private:
+        //! Storage for bit count, frame word, payload, and CRC
+        uint32_t mBuffer[MAX_PAYLOAD_LEN + 3];
+};
+
+#endif // __MAPLE_ENCODED_PACKET_H__
@@ -0,0 +1,149 @@
+#ifndef __MAPLE_PACKET_H__
+#define __MAPLE_PACKET_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+//! A read only view of a decoded Maple Bus packet: its frame word and the payload words which
+//! follow it. Nothing is copied; the view only refers to the words it is given, which must outlive
+//! it. Every field of a packet should be read through here so that the layout of the frame word is
+//! spelled out in one place and no payload word is read beyond the words actually received.
+//!
+//! The static functions pack and unpack frame words and other fixed format words, and are
+//! constexpr so that packets known at compile time cost nothing to build.
+class MaplePacket
+{
+    public:
+        //! Views a decoded packet
+        //! @param[in] words  The frame word followed by the payload, in host byte order
+        //! @param[in] len  Number of words received, including the frame word
+        constexpr MaplePacket(const uint32_t* words, uint32_t len) :
+            mFrameWord((len > 0) ? words[0] : 0),
+            mPayload((len > 0) ? &words[1] : NULL),
+            mPayloadLen(boundedPayloadLen((len > 0) ? words[0] : 0, len))
+        {}
+
+        //! Views a payload which was separated from its frame word; the recipient and sender
+        //! addresses read back as 0
+        //! @param[in] command  The command byte of the packet
+        //! @param[in] payload  The payload words, in host byte order
+        //! @param[in] payloadLen  Number of payload words
+        constexpr MaplePacket(uint8_t command, const uint32_t* payload, uint32_t payloadLen) :
+            mFrameWord(makeFrameWord(command, 0, 0, static_cast<uint8_t>((payloadLen > 0xFF) ? 0xFF : payloadLen))),
+            mPayload(payload),
+            mPayloadLen((payloadLen > 0xFF) ? 0xFF : payloadLen)
+        {}
+
+        //! @returns a frame word with the given fields
+        static constexpr uint32_t makeFrameWord(uint8_t command,
+                                                uint8_t recipientAddr,
+                                                uint8_t senderAddr,
+                                                uint8_t len)
+        {
+            return (static_cast<uint32_t>(command) << 24)
+                   | (static_cast<uint32_t>(recipientAddr) << 16)
+                   | (static_cast<uint32_t>(senderAddr) << 8)
+                   | len;
+        }
+
+        //! @returns the command byte of the given frame word
+        static constexpr uint8_t frameCommand(uint32_t frameWord)
+        {
+            return static_cast<uint8_t>(frameWord >> 24);
+        }
+
+        //! @returns the recipient address of the given frame word
+        static constexpr uint8_t frameRecipientAddr(uint32_t frameWord)
+        {
+            return static_cast<uint8_t>(frameWord >> 16);
+        }
+
+        //! @returns the sender address of the given frame word
+        static constexpr uint8_t frameSenderAddr(uint32_t frameWord)
+        {
+            return static_cast<uint8_t>(frameWord >> 8);
+        }
+
+        //! @returns the number of payload words the given frame word announces
+        static constexpr uint8_t frameLength(uint32_t frameWord)
+        {
+            return static_cast<uint8_t>(frameWord);
+        }
+
+        //! @param[in] partition  Partition number
+        //! @param[in] sequence  Sequence number of this block within a multi-part transfer
+        //! @param[in] block  Block number
+        //! @returns the block address word which follows the function code of block reads and
+        //!          writes
+        static constexpr uint32_t makeBlockAddr(uint8_t partition, uint8_t sequence, uint16_t block)
+        {
+            return (static_cast<uint32_t>(partition) << 24)
+                   | (static_cast<uint32_t>(sequence) << 16)
+                   | block;
+        }
+
+        //! @returns true iff a frame word is present
+        constexpr bool isValid() const { return (mPayload != NULL); }
+
+        //! @returns the frame word
+        constexpr uint32_t getFrameWord() const { return mFrameWord; }
+
+        //! @returns the command byte
+        constexpr uint8_t getCommand() const { return frameCommand(mFrameWord); }
+
+        //! @returns the address of the device this packet was sent to
+        constexpr uint8_t getRecipientAddr() const { return frameRecipientAddr(mFrameWord); }
+
+        //! @returns the address of the device which sent this packet
+        constexpr uint8_t getSenderAddr() const { return frameSenderAddr(mFrameWord); }
+
+        //! @returns the number of payload words which may be read (never more than were received)
+        constexpr uint32_t getPayloadLen() const { return mPayloadLen; }
+
+        //! @returns the payload words
+        constexpr const uint32_t* getPayload() const { return mPayload; }
+
+        //! @returns the function code which leads the payload of data transfer, device info, and
+        //!          block responses, or 0 if there is no payload
+        constexpr uint32_t getFunctionCode() const
+        {
+            return (mPayloadLen > 0) ? mPayload[0] : 0;
+        }
+
+        //! @param[in] command  The command this packet must be
+        //! @param[in] functionCode  The function code which must lead the payload
+        //! @param[in] numWords  Number of data words which must follow the function code
+        //! @returns the data words following the function code, or NULL if this isn't a packet
+        //!          with the given command and function code and at least numWords of data
+        constexpr const uint32_t* getFunctionData(uint8_t command,
+                                                  uint32_t functionCode,
+                                                  uint32_t numWords) const
+        {
+            return (getCommand() == command
+                    && mPayloadLen >= numWords + 1
+                    && mPayload[0] == functionCode)
+                ? &mPayload[1]
+                : NULL;
+        }
+
+    private:
+        //! @param[in] frameWord  The frame word received
+        //! @param[in] len  Number of words received, including the frame word
+        //! @returns the payload length announced by the frame word, limited to what was received
+        static constexpr uint32_t boundedPayloadLen(uint32_t frameWord, uint32_t len)
+        {
+            return (len == 0) ? 0
+                : (frameLength(frameWord) < len - 1) ? frameLength(frameWord)
+                : (len - 1);
+        }
+
+    private:
+        //! The frame word
+        const uint32_t mFrameWord;
+        //! The payload words (NULL when no frame word was received)
+        const uint32_t* const mPayload;
+        //! Number of words in mPayload which may be read
+        const uint32_t mPayloadLen;
+};
+
+#endif // __MAPLE_PACKET_H__
@@ -0,0 +1,136 @@
+#ifndef __MAPLE_RESPONSE_LATENCY_H__
+#define __MAPLE_RESPONSE_LATENCY_H__
+
+#include <stdint.h>
+#include "configuration.h"
+
+//! Learns how long each peripheral on a bus takes to start responding, and from that how long to
+//! wait for a response before giving up on it.
+//!
+//! The mean and mean deviation of each peripheral's latency are tracked the same way TCP tracks
+//! round trip time (RFC 6298), in integer fixed point. Once enough samples are in, the timeout is
+//! the mean plus 4 deviations plus MAPLE_RESPONSE_TIMEOUT_MARGIN_US, never more than
+//! MAPLE_RESPONSE_TIMEOUT_US. A timeout doubles the next wait for that peripheral (back up to
+//! MAPLE_RESPONSE_TIMEOUT_US) until it responds again, so a peripheral which is merely slower than
+//! it used to be isn't lost. This is not thread safe on its own; the owner must serialize access.
+class MapleResponseLatency
+{
+    public:
+        //! Number of samples needed before the timeout is tightened
+        static const uint32_t MIN_SAMPLES = 8;
+
+        //! Constructor - nothing is learned yet
+        MapleResponseLatency() :
+            mPeripherals()
+        {}
+
+        //! @param[in] addr  The recipient address of the request
+        //! @returns the time to wait for the beginning of the response
+        uint32_t getTimeoutUs(uint8_t addr) const
+        {
+            const Peripheral& peripheral = mPeripherals[slot(addr)];
+            uint32_t timeoutUs = MAPLE_RESPONSE_TIMEOUT_US;
+            if (peripheral.numSamples >= MIN_SAMPLES)
+            {
+                uint32_t learnedUs = (peripheral.scaledMean >> MEAN_SHIFT)
+                                     + peripheral.scaledDeviation
+                                     + MAPLE_RESPONSE_TIMEOUT_MARGIN_US;
+                learnedUs <<= peripheral.backoffShift;
+                if (learnedUs < timeoutUs)
+                {
+                    timeoutUs = learnedUs;
+                }
+            }
+            return timeoutUs;
+        }
+
+        //! Records the time a peripheral took to start responding
+        //! @param[in] addr  The recipient address of the request
+        //! @param[in] latencyUs  Time from the end of the request to the beginning of the response
+        void responded(uint8_t addr, uint32_t latencyUs)
+        {
+            Peripheral& peripheral = mPeripherals[slot(addr)];
+            if (latencyUs > MAPLE_RESPONSE_TIMEOUT_US)
+            {
+                latencyUs = MAPLE_RESPONSE_TIMEOUT_US;
+            }
+            if (peripheral.numSamples == 0)
+            {
+                peripheral.scaledMean = latencyUs << MEAN_SHIFT;
+                // Deviation starts at half the first sample (scaled by 4, so twice the sample)
+                peripheral.scaledDeviation = latencyUs << 1;
+            }
+            else
+            {
+                // mean += (sample - mean) / 8
+                int32_t error = static_cast<int32_t>(latencyUs)
+                                - static_cast<int32_t>(peripheral.scaledMean >> MEAN_SHIFT);
+                peripheral.scaledMean += error;
+                // deviation += (|sample - mean| - deviation) / 4
+                if (error < 0)
+                {
+                    error = -error;
+                }
+                error -= static_cast<int32_t>(peripheral.scaledDeviation >> DEVIATION_SHIFT);
+                peripheral.scaledDeviation += error;
+            }
+            if (peripheral.numSamples < MIN_SAMPLES)
+            {
+                ++peripheral.numSamples;
+            }
+            peripheral.backoffShift = 0;
+        }
+
+        //! Records that a peripheral didn't start responding in time
+        //! @param[in] addr  The recipient address of the request
+        void timedOut(uint8_t addr)
+        {
+            Peripheral& peripheral = mPeripherals[slot(addr)];
+            if (peripheral.backoffShift < MAX_BACKOFF_SHIFT)
+            {
+                ++peripheral.backoffShift;
+            }
+        }
+
+    private:
+        //! Fixed point shift of the mean (gain of 1/8)
+        static const uint32_t MEAN_SHIFT = 3;
+        //! Fixed point shift of the deviation (gain of 1/4)
+        static const uint32_t DEVIATION_SHIFT = 2;
+        //! Enough doublings to get from any learned timeout back to the maximum
+        static const uint32_t MAX_BACKOFF_SHIFT = 8;
+        //! One slot for the main peripheral and one for each of the 5 sub peripherals
+        static const uint32_t NUM_SLOTS = 6;
+
+        //! What is known about one peripheral
+        struct Peripheral
+        {
+            //! Mean latency, scaled by 8
+            uint32_t scaledMean;
+            //! Mean deviation of latency, scaled by 4
+            uint32_t scaledDeviation;
+            //! Number of samples taken, up to MIN_SAMPLES
+            uint32_t numSamples;
+            //! Number of times the timeout is doubled since the last response
+            uint32_t backoffShift;
+        };
+
+        //! @param[in] addr  A recipient address (the player bits are ignored)
+        //! @returns the slot which holds the given address
+        static inline uint32_t slot(uint8_t addr)
+        {
+            // Main peripheral is 0x20, and each sub peripheral has its own bit below that; the
+            // lowest sub peripheral bit picks the slot
+            static const uint8_t SUB_SLOT[32] = {
+                0, 1, 2, 1, 3, 1, 2, 1, 4, 1, 2, 1, 3, 1, 2, 1,
+                5, 1, 2, 1, 3, 1, 2, 1, 4, 1, 2, 1, 3, 1, 2, 1
+            };
+            return ((addr & 0x20) != 0) ? 0 : SUB_SLOT[addr & 0x1F];
+        }
+
+    private:
+        //! Each peripheral which may be addressed on a bus
+        Peripheral mPeripherals[NUM_SLOTS];
+};
+
+#endif // __MAPLE_RESPONSE_LATENCY_H__
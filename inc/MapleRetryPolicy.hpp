@@ -0,0 +1,120 @@
+#ifndef __MAPLE_RETRY_POLICY_H__
+#define __MAPLE_RETRY_POLICY_H__
+
+#include <stdint.h>
+#include "configuration.h"
+
+//! Decides whether a transaction is sent again once its response is in, and counts how often that
+//! happens. A response which fails CRC, or which asks for the last packet to be sent again, is
+//! answered by sending the same packet again, up to MAPLE_TRANSACTION_MAX_RETRIES times per
+//! transaction. This is not thread safe on its own; the owner must serialize access.
+class MapleRetryPolicy
+{
+    public:
+        //! Counts of transactions which were sent again
+        struct Stats
+        {
+            //! Number of retries after a response failed CRC
+            uint32_t numCrcRetries;
+            //! Number of retries the peripheral asked for
+            uint32_t numResendRetries;
+            //! Number of transactions which failed because no retry was left or the line wasn't
+            //! open for one
+            uint32_t numRetriesFailed;
+        };
+
+        //! What to do with a transaction once its response is in
+        enum Action
+        {
+            //! Report the response as received
+            ACTION_ACCEPT = 0,
+            //! Send the transaction again, then call retryStarted()
+            ACTION_RETRY,
+            //! Report a CRC error
+            ACTION_FAIL
+        };
+
+        //! Response command which asks for the last packet to be sent again
+        //! (COMMAND_RESPONSE_REQUEST_RESEND)
+        static const uint8_t REQUEST_RESEND_COMMAND = 0xFC;
+
+        //! Constructor - nothing counted yet
+        MapleRetryPolicy() :
+            mRetriesLeft(0),
+            mRetryIsResend(false),
+            mStats()
+        {}
+
+        //! Called as each transaction is started, before its first attempt
+        inline void start()
+        {
+            mRetriesLeft = MAPLE_TRANSACTION_MAX_RETRIES;
+        }
+
+        //! Called once a response is in
+        //! @param[in] valid  true iff the response is complete and passed CRC
+        //! @param[in] command  The command of the response (ignored unless valid)
+        //! @returns what to do with the transaction
+        inline Action onResponse(bool valid, uint8_t command)
+        {
+            Action action = ACTION_ACCEPT;
+            if (!valid || command == REQUEST_RESEND_COMMAND)
+            {
+                mRetryIsResend = valid;
+                if (mRetriesLeft > 0)
+                {
+                    --mRetriesLeft;
+                    action = ACTION_RETRY;
+                }
+                else
+                {
+                    ++mStats.numRetriesFailed;
+                    action = failedAction();
+                }
+            }
+            return action;
+        }
+
+        //! Called after onResponse() returned ACTION_RETRY
+        //! @param[in] started  true iff the transaction is underway again
+        //! @returns ACTION_RETRY if it is underway, or else what to do with the transaction instead
+        inline Action retryStarted(bool started)
+        {
+            Action action = ACTION_RETRY;
+            if (!started)
+            {
+                ++mStats.numRetriesFailed;
+                action = failedAction();
+            }
+            else if (mRetryIsResend)
+            {
+                ++mStats.numResendRetries;
+            }
+            else
+            {
+                ++mStats.numCrcRetries;
+            }
+            return action;
+        }
+
+        //! @returns the counts of transactions which were sent again so far
+        inline const Stats& getStats() const { return mStats; }
+
+    private:
+        //! @returns what to do with a transaction which wanted a retry but won't get one: a
+        //!          request to resend is still a valid response, but a corrupt one is an error
+        inline Action failedAction() const
+        {
+            return mRetryIsResend ? ACTION_ACCEPT : ACTION_FAIL;
+        }
+
+    private:
+        //! Number of times the current transaction may still be sent again
+        uint32_t mRetriesLeft;
+        //! True iff the last retry wanted was asked for by the peripheral rather than for CRC
+        bool mRetryIsResend;
+        //! Counts of transactions which were sent again
+        Stats mStats;
+};
+
+#endif // __MAPLE_RETRY_POLICY_H__
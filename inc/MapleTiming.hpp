@@ -0,0 +1,130 @@
+#ifndef __MAPLE_TIMING_H__
+#define __MAPLE_TIMING_H__
+
+#include <stdint.h>
+#include "configuration.h"
+#include "MapleCodec.hpp"
+
+//! Maple Bus timing worked out at compile time in integer math. The Cortex-M0+ has no FPU, so
+//! nothing here should ever be computed with floating point at run time. Times which depend on a
+//! packet's length are also laid out in lookup tables indexed by payload length, so the ISRs don't
+//! even need a divide.
+//! @tparam CPU_KHZ  The system clock frequency in kHz
+//! @tparam NS_PER_BIT  Time in nanoseconds each bit takes on the bus
+template <uint32_t CPU_KHZ, uint32_t NS_PER_BIT>
+class MapleTiming
+{
+    public:
+        //! Number of payload lengths covered by the lookup tables (0 through 255 words)
+        static constexpr uint32_t NUM_LENGTHS = 256;
+
+        //! Start and end sequences take less than this many bit periods when writing
+        static constexpr uint32_t WRITE_SEQUENCE_BITS = 14;
+
+        //! Start and end sequences take less than this many bit periods when reading
+        static constexpr uint32_t READ_SEQUENCE_BITS = 16;
+
+        //! A time in microseconds for each payload length
+        struct Table
+        {
+            //! Builds the table from the given function of payload length
+            //! @param[in] fn  Returns the time for a payload length
+            constexpr Table(uint32_t (*fn)(uint32_t)) :
+                us()
+            {
+                for (uint32_t i = 0; i < NUM_LENGTHS; ++i)
+                {
+                    us[i] = static_cast<uint16_t>(fn(i));
+                }
+            }
+
+            //! @param[in] payloadLen  Number of payload words (less than NUM_LENGTHS)
+            //! @returns the time for the given payload length
+            inline uint32_t operator[](uint32_t payloadLen) const { return us[payloadLen]; }
+
+            //! Looks a time back up by binary search; the times only ever grow with length
+            //! @param[in] timeUs  A time in microseconds
+            //! @returns the longest payload length whose time is no more than the given time (0 if
+            //!          none is)
+            inline uint32_t lengthWithin(uint32_t timeUs) const
+            {
+                uint32_t low = 0;
+                uint32_t high = NUM_LENGTHS - 1;
+                while (low < high)
+                {
+                    uint32_t mid = (low + high + 1) / 2;
+                    if (us[mid] <= timeUs)
+                    {
+                        low = mid;
+                    }
+                    else
+                    {
+                        high = mid - 1;
+                    }
+                }
+                return low;
+            }
+
+            //! Time in microseconds, indexed by payload length
+            uint16_t us[NUM_LENGTHS];
+        };
+
+        //! @param[in] doublePhaseTicks  PIO clock ticks maple_out takes for 2 of a bit's 3 phases
+        //! @returns the maple_out clock divider in 1/256ths (8 fractional bits, as the PIO takes it)
+        static constexpr uint32_t outClkDiv256(uint32_t doublePhaseTicks)
+        {
+            return static_cast<uint32_t>(
+                static_cast<uint64_t>(CPU_KHZ) * (NS_PER_BIT / 3 * 2) * 256
+                / (static_cast<uint64_t>(doublePhaseTicks) * 1000000));
+        }
+
+        //! @param[in] payloadLen  Number of payload words written
+        //! @returns the time to allow for a write to complete: the time to shift out the packet
+        //!          and its start and end sequences plus MAPLE_WRITE_TIMEOUT_EXTRA_PERCENT,
+        //!          rounded, plus 1 for the alarm's granularity
+        static constexpr uint32_t writeTimeoutUs(uint32_t payloadLen)
+        {
+            return static_cast<uint32_t>(
+                ((static_cast<uint64_t>(MapleCodec::numBits(payloadLen) + WRITE_SEQUENCE_BITS)
+                  * NS_PER_BIT * (100 + MAPLE_WRITE_TIMEOUT_EXTRA_PERCENT) / 100)
+                 + 500) / 1000) + 1;
+        }
+
+        //! @param[in] payloadLen  Number of payload words expected in the response
+        //! @returns the time to allow for receiving a response of the given length once it starts:
+        //!          the time to shift in the packet and its start and end sequences plus
+        //!          MAPLE_READ_TIMEOUT_EXTRA_PERCENT, rounded up, plus 1 for the alarm's granularity
+        static constexpr uint32_t readTimeoutUs(uint32_t payloadLen)
+        {
+            return static_cast<uint32_t>(
+                ((static_cast<uint64_t>(MapleCodec::numBits(payloadLen) + READ_SEQUENCE_BITS)
+                  * NS_PER_BIT * (100 + MAPLE_READ_TIMEOUT_EXTRA_PERCENT) / 100)
+                 + 999) / 1000) + 1;
+        }
+
+        //! writeTimeoutUs() for each payload length
+        static const Table WRITE_TIMEOUT_US;
+
+        //! readTimeoutUs() for each payload length
+        static const Table READ_TIMEOUT_US;
+};
+
+// The tables are filled in by the compiler once the functions above are complete
+template <uint32_t CPU_KHZ, uint32_t NS_PER_BIT>
+constexpr typename MapleTiming<CPU_KHZ, NS_PER_BIT>::Table
+    MapleTiming<CPU_KHZ, NS_PER_BIT>::WRITE_TIMEOUT_US{&MapleTiming::writeTimeoutUs};
+
+template <uint32_t CPU_KHZ, uint32_t NS_PER_BIT>
+constexpr typename MapleTiming<CPU_KHZ, NS_PER_BIT>::Table
+    MapleTiming<CPU_KHZ, NS_PER_BIT>::READ_TIMEOUT_US{&MapleTiming::readTimeoutUs};
+
+//! Timing of the Maple Bus as configured in configuration.h
+typedef MapleTiming<CPU_FREQ_KHZ, MAPLE_NS_PER_BIT> MapleBusTiming;
+
+// Every table entry must fit in 16 bits
+static_assert(MapleBusTiming::writeTimeoutUs(MapleBusTiming::NUM_LENGTHS - 1) <= 0xFFFF,
+              "Write timeout table overflow");
+static_assert(MapleBusTiming::readTimeoutUs(MapleBusTiming::NUM_LENGTHS - 1) <= 0xFFFF,
+              "Read timeout table overflow");
+
+#endif // __MAPLE_TIMING_H__
@@ -0,0 +1,68 @@
+#ifndef __MAPLE_TRANSACTION_H__
+#define __MAPLE_TRANSACTION_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "MapleEncodedPacket.hpp"
+
+//! Receives the outcome of a transaction which was submitted to a Maple Bus
+class MapleTransactionObserver
+{
+    public:
+        //! The outcome of a transaction
+        enum Status
+        {
+            //! The packet was sent and, if one was expected, a valid response was received
+            STATUS_SUCCESS = 0,
+            //! The line was never open or the write didn't complete in time
+            STATUS_WRITE_FAILED,
+            //! The packet was sent but no complete response was received in time
+            STATUS_READ_TIMEOUT,
+            //! A response was received, but it was malformed or its CRC was invalid
+            STATUS_CRC_ERROR
+        };
+
+        //! Virtual destructor
+        virtual ~MapleTransactionObserver() {}
+
+        //! Called from the bus owner's context (never from an ISR) once a transaction completes
+        //! @param[in] status  The outcome of the transaction
+        //! @param[in] response  The response words starting with the frame word (NULL unless
+        //!                      status is STATUS_SUCCESS and a response was expected); only valid
+        //!                      for the duration of this call
+        //! @param[in] len  Number of words in response, including the frame word
+        virtual void transactionComplete(Status status, const uint32_t* response, uint32_t len) = 0;
+};
+
+//! A request to write a packet and optionally receive a response
+struct MapleTransaction
+{
+    //! How urgently a transaction needs the bus
+    enum TrafficClass
+    {
+        //! May wait behind other traffic; recipients take turns
+        TRAFFIC_BULK = 0,
+        //! Goes ahead of all bulk traffic which hasn't started yet (ex: controller polls)
+        TRAFFIC_LATENCY_CRITICAL
+    };
+
+    //! The packet to send; it must not be modified or destroyed until the transaction completes
+    //! or is canceled
+    const MapleEncodedPacket* packet;
+    //! Set to true in order to start receive after send is complete
+    bool expectResponse;
+    //! When response is expected, the receive timeout in microseconds
+    uint32_t readTimeoutUs;
+    //! Notified when the transaction completes (may be NULL)
+    MapleTransactionObserver* observer;
+    //! How urgently this transaction needs the bus
+    TrafficClass trafficClass;
+
+    //! @returns the address this transaction is sent to (0 if it has no packet)
+    inline uint8_t getRecipientAddr() const
+    {
+        return (packet != NULL) ? MaplePacket::frameRecipientAddr(packet->getFrameWord()) : 0;
+    }
+};
+
+#endif // __MAPLE_TRANSACTION_H__
@@ -0,0 +1,161 @@
+#ifndef __MAPLE_TRANSACTION_QUEUE_H__
+#define __MAPLE_TRANSACTION_QUEUE_H__
+
+#include <stdint.h>
+#include "MapleTransaction.hpp"
+
+//! A fixed capacity queue of transactions waiting for a bus. This is not thread safe on its own;
+//! the owner must serialize access between thread and interrupt context.
+//!
+//! Latency critical transactions come out first, oldest first. Bulk transactions come out only
+//! when no latency critical one is waiting, and recipients take turns: the next bulk transaction
+//! is the oldest one for the first recipient address after the last one served. Every recipient is
+//! therefore served within one round of the others, however much any one of them queues up.
+template <uint32_t CAPACITY>
+class MapleTransactionQueue
+{
+    public:
+        //! Constructor - the queue starts out empty
+        MapleTransactionQueue() :
+            mTransactions(),
+            mHead(0),
+            mCount(0),
+            mLastBulkRecipient(0xFF)
+        {}
+
+        //! @returns true iff no transactions are queued
+        inline bool isEmpty() const { return (mCount == 0); }
+
+        //! @returns true iff no more transactions may be queued
+        inline bool isFull() const { return (mCount >= CAPACITY); }
+
+        //! @returns the number of queued transactions
+        inline uint32_t size() const { return mCount; }
+
+        //! Adds a transaction to the back of the queue
+        //! @param[in] transaction  The transaction to add
+        //! @returns true iff the transaction was queued
+        bool push(const MapleTransaction& transaction)
+        {
+            bool rv = false;
+            if (!isFull())
+            {
+                mTransactions[index(mCount)] = transaction;
+                ++mCount;
+                rv = true;
+            }
+            return rv;
+        }
+
+        //! Gets the transaction which pop() would remove, without removing it
+        //! @param[out] transaction  Set to the next transaction
+        //! @returns true iff a transaction is queued
+        bool peek(MapleTransaction& transaction) const
+        {
+            bool rv = false;
+            if (!isEmpty())
+            {
+                transaction = mTransactions[index(select())];
+                rv = true;
+            }
+            return rv;
+        }
+
+        //! Removes the next transaction to send
+        //! @param[out] transaction  Set to the removed transaction
+        //! @returns true iff a transaction was removed
+        bool pop(MapleTransaction& transaction)
+        {
+            bool rv = false;
+            if (!isEmpty())
+            {
+                uint32_t offset = select();
+                transaction = mTransactions[index(offset)];
+                erase(offset);
+                if (transaction.trafficClass == MapleTransaction::TRAFFIC_BULK)
+                {
+                    mLastBulkRecipient = transaction.getRecipientAddr();
+                }
+                rv = true;
+            }
+            return rv;
+        }
+
+        //! Removes every transaction for the given observer, keeping the rest in order
+        //! @param[in] observer  The observer whose transactions are removed
+        //! @returns the number of transactions removed
+        uint32_t remove(const MapleTransactionObserver* observer)
+        {
+            uint32_t kept = 0;
+            for (uint32_t i = 0; i < mCount; ++i)
+            {
+                const MapleTransaction& transaction = mTransactions[index(i)];
+                if (transaction.observer != observer)
+                {
+                    mTransactions[index(kept++)] = transaction;
+                }
+            }
+            uint32_t numRemoved = mCount - kept;
+            mCount = kept;
+            return numRemoved;
+        }
+
+    private:
+        //! @param[in] offset  Offset from the front of the queue
+        //! @returns index into mTransactions for the given offset
+        inline uint32_t index(uint32_t offset) const { return (mHead + offset) % CAPACITY; }
+
+        //! @returns the offset from the front of the queue of the next transaction to send; the
+        //!          queue must not be empty
+        uint32_t select() const
+        {
+            uint32_t selected = 0;
+            uint32_t bestDistance = 0x100;
+            for (uint32_t i = 0; i < mCount; ++i)
+            {
+                const MapleTransaction& transaction = mTransactions[index(i)];
+                if (transaction.trafficClass == MapleTransaction::TRAFFIC_LATENCY_CRITICAL)
+                {
+                    return i;
+                }
+                // How far after the last bulk recipient this one comes, going around once
+                uint32_t distance = (transaction.getRecipientAddr() - mLastBulkRecipient - 1) & 0xFF;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    selected = i;
+                }
+            }
+            return selected;
+        }
+
+        //! Removes a transaction, keeping the rest in order
+        //! @param[in] offset  Offset from the front of the queue of the transaction to remove
+        void erase(uint32_t offset)
+        {
+            if (offset == 0)
+            {
+                mHead = index(1);
+            }
+            else
+            {
+                for (uint32_t i = offset + 1; i < mCount; ++i)
+                {
+                    mTransactions[index(i - 1)] = mTransactions[index(i)];
+                }
+            }
+            --mCount;
+        }
+
+    private:
+        //! Circular buffer of transactions
+        MapleTransaction mTransactions[CAPACITY];
+        //! Index of the front of the queue
+        uint32_t mHead;
+        //! Number of queued transactions
+        uint32_t mCount;
+        //! Recipient address of the last bulk transaction removed
+        uint8_t mLastBulkRecipient;
+};
+
+#endif // __MAPLE_TRANSACTION_QUEUE_H__
@@ -0,0 +1,75 @@
+#ifndef __SEQ_LOCK_H__
+#define __SEQ_LOCK_H__
+
+#include <stdint.h>
+#include <string.h>
+
+//! Passes the latest copy of a small value from one writer to one reader, typically on another
+//! core, without either side ever blocking the other or disabling interrupts.
+//!
+//! The writer bumps a sequence count to odd before it modifies the value and back to even after.
+//! The reader copies the value out between two reads of the count and retries if the count was odd
+//! or changed, so it only ever sees a consistent snapshot. Only the writer may call write().
+template <typename T>
+class SeqLock
+{
+    public:
+        //! Constructor - nothing has been written yet
+        SeqLock() :
+            mSequence(0),
+            mValue()
+        {}
+
+        //! Publishes a new value
+        //! @param[in] value  The value to publish
+        void write(const T& value)
+        {
+            uint32_t sequence = mSequence;
+            mSequence = sequence + 1;
+            __sync_synchronize();
+            memcpy(&mValue, &value, sizeof(mValue));
+            __sync_synchronize();
+            mSequence = sequence + 2;
+        }
+
+        //! Copies out the latest value if it was published after the given sequence
+        //! @param[out] value  Set to the latest value when true is returned
+        //! @param[in,out] lastSequence  The sequence of the last value read (start at 0 to skip the
+        //!                              initial value); updated when true is returned
+        //! @returns true iff a newer value than lastSequence was copied out
+        bool read(T& value, uint32_t& lastSequence) const
+        {
+            uint32_t sequence;
+            do
+            {
+                sequence = mSequence;
+                if (sequence == lastSequence && (sequence & 1) == 0)
+                {
+                    return false;
+                }
+                __sync_synchronize();
+                memcpy(&value, &mValue, sizeof(value));
+                __sync_synchronize();
+            } while ((sequence & 1) != 0 || sequence != mSequence);
+
+            lastSequence = sequence;
+            return true;
+        }
+
+        //! Copies out the latest value
+        //! @param[out] value  Set to the latest value
+        void read(T& value) const
+        {
+            // An odd sequence never matches a published value
+            uint32_t lastSequence = 1;
+            read(value, lastSequence);
+        }
+
+    private:
+        //! Odd while mValue is being written
+        volatile uint32_t mSequence;
+        //! The latest value
+        T mValue;
+};
+
+#endif // __SEQ_LOCK_H__
@@ -0,0 +1,77 @@
+#ifndef __USB_REPORT_STATS_H__
+#define __USB_REPORT_STATS_H__
+
+#include <stdint.h>
+
+//! Counts how HID report submission has gone, which shows whether each update reaches the host
+//! within one USB interval. A report is put off when the endpoint still holds the previous one;
+//! the number of frames between a report first being put off and it finally being sent is how
+//! late that update reached the host. This is not thread safe; it belongs to the USB core.
+class UsbReportStats
+{
+    public:
+        //! The counts so far
+        struct Counts
+        {
+            //! Number of reports handed to the endpoint
+            uint32_t numSent;
+            //! Number of flushes put off because the endpoint still held the previous report
+            uint32_t numDeferred;
+            //! Most USB frames any deferred report waited before it was sent; 1 or less means no
+            //! update ever waited longer than one USB interval
+            uint32_t maxFramesDeferred;
+        };
+
+        //! Constructor - nothing counted yet
+        UsbReportStats() :
+            mCounts(),
+            mDeferred(false),
+            mFirstDeferredFrame(0)
+        {}
+
+        //! Records that a pending report was either sent or had to be put off
+        //! @param[in] sent  true iff the report was sent
+        //! @param[in] connected  true iff USB is connected (a report isn't put off while it isn't)
+        //! @param[in] frameNumber  The current 11-bit USB frame number
+        void recordFlush(bool sent, bool connected, uint32_t frameNumber)
+        {
+            if (sent)
+            {
+                ++mCounts.numSent;
+                if (mDeferred)
+                {
+                    mDeferred = false;
+                    uint32_t numFrames = (frameNumber - mFirstDeferredFrame) & FRAME_NUMBER_MASK;
+                    if (numFrames > mCounts.maxFramesDeferred)
+                    {
+                        mCounts.maxFramesDeferred = numFrames;
+                    }
+                }
+            }
+            else if (connected)
+            {
+                ++mCounts.numDeferred;
+                if (!mDeferred)
+                {
+                    mDeferred = true;
+                    mFirstDeferredFrame = frameNumber;
+                }
+            }
+        }
+
+        //! @returns the counts so far
+        inline const Counts& getCounts() const { return mCounts; }
+
+    private:
+        //! Frame numbers are 11 bits
+        static const uint32_t FRAME_NUMBER_MASK = 0x7FF;
+
+        //! The counts so far
+        Counts mCounts;
+        //! True while a report is waiting for the endpoint
+        bool mDeferred;
+        //! The frame number when the waiting report was first put off
+        uint32_t mFirstDeferredFrame;
+};
+
+#endif // __USB_REPORT_STATS_H__
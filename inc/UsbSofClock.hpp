@@ -0,0 +1,195 @@
+#ifndef __USB_SOF_CLOCK_H__
+#define __USB_SOF_CLOCK_H__
+
+#include <stdint.h>
+#include "SeqLock.hpp"
+
+//! Tracks when USB start of frame (SOF) occurs so that work on another core may be timed relative
+//! to the host's 1 ms frames.
+//!
+//! The USB core calls frameStarted() whenever it sees the frame number change. Those observations
+//! are only ever late (by however long it took to notice), so the earliest one is kept as the
+//! phase and later ones only nudge it to follow drift between the host's clock and ours. The
+//! estimate is published through a SeqLock so that a reader on the other core never sees a torn
+//! 64-bit value.
+class UsbSofClock
+{
+    public:
+        //! Length of a full speed USB frame
+        static const uint32_t FRAME_US = 1000;
+        //! A start of frame estimate older than this is stale (host suspended or disconnected)
+        static const uint32_t MAX_FRAME_AGE_US = 4 * FRAME_US;
+
+        //! Constructor - no frame has been seen yet
+        UsbSofClock() :
+            mEstimate(),
+            mPublished()
+        {}
+
+        //! Called from the USB core when the frame number is seen to change
+        //! @param[in] frameNumber  The current 11-bit frame number
+        //! @param[in] observedTimeUs  The time the change was seen
+        void frameStarted(uint32_t frameNumber, uint64_t observedTimeUs)
+        {
+            uint64_t sofTimeUs = observedTimeUs;
+            if (mEstimate.valid)
+            {
+                uint32_t numFrames = (frameNumber - mEstimate.frameNumber) & FRAME_NUMBER_MASK;
+                if (numFrames == 0)
+                {
+                    return;
+                }
+                uint64_t predictedUs =
+                    mEstimate.sofTimeUs + (static_cast<uint64_t>(numFrames) * FRAME_US);
+                if (numFrames <= MAX_FRAME_GAP && observedTimeUs > predictedUs)
+                {
+                    // Most of the difference is the time it took to notice
+                    sofTimeUs = predictedUs + ((observedTimeUs - predictedUs) >> DRIFT_SHIFT);
+                }
+            }
+
+            mEstimate.sofTimeUs = sofTimeUs;
+            mEstimate.frameNumber = frameNumber;
+            mEstimate.valid = true;
+            mPublished.write(mEstimate);
+        }
+
+        //! Called from the USB core when the host stops sending frames
+        void framesStopped()
+        {
+            mEstimate.valid = false;
+            mPublished.write(mEstimate);
+        }
+
+        //! Gets the most recent start of frame, safe to call from the other core
+        //! @param[in] currentTimeUs  The current time
+        //! @param[out] sofTimeUs  The time of the most recent start of frame
+        //! @returns true iff frames are currently being received
+        bool getFrameStart(uint64_t currentTimeUs, uint64_t& sofTimeUs) const
+        {
+            Estimate estimate;
+            mPublished.read(estimate);
+            sofTimeUs = estimate.sofTimeUs;
+            return (estimate.valid && currentTimeUs < sofTimeUs + MAX_FRAME_AGE_US);
+        }
+
+        //! @param[in] sofTimeUs  Any start of frame time
+        //! @param[in] earliestUs  The earliest time which may be returned
+        //! @param[in] leadUs  How long before a start of frame the returned time should be
+        //! @returns the earliest time at or after earliestUs which is leadUs ahead of a frame
+        static inline uint64_t alignToFrame(uint64_t sofTimeUs, uint64_t earliestUs, uint32_t leadUs)
+        {
+            int64_t diff = static_cast<int64_t>(sofTimeUs - leadUs) - static_cast<int64_t>(earliestUs);
+            int64_t offset = diff % static_cast<int64_t>(FRAME_US);
+            if (offset < 0)
+            {
+                offset += FRAME_US;
+            }
+            return earliestUs + offset;
+        }
+
+        //! @param[in] sofTimeUs  Any start of frame time
+        //! @param[in] timeUs  The time to check
+        //! @returns the time remaining from timeUs until the next start of frame
+        static inline uint32_t timeToNextFrame(uint64_t sofTimeUs, uint64_t timeUs)
+        {
+            return static_cast<uint32_t>(alignToFrame(sofTimeUs, timeUs, 0) - timeUs);
+        }
+
+    private:
+        //! Where the most recent start of frame is thought to be
+        struct Estimate
+        {
+            //! Estimated time of the most recent start of frame
+            uint64_t sofTimeUs;
+            //! Frame number of the most recent start of frame
+            uint32_t frameNumber;
+            //! True once a frame has been seen and until frames stop
+            bool valid;
+        };
+
+        //! Frame numbers are 11 bits
+        static const uint32_t FRAME_NUMBER_MASK = 0x7FF;
+        //! Frames may be missed for this long before the estimate is restarted
+        static const uint32_t MAX_FRAME_GAP = 8;
+        //! Late observations move the estimate 1/16 of the way toward them
+        static const uint32_t DRIFT_SHIFT = 4;
+
+        //! The USB core's working copy of the estimate
+        Estimate mEstimate;
+        //! The estimate as last published to readers
+        SeqLock<Estimate> mPublished;
+};
+
+//! Measures how far ahead of the next start of frame new data becomes available, which shows
+//! whether work timed with UsbSofClock actually lands where it was aimed.
+struct FramePhaseStats
+{
+    //! Number of measurements taken
+    uint32_t numSamples;
+    //! Number of measurements which landed within the target window before a frame
+    uint32_t numOnTime;
+    //! Shortest time between data and the following start of frame
+    uint32_t minLeadUs;
+    //! Longest time between data and the following start of frame
+    uint32_t maxLeadUs;
+    //! Sum of all measurements, for the average
+    uint64_t totalLeadUs;
+
+    //! Records one measurement
+    //! @param[in] leadUs  Time between data becoming available and the following start of frame
+    //! @param[in] windowUs  Data which arrives no more than this long before a frame is on time
+    void record(uint32_t leadUs, uint32_t windowUs)
+    {
+        if (numSamples == 0 || leadUs < minLeadUs)
+        {
+            minLeadUs = leadUs;
+        }
+        if (leadUs > maxLeadUs)
+        {
+            maxLeadUs = leadUs;
+        }
+        if (leadUs <= windowUs)
+        {
+            ++numOnTime;
+        }
+        totalLeadUs += leadUs;
+        ++numSamples;
+    }
+};
+
+//! Keeps FramePhaseStats on the core which takes the measurements and publishes a copy after each
+//! one through a SeqLock, so that a reader on the other core only ever sees a consistent snapshot.
+class FramePhaseMonitor
+{
+    public:
+        //! Constructor - nothing measured yet
+        FramePhaseMonitor() :
+            mStats(),
+            mPublished()
+        {}
+
+        //! Records one measurement and publishes the updated stats; only one core may call this
+        //! @param[in] leadUs  Time between data becoming available and the following start of frame
+        //! @param[in] windowUs  Data which arrives no more than this long before a frame is on time
+        void record(uint32_t leadUs, uint32_t windowUs)
+        {
+            mStats.record(leadUs, windowUs);
+            mPublished.write(mStats);
+        }
+
+        //! Copies out the stats as last published; may be called from any core
+        //! @param[out] stats  Set to the stats as last published
+        void read(FramePhaseStats& stats) const
+        {
+            mPublished.read(stats);
+        }
+
+    private:
+        //! The measuring core's working copy of the stats
+        FramePhaseStats mStats;
+        //! The stats as last published to readers
+        SeqLock<FramePhaseStats> mPublished;
+};
+
+#endif // __USB_SOF_CLOCK_H__
@@ -14,11 +14,61 @@
 // Added percentage on top of the expected completion time
 #define MAPLE_WRITE_TIMEOUT_EXTRA_PERCENT 20
 
-// Maximum amount of time waiting for the beginning of a response when one is expected
+// Maximum amount of time waiting for the beginning of a response when one is expected; this is
+// used until a peripheral's typical response latency has been learned
 #define MAPLE_RESPONSE_TIMEOUT_US 500
 
+// Added on top of a peripheral's learned response latency (mean plus 4 deviations) to get the time
+// to wait for the beginning of its response
+#define MAPLE_RESPONSE_TIMEOUT_MARGIN_US 20
+
+// Added percentage on top of the expected time to receive a response of known length; peripherals
+// don't all transmit at exactly the same rate as the host
+#define MAPLE_READ_TIMEOUT_EXTRA_PERCENT 50
+
 // Default maximum amount of time to spend trying to read on the maple bus
 // 4000 us accommodates the maximum number of words (256) at 2 mbps
 #define DEFAULT_MAPLE_READ_TIMEOUT_US 4000
 
+// Longest time core1 sleeps when nothing is due; this only bounds the wait in case a wake event is
+// missed since core1 otherwise sleeps until a Maple Bus interrupt or the next node deadline
+#define CORE1_MAX_IDLE_US 2000
+
+// Portion of each bus's time, in tenths of a percent, which periodic polling may take up; the rest
+// is left for discovery, retries, and anything else
+#define MAPLE_POLLING_BUDGET_PERMILLE 800
+
+// How long before each USB start of frame a controller's condition should arrive; this covers
+// waking core1 and handing the condition over to the USB core
+#define USB_SOF_POLL_MARGIN_US 150
+
+// Number of times a transaction is immediately sent again when its response fails CRC or the
+// peripheral asks for it to be sent again
+#define MAPLE_TRANSACTION_MAX_RETRIES 2
+
+// How far past a reserved latency critical transaction (controller poll) a bulk transaction may
+// run when it is started ahead of it
+#define MAPLE_MAX_POLL_JITTER_US 50
+
+// Maximum number of transactions which may wait for each bus
+#define MAPLE_TRANSACTION_QUEUE_SIZE 8
+
+// Busses borrow their DMA buffers from one shared pool for the length of each transaction. Small
+// buffers take the responses to latency critical transactions (controller polls); large buffers
+// take everything else. Each bus holds at most 2 response buffers at once, and a transaction waits
+// in its queue while no buffer of its size is free.
+#define MAPLE_SMALL_BUFFER_WORDS 32
+#define MAPLE_NUM_SMALL_BUFFERS 8
+#define MAPLE_NUM_LARGE_BUFFERS 3
+
+// How often XIP cache counters are reported when the build sets MAPLE_XIP_CACHE_STATS
+#define XIP_CACHE_STATS_PERIOD_MS 1000
+
+// How often Maple Bus and USB statistics are reported when the build sets MAPLE_RUNTIME_STATS
+#define RUNTIME_STATS_PERIOD_MS 1000
+
+// Number of interrupt entries measured for each report when the build sets
+// MAPLE_ISR_JITTER_BENCHMARK
+#define ISR_JITTER_BENCHMARK_SAMPLES 1000
+
 #endif // __CONFIGURATION_H__
@@ -6,4 +6,37 @@
 // Just for completeness...
 #define INT_DIVIDE_FLOOR(x,y) ((x)/(y))
 
+// Wraps the name of a function on the Maple Bus hot path (interrupt handlers and everything core1
+// runs for each transaction). When the build sets MAPLE_HOT_PATH_IN_RAM, the function is placed
+// in a .time_critical section, which the pico-sdk linker script copies into SRAM at boot, so it
+// never stalls on an XIP cache miss caused by the other core. Otherwise, it stays in flash.
+// Usage: void MAPLE_HOT_FUNC(MyClass::myMethod)(int arg) { ... }
+#if defined(MAPLE_HOT_PATH_IN_RAM) && MAPLE_HOT_PATH_IN_RAM
+#define MAPLE_HOT_FUNC(name) __attribute__((section(".time_critical." #name))) name
+#else
+#define MAPLE_HOT_FUNC(name) name
+#endif
+
+// Wraps the name of constant data which the Maple Bus hot path looks up. When the build sets
+// MAPLE_HOT_PATH_IN_RAM, it is copied into SRAM at boot along with the hot functions for the same
+// reason. GCC ignores the section of a template's static data member, so this only works on
+// ordinary variables; copy such a table into one of those instead.
+// Usage: static const uint16_t MAPLE_HOT_DATA(myTable)[4] = {1, 2, 3, 4};
+#if defined(MAPLE_HOT_PATH_IN_RAM) && MAPLE_HOT_PATH_IN_RAM
+#define MAPLE_HOT_DATA(name) __attribute__((section(".time_critical." #name))) name
+#else
+#define MAPLE_HOT_DATA(name) name
+#endif
+
+// Wraps the name of a variable which only core1 touches while servicing the busses. When the build
+// sets MAPLE_SCRATCH_BANKS, the variable is placed in SCRATCH_X, the 4 KB SRAM bank which already
+// holds core1's stack, so core1 never waits on core0 or DMA traffic in striped main SRAM to reach
+// it. Anything placed here must fit alongside that stack; the link fails if it doesn't.
+// Usage: static uint32_t MAPLE_CORE1_DATA(myBuffer)[16];
+#if defined(MAPLE_SCRATCH_BANKS) && MAPLE_SCRATCH_BANKS
+#define MAPLE_CORE1_DATA(name) __attribute__((section(".scratch_x." #name))) name
+#else
+#define MAPLE_CORE1_DATA(name) name
+#endif
+
 #endif // __UTILS_H__
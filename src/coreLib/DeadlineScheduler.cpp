@@ -0,0 +1,151 @@
+#include "DeadlineScheduler.hpp"
+
+const uint64_t DeadlineScheduler::NEVER;
+const uint32_t DeadlineScheduler::MAX_TASKS;
+
+DeadlineScheduler::DeadlineScheduler() :
+    mHeap(),
+    mNumTasks(0)
+{}
+
+bool DeadlineScheduler::schedule(Task* task, uint64_t dueTimeUs)
+{
+    if (dueTimeUs == NEVER)
+    {
+        unschedule(task);
+        return false;
+    }
+
+    bool rv = false;
+    if (task->mHeapIndex != Task::NOT_SCHEDULED)
+    {
+        uint64_t lastDueTimeUs = task->mDueTimeUs;
+        task->mDueTimeUs = dueTimeUs;
+        if (dueTimeUs < lastDueTimeUs)
+        {
+            siftUp(task->mHeapIndex);
+        }
+        else
+        {
+            siftDown(task->mHeapIndex);
+        }
+        rv = true;
+    }
+    else if (mNumTasks < MAX_TASKS)
+    {
+        task->mDueTimeUs = dueTimeUs;
+        place(task, mNumTasks++);
+        siftUp(task->mHeapIndex);
+        rv = true;
+    }
+    return rv;
+}
+
+void DeadlineScheduler::unschedule(Task* task)
+{
+    if (task->mHeapIndex != Task::NOT_SCHEDULED)
+    {
+        removeAt(task->mHeapIndex);
+    }
+}
+
+void DeadlineScheduler::clear()
+{
+    for (uint32_t i = 0; i < mNumTasks; ++i)
+    {
+        mHeap[i]->mHeapIndex = Task::NOT_SCHEDULED;
+    }
+    mNumTasks = 0;
+}
+
+uint64_t DeadlineScheduler::getNextDueTime() const
+{
+    return (mNumTasks > 0) ? mHeap[0]->mDueTimeUs : NEVER;
+}
+
+uint32_t DeadlineScheduler::runDue(uint64_t currentTimeUs)
+{
+    // Pull everything that is due first so a task which is immediately due again can't starve
+    // the rest
+    Task* due[MAX_TASKS];
+    uint32_t numDue = 0;
+    while (mNumTasks > 0 && mHeap[0]->mDueTimeUs <= currentTimeUs)
+    {
+        due[numDue++] = mHeap[0];
+        removeAt(0);
+    }
+
+    for (uint32_t i = 0; i < numDue; ++i)
+    {
+        schedule(due[i], due[i]->runTask(currentTimeUs));
+    }
+
+    return numDue;
+}
+
+void DeadlineScheduler::siftUp(uint32_t idx)
+{
+    Task* task = mHeap[idx];
+    while (idx > 0)
+    {
+        uint32_t parent = (idx - 1) / 2;
+        if (mHeap[parent]->mDueTimeUs <= task->mDueTimeUs)
+        {
+            break;
+        }
+        place(mHeap[parent], idx);
+        idx = parent;
+    }
+    place(task, idx);
+}
+
+void DeadlineScheduler::siftDown(uint32_t idx)
+{
+    Task* task = mHeap[idx];
+    while (true)
+    {
+        uint32_t child = (idx * 2) + 1;
+        if (child >= mNumTasks)
+        {
+            break;
+        }
+        if (child + 1 < mNumTasks && mHeap[child + 1]->mDueTimeUs < mHeap[child]->mDueTimeUs)
+        {
+            ++child;
+        }
+        if (task->mDueTimeUs <= mHeap[child]->mDueTimeUs)
+        {
+            break;
+        }
+        place(mHeap[child], idx);
+        idx = child;
+    }
+    place(task, idx);
+}
+
+void DeadlineScheduler::place(Task* task, uint32_t idx)
+{
+    mHeap[idx] = task;
+    task->mHeapIndex = idx;
+}
+
+void DeadlineScheduler::removeAt(uint32_t idx)
+{
+    Task* removed = mHeap[idx];
+    removed->mHeapIndex = Task::NOT_SCHEDULED;
+    --mNumTasks;
+    if (idx < mNumTasks)
+    {
+        // Fill the hole with the last task and restore order around it
+        Task* last = mHeap[mNumTasks];
+        place(last, idx);
+        if (idx > 0 && last->mDueTimeUs < mHeap[(idx - 1) / 2]->mDueTimeUs)
+        {
+            siftUp(idx);
+        }
+        else
+        {
+            siftDown(idx);
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+
+//! Runs tasks in order of their deadlines so that only the tasks which are actually due get called.
+//! Tasks are kept in a fixed size binary min-heap keyed on due time.
+class DeadlineScheduler
+{
+    public:
+        //! Due time of a task which is only made due again by an external event
+        static const uint64_t NEVER = 0xFFFFFFFFFFFFFFFFULL;
+
+        //! Something which is run by a DeadlineScheduler
+        class Task
+        {
+            public:
+                //! Constructor - the task starts out unscheduled
+                Task() : mHeapIndex(NOT_SCHEDULED), mDueTimeUs(NEVER) {}
+
+                //! Copy constructor - a copy starts out unscheduled
+                Task(const Task&) : mHeapIndex(NOT_SCHEDULED), mDueTimeUs(NEVER) {}
+
+                //! Virtual destructor
+                virtual ~Task() {}
+
+                //! Called by the scheduler once this task is due
+                //! @param[in] currentTimeUs  The current time in microseconds
+                //! @returns the time this task is next due (NEVER to unschedule it)
+                virtual uint64_t runTask(uint64_t currentTimeUs) = 0;
+
+            private:
+                friend class DeadlineScheduler;
+                //! Index value of a task which isn't in the heap
+                static const uint32_t NOT_SCHEDULED = 0xFFFFFFFF;
+                //! Position of this task in its scheduler's heap
+                uint32_t mHeapIndex;
+                //! The time this task is due
+                uint64_t mDueTimeUs;
+        };
+
+        //! Constructor - no tasks are scheduled
+        DeadlineScheduler();
+
+        //! Schedules a task, or moves it if it's already scheduled
+        //! @param[in] task  The task to schedule
+        //! @param[in] dueTimeUs  When the task is due (NEVER to unschedule it)
+        //! @returns true iff the task is scheduled (false when NEVER or when the heap is full)
+        bool schedule(Task* task, uint64_t dueTimeUs);
+
+        //! Removes a task from the schedule if it's scheduled
+        //! @param[in] task  The task to remove
+        void unschedule(Task* task);
+
+        //! Removes all tasks from the schedule
+        void clear();
+
+        //! @returns the time the earliest task is due (NEVER if nothing is scheduled)
+        uint64_t getNextDueTime() const;
+
+        //! @returns the number of scheduled tasks
+        inline uint32_t size() const { return mNumTasks; }
+
+        //! Runs every task which is due and reschedules each one at the time it returns. A task
+        //! which comes due again while this runs isn't run again until the next call.
+        //! @param[in] currentTimeUs  The current time in microseconds
+        //! @returns the number of tasks which were run
+        uint32_t runDue(uint64_t currentTimeUs);
+
+    public:
+        //! Maximum number of tasks which may be scheduled at once
+        static const uint32_t MAX_TASKS = 8;
+
+    private:
+        //! Moves the task at the given index toward the root until the heap is ordered
+        void siftUp(uint32_t idx);
+        //! Moves the task at the given index toward the leaves until the heap is ordered
+        void siftDown(uint32_t idx);
+        //! Places a task at the given heap index
+        void place(Task* task, uint32_t idx);
+        //! Removes the task at the given heap index
+        void removeAt(uint32_t idx);
+
+    private:
+        //! The heap of tasks; mHeap[0] is due first
+        Task* mHeap[MAX_TASKS];
+        //! Number of tasks in mHeap
+        uint32_t mNumTasks;
+};
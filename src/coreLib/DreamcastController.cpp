@@ -1,15 +1,31 @@
 #include "DreamcastController.hpp"
 #include "dreamcast_constants.h"
+#include "MaplePacket.hpp"
 #include <string.h>
 
+const PollingGovernor::Profile DreamcastController::POLLING_PROFILE = {
+    1000,   // minPeriodUs
+    16000,  // maxPeriodUs
+    64,     // idlePollsPerBackoff
+    PollingGovernor::transactionCostUs(1, 3) // costUs
+};
 
 DreamcastController::DreamcastController(uint8_t addr, MapleBusInterface& bus, PlayerData playerData) :
     DreamcastPeripheral(addr, bus, playerData.playerIndex),
     mGamepad(playerData.gamepad),
+    mGovernor(POLLING_PROFILE, &playerData.pollingBudget),
+    mLastCondition(),
+    mSofClock(playerData.usbSofClock),
+    mFrameLeadUs(POLLING_PROFILE.costUs + USB_SOF_POLL_MARGIN_US),
+    mConditionReceived(false),
+    mFramePhaseMonitor(playerData.framePhaseMonitor),
     mNextCheckTime(0),
-    mWaitingForData(false),
-    mNoDataCount(0)
+    mConditionRequestPending(false),
+    mNoDataCount(0),
+    mGetConditionPacket()
 {
+    uint32_t data = DEVICE_FN_CONTROLLER;
+    mGetConditionPacket.set(COMMAND_GET_CONDITION, getRecipientAddress(), HOST_ADDR, &data, 1);
     mGamepad.controllerConnected();
 }
 
@@ -22,48 +38,106 @@ bool DreamcastController::handleData(uint8_t len,
                                      uint8_t cmd,
                                      const uint32_t *payload)
 {
-    if (mWaitingForData)
+    MaplePacket packet(cmd, payload, len);
+    const uint32_t* condition =
+        packet.getFunctionData(COMMAND_RESPONSE_DATA_XFER, DEVICE_FN_CONTROLLER, 2);
+    if (condition != NULL)
     {
-        mWaitingForData = false;
-        mNoDataCount = 0;
-
-        if (cmd == COMMAND_RESPONSE_DATA_XFER && len >= 3 && payload[0] == 1)
+        // Poll faster while the controller is in use
+        if (condition[0] != mLastCondition[0] || condition[1] != mLastCondition[1])
         {
-            // Handle condition data
-            DreamcastControllerObserver::ControllerCondition controllerCondition;
-            memcpy(&controllerCondition, &payload[1], 8);
-            mGamepad.setControllerCondition(controllerCondition);
-
-            return true;
+            mLastCondition[0] = condition[0];
+            mLastCondition[1] = condition[1];
+            mGovernor.activity();
         }
+        else
+        {
+            mGovernor.idle();
+        }
+
+        // Handle condition data
+        DreamcastControllerObserver::ControllerCondition controllerCondition;
+        memcpy(&controllerCondition, condition, 8);
+        mGamepad.setControllerCondition(controllerCondition);
+        mConditionReceived = true;
+
+        return true;
     }
 
     return false;
 }
 
+void DreamcastController::transactionComplete(Status status,
+                                              const uint32_t* response,
+                                              uint32_t len)
+{
+    mConditionRequestPending = false;
+
+    MaplePacket packet(response, len);
+    if (status == STATUS_SUCCESS
+        && packet.isValid()
+        && handleData(packet.getPayloadLen(), packet.getCommand(), packet.getPayload()))
+    {
+        mNoDataCount = 0;
+    }
+    else
+    {
+        ++mNoDataCount;
+    }
+}
+
 bool DreamcastController::task(uint64_t currentTimeUs)
 {
-    bool connected = (mNoDataCount < NO_DATA_DISCONNECT_COUNT);
-    if (currentTimeUs > mNextCheckTime)
+    uint64_t sofTimeUs = 0;
+    if (mConditionReceived)
     {
-        // Increment count if we are still waiting for response from the last communication attempt
-        if (mWaitingForData)
+        // Conditions are handed out in the same pass that this task is run in after a completion,
+        // so this is when the condition reached the gamepad
+        mConditionReceived = false;
+        if (mSofClock.getFrameStart(currentTimeUs, sofTimeUs))
         {
-            ++mNoDataCount;
-            mWaitingForData = false;
-            connected = (mNoDataCount < NO_DATA_DISCONNECT_COUNT);
+            mFramePhaseMonitor.record(UsbSofClock::timeToNextFrame(sofTimeUs, currentTimeUs),
+                                      mFrameLeadUs);
         }
+    }
 
-        if (connected)
+    bool connected = (mNoDataCount < NO_DATA_DISCONNECT_COUNT);
+    if (connected && !mConditionRequestPending && currentTimeUs >= mNextCheckTime)
+    {
+        // Get controller status; the response (function code and 2 condition words) comes back
+        // through transactionComplete()
+        MapleTransaction transaction = {&mGetConditionPacket,
+                                         true,
+                                         MapleBusInterface::readTimeoutUs(3),
+                                         this,
+                                         MapleTransaction::TRAFFIC_LATENCY_CRITICAL};
+        if (mBus.submit(transaction))
         {
-            // Get controller status
-            uint32_t data = DEVICE_FN_CONTROLLER;
-            if (mBus.write(COMMAND_GET_CONDITION, getRecipientAddress(), &data, 1, true))
-            {
-                mWaitingForData = true;
-                mNextCheckTime = currentTimeUs + US_PER_CHECK;
-            }
+            mConditionRequestPending = true;
+            mNextCheckTime = getNextPollTime(currentTimeUs);
+            // Keep bulk traffic from starting just before the next poll
+            mBus.reserve(mNextCheckTime);
         }
     }
     return connected;
 }
+
+uint64_t DreamcastController::getNextPollTime(uint64_t currentTimeUs) const
+{
+    uint64_t nextPollTimeUs = currentTimeUs + mGovernor.getPeriodUs();
+    uint64_t sofTimeUs = 0;
+    if (mSofClock.getFrameStart(currentTimeUs, sofTimeUs))
+    {
+        // Snap to whichever frame is nearest so that lateness in starting this poll doesn't push
+        // the next one out by a whole frame
+        nextPollTimeUs = UsbSofClock::alignToFrame(
+            sofTimeUs, nextPollTimeUs - (UsbSofClock::FRAME_US / 2), mFrameLeadUs);
+    }
+    return nextPollTimeUs;
+}
+
+uint64_t DreamcastController::getNextDueTime() const
+{
+    // A disconnect is reported on the next task() call, which is due right away
+    return mConditionRequestPending ? DeadlineScheduler::NEVER : mNextCheckTime;
+}
@@ -2,11 +2,14 @@
 
 #include "DreamcastPeripheral.hpp"
 #include "MapleBusInterface.hpp"
+#include "MapleEncodedPacket.hpp"
 #include "DreamcastControllerObserver.hpp"
 #include "PlayerData.hpp"
+#include "PollingGovernor.hpp"
+#include "UsbSofClock.hpp"
 
 //! Handles communication with the Dreamcast controller peripheral
-class DreamcastController : public DreamcastPeripheral
+class DreamcastController final : public DreamcastPeripheral
 {
     public:
         //! Constructor
@@ -26,18 +29,45 @@ class DreamcastController : public DreamcastPeripheral
         //! Inherited from DreamcastPeripheral
         virtual bool task(uint64_t currentTimeUs) final;
 
+        //! Inherited from DreamcastPeripheral
+        virtual uint64_t getNextDueTime() const final;
+
+        //! Inherited from MapleTransactionObserver
+        virtual void transactionComplete(Status status,
+                                         const uint32_t* response,
+                                         uint32_t len) final;
+
+    private:
+        //! @param[in] currentTimeUs  The time a poll was just started
+        //! @returns the time of the next poll, timed so its condition arrives just before a frame
+        uint64_t getNextPollTime(uint64_t currentTimeUs) const;
+
     private:
         //! Number of times failed communication occurs before determining that the controller is
         //! disconnected
         static const uint32_t NO_DATA_DISCONNECT_COUNT = 5;
-        //! Time between each controller state poll (in microseconds)
-        static const uint32_t US_PER_CHECK = 16000;
+        //! Polls up to 1 kHz while the condition changes, backing off to 60 Hz while it doesn't
+        static const PollingGovernor::Profile POLLING_PROFILE;
         //! The gamepad to write button presses to
         DreamcastControllerObserver& mGamepad;
+        //! Sets the time between each controller state poll
+        PollingGovernor mGovernor;
+        //! The last condition received, used to tell whether the controller is in use
+        uint32_t mLastCondition[2];
+        //! USB start of frame timing which polls are aligned to
+        const UsbSofClock& mSofClock;
+        //! How long before a USB frame each poll starts
+        const uint32_t mFrameLeadUs;
+        //! Set when a condition is received and cleared once its arrival is measured
+        bool mConditionReceived;
+        //! Where this player's conditions have been arriving relative to USB frames
+        FramePhaseMonitor& mFramePhaseMonitor;
         //! Time which the next controller state poll will occur
         uint64_t mNextCheckTime;
-        //! True iff the controller is waiting for data
-        bool mWaitingForData;
+        //! True while a condition request is queued or in progress on the bus
+        bool mConditionRequestPending;
         //! Number of consecutive times no data was received
         uint32_t mNoDataCount;
+        //! The condition request, encoded once and sent on every poll
+        MapleEncodedPacketBuffer<1> mGetConditionPacket;
 };
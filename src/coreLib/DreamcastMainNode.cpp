@@ -1,19 +1,26 @@
 #include "DreamcastMainNode.hpp"
 #include "DreamcastPeripheral.hpp"
 #include "dreamcast_constants.h"
+#include "MaplePacket.hpp"
 #include "DreamcastController.hpp"
+#include "utils.h"
 
-DreamcastMainNode::DreamcastMainNode(MapleBusInterface& bus,
-                                     PlayerData playerData) :
+// mSubNodes is initialized with one entry per sub peripheral below
+static_assert(DreamcastPeripheral::MAX_SUB_PERIPHERALS == 5, "Sub node initializers out of date");
+
+DreamcastMainNode::DreamcastMainNode(
+    MapleBusInterface& bus,
+    PlayerData playerData,
+    DreamcastSubNode* const (&subNodes)[DreamcastPeripheral::MAX_SUB_PERIPHERALS]) :
     DreamcastNode(DreamcastPeripheral::MAIN_PERIPHERAL_ADDR_MASK, bus, playerData),
     mNextCheckTime(0),
-    mSubNodes()
+    mNextPeripheralsDueTime(0),
+    mSubNodes{subNodes[0], subNodes[1], subNodes[2], subNodes[3], subNodes[4]},
+    mScheduler()
 {
-    mSubNodes.reserve(DreamcastPeripheral::MAX_SUB_PERIPHERALS);
     for (uint32_t i = 0; i < DreamcastPeripheral::MAX_SUB_PERIPHERALS; ++i)
     {
-        mSubNodes.push_back(std::make_shared<DreamcastSubNode>(
-            DreamcastPeripheral::subPeripheralMask(i), mBus, mPlayerData));
+        mScheduler.schedule(mSubNodes[i], 0);
     }
 }
 
@@ -25,81 +32,74 @@ bool DreamcastMainNode::handleData(uint8_t len,
                                    const uint32_t *payload)
 {
     // Handle device info from main peripheral
-    if (cmd == COMMAND_RESPONSE_DEVICE_INFO)
+    MaplePacket packet(cmd, payload, len);
+    if (packet.getCommand() == COMMAND_RESPONSE_DEVICE_INFO)
     {
-        peripheralFactory(payload[0]);
-        return (mPeripherals.size() > 0);
+        peripheralFactory(packet.getFunctionCode());
+        return (!mPeripheral.isEmpty());
     }
 
-    return handlePeripheralData(len, cmd, payload);
+    return false;
 }
 
-void DreamcastMainNode::task(uint64_t currentTimeUs)
+void MAPLE_HOT_FUNC(DreamcastMainNode::task)(uint64_t currentTimeUs)
 {
-    mBus.processEvents(currentTimeUs);
+    // Completed transactions are handed straight to whoever submitted them from in here
+    uint32_t numCompleted = mBus.processEvents(currentTimeUs);
+    if (numCompleted > 0)
+    {
+        // A completion may change when any peripheral or sub node is next due, so let each one
+        // take a look and report back its own due time
+        mNextPeripheralsDueTime = currentTimeUs;
+        for (uint32_t i = 0; i < DreamcastPeripheral::MAX_SUB_PERIPHERALS; ++i)
+        {
+            mScheduler.schedule(mSubNodes[i], currentTimeUs);
+        }
+    }
 
-    // See if there is anything to receive
+    // Every response from the main peripheral also reports which sub peripherals are connected
     uint32_t len = 0;
     bool newData = false;
     const uint32_t* dat = mBus.getReadData(len, newData);
     if (newData)
     {
-        uint8_t sendAddr = *dat >> 8 & 0xFF;
-        uint8_t recAddr = *dat >> 16 & 0xFF;
-        uint8_t cmd = *dat >> 24;
-        const uint32_t* payload = dat + 1;
-        --len;
+        MaplePacket packet(dat, len);
+        uint8_t sendAddr = packet.getSenderAddr();
+        uint8_t recAddr = packet.getRecipientAddr();
 
-        if (recAddr == 0x00)
+        if (recAddr == DreamcastPeripheral::HOST_ADDR && (sendAddr & mAddr))
         {
-            // This packet was meant for me
-
-            if (sendAddr & mAddr)
+            // Use the sender address to determine what sub peripherals are connected
+            for (uint32_t i = 0; i < DreamcastPeripheral::MAX_SUB_PERIPHERALS; ++i)
             {
-                // Use the sender address to determine what sub peripherals are connected
-                for (std::vector<std::shared_ptr<DreamcastSubNode>>::iterator iter = mSubNodes.begin();
-                     iter != mSubNodes.end();
-                     ++iter)
-                {
-                    uint8_t mask = (*iter)->getAddr();
-                    (*iter)->setConnected((sendAddr & mask) != 0);
-                }
-
-                // Have the device handle the data
-                handleData(len, cmd, payload);
-            }
-            else
-            {
-                int32_t idx = DreamcastPeripheral::subPeripheralIndex(sendAddr);
-                if (idx >= 0 && (uint32_t)idx < mSubNodes.size())
-                {
-                    mSubNodes[idx]->handleData(len, cmd, payload);
-                }
+                uint8_t mask = mSubNodes[i]->getAddr();
+                mSubNodes[i]->setConnected((sendAddr & mask) != 0);
             }
         }
     }
 
     // See if there is something that needs to write
-    if (mPeripherals.size() > 0)
+    if (!mPeripheral.isEmpty())
     {
         // Have the connected main peripheral handle write
-        if (handlePeripherals(currentTimeUs))
+        bool connected = true;
+        if (currentTimeUs >= mNextPeripheralsDueTime)
         {
-            for (std::vector<std::shared_ptr<DreamcastSubNode>>::iterator iter = mSubNodes.begin();
-                 iter != mSubNodes.end();
-                 ++iter)
-            {
-                (*iter)->task(currentTimeUs);
-            }
+            connected = handlePeripherals(currentTimeUs);
+            mNextPeripheralsDueTime = getPeripheralsDueTime();
+        }
+
+        if (connected)
+        {
+            // Only the sub nodes which are due are run
+            mScheduler.runDue(currentTimeUs);
         }
         else
         {
             // Main peripheral disconnected
-            for (std::vector<std::shared_ptr<DreamcastSubNode>>::iterator iter = mSubNodes.begin();
-                 iter != mSubNodes.end();
-                 ++iter)
+            for (uint32_t i = 0; i < DreamcastPeripheral::MAX_SUB_PERIPHERALS; ++i)
             {
-                (*iter)->mainPeripheralDisconnected();
+                mSubNodes[i]->mainPeripheralDisconnected();
             }
             mNextCheckTime = currentTimeUs;
         }
@@ -107,14 +107,28 @@ void DreamcastMainNode::task(uint64_t currentTimeUs)
     // Otherwise, keep looking for info from a main peripheral
     else if (currentTimeUs >= mNextCheckTime)
     {
-        // This will return false if bus is busy
-        if (mBus.write(COMMAND_DEVICE_INFO_REQUEST,
-                       DreamcastPeripheral::getRecipientAddress(mPlayerData.playerIndex, mAddr),
-                       NULL,
-                       0,
-                       true))
+        // This will return false if the bus queue is full or a request is already outstanding
+        if (requestInfo())
         {
-            mNextCheckTime = currentTimeUs + US_PER_CHECK;
+            mNextCheckTime = currentTimeUs + mDiscoveryGovernor.getPeriodUs();
         }
     }
+}
+
+uint64_t DreamcastMainNode::getNextDueTime()
+{
+    uint64_t dueTime = DeadlineScheduler::NEVER;
+    if (!mPeripheral.isEmpty())
+    {
+        dueTime = mScheduler.getNextDueTime();
+        if (mNextPeripheralsDueTime < dueTime)
+        {
+            dueTime = mNextPeripheralsDueTime;
+        }
+    }
+    else if (!mInfoRequestPending)
+    {
+        dueTime = mNextCheckTime;
+    }
+    return dueTime;
 }
\ No newline at end of file
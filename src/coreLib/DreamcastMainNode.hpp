@@ -4,20 +4,25 @@
 #include "DreamcastSubNode.hpp"
 #include "MapleBusInterface.hpp"
 #include "DreamcastPeripheral.hpp"
-
-#include <memory>
-#include <vector>
+#include "DeadlineScheduler.hpp"
 
 //! Handles communication for the main Dreamcast node for a single bus. In other words, this
 //! facilitates communication to test for and identify a main peripheral such as a controller and
-//! routes received communication to that peripheral or a sub node under this.
+//! tracks which sub nodes under this are connected. Responses are routed by the bus to whichever
+//! node or peripheral submitted the request. Sub nodes are only run once they are due. Sub nodes are
+//! given at construction and every peripheral is held in place, so RAM use is fixed at link time.
 class DreamcastMainNode : public DreamcastNode
 {
     public:
         //! Constructor
         //! @param[in] bus  The bus on which this node communicates
         //! @param[in] playerData  The player data passed to any connected peripheral
-        DreamcastMainNode(MapleBusInterface& bus, PlayerData playerData);
+        //! @param[in] subNodes  The sub nodes under this node, indexed by sub peripheral index; each
+        //!                      must outlive this node
+        DreamcastMainNode(
+            MapleBusInterface& bus,
+            PlayerData playerData,
+            DreamcastSubNode* const (&subNodes)[DreamcastPeripheral::MAX_SUB_PERIPHERALS]);
 
         //! Virtual destructor
         virtual ~DreamcastMainNode();
@@ -25,18 +30,21 @@ class DreamcastMainNode : public DreamcastNode
         //! Inherited from DreamcastNode
         virtual void task(uint64_t currentTimeUs) final;
 
+        //! Inherited from DreamcastNode
+        virtual uint64_t getNextDueTime() final;
+
         //! Inherited from DreamcastNode
         virtual bool handleData(uint8_t len,
                                 uint8_t cmd,
                                 const uint32_t *payload) final;
 
-    public:
-        //! Number of microseconds in between each info request when no peripheral is detected
-        static const uint32_t US_PER_CHECK = 16000;
-
     protected:
         //! The clock time of the next info request when no peripheral is detected
         uint64_t mNextCheckTime;
+        //! The earliest time at which a task of the main peripheral is due
+        uint64_t mNextPeripheralsDueTime;
         //! The sub nodes under this node
-        std::vector<std::shared_ptr<DreamcastSubNode>> mSubNodes;
+        DreamcastSubNode* const mSubNodes[DreamcastPeripheral::MAX_SUB_PERIPHERALS];
+        //! Runs each sub node once it is due
+        DeadlineScheduler mScheduler;
 };
\ No newline at end of file
@@ -6,19 +6,25 @@
 #include "PlayerData.hpp"
 #include "DreamcastController.hpp"
 #include "DreamcastScreen.hpp"
+#include "MapleEncodedPacket.hpp"
+#include "MaplePacket.hpp"
+#include "DeadlineScheduler.hpp"
+#include "PollingGovernor.hpp"
+#include "PeripheralSlot.hpp"
 
 #include <stdint.h>
-#include <vector>
-#include <memory>
 
 //! Base class for an addressable node on a Maple Bus
-class DreamcastNode
+class DreamcastNode : public MapleTransactionObserver, public DeadlineScheduler::Task
 {
     public:
-        //! Virtual destructor
-        virtual ~DreamcastNode() {}
+        //! Virtual destructor - cancels any transactions still outstanding for this node
+        virtual ~DreamcastNode()
+        {
+            mBus.cancel(this);
+        }
 
-        //! Handles incoming data destined for this node
+        //! Handles a response to this node's info request
         //! @param[in] len  Number of words in payload
         //! @param[in] cmd  The received command
         //! @param[in] payload  Payload data associated with the command
@@ -31,82 +37,129 @@ class DreamcastNode
         //! @param[in] currentTimeUs  The current time in microseconds
         virtual void task(uint64_t currentTimeUs) = 0;
 
+        //! @returns the time at which task() next has something to do, or DeadlineScheduler::NEVER
+        //!          if that only changes once an outstanding transaction completes
+        virtual uint64_t getNextDueTime() = 0;
+
+        //! Inherited from DeadlineScheduler::Task; runs task() and reports when it is next due
+        virtual uint64_t runTask(uint64_t currentTimeUs)
+        {
+            task(currentTimeUs);
+            return getNextDueTime();
+        }
+
         //! @returns this node's address
         inline uint8_t getAddr() { return mAddr; }
 
+        //! Inherited from MapleTransactionObserver; passes info responses to handleData()
+        virtual void transactionComplete(Status status, const uint32_t* response, uint32_t len)
+        {
+            mInfoRequestPending = false;
+            MaplePacket packet(response, len);
+            if (status == STATUS_SUCCESS
+                && packet.isValid()
+                && handleData(packet.getPayloadLen(), packet.getCommand(), packet.getPayload()))
+            {
+                mDiscoveryGovernor.activity();
+            }
+            else
+            {
+                // Nothing answered, so look less often
+                mDiscoveryGovernor.idle();
+            }
+        }
+
     protected:
         //! Main constructor
         DreamcastNode(uint8_t addr, MapleBusInterface& bus, PlayerData playerData) :
-            mAddr(addr), mBus(bus), mPlayerData(playerData), mPeripherals()
-        {}
-
-        //! Copy constructor
-        DreamcastNode(const DreamcastNode& rhs) :
-            mAddr(rhs.mAddr),
-            mBus(rhs.mBus),
-            mPlayerData(rhs.mPlayerData),
-            mPeripherals()
+            mAddr(addr),
+            mBus(bus),
+            mPlayerData(playerData),
+            mPeripheral(),
+            mInfoRequestPacket(),
+            mInfoRequestPending(false),
+            mDiscoveryGovernor(discoveryProfile(), NULL)
         {
-            mPeripherals = rhs.mPeripherals;
+            encodeInfoRequest();
         }
 
-        //! Run all peripheral tasks
-        //! @param[in] currentTimeUs  The current time in microseconds
-        //! @return true if all peripherals connected; false if all have disconnected
-        bool handlePeripherals(uint64_t currentTimeUs)
+        //! Info requests go out at 60 Hz, backing off to about 8 Hz while nothing is attached. These
+        //! aren't charged against the polling budget since they stop once something is found.
+        static const PollingGovernor::Profile& discoveryProfile()
         {
-            bool connected = true;
-            for (std::vector<std::shared_ptr<DreamcastPeripheral>>::iterator iter = mPeripherals.begin();
-                 iter != mPeripherals.end() && connected;
-                 ++iter)
+            static const PollingGovernor::Profile profile = {
+                16000,  // minPeriodUs
+                128000, // maxPeriodUs
+                8,      // idlePollsPerBackoff
+                PollingGovernor::transactionCostUs(0, 28) // costUs
+            };
+            return profile;
+        }
+
+        //! Encodes the device info request for this node's address
+        void encodeInfoRequest()
+        {
+            mInfoRequestPacket.set(COMMAND_DEVICE_INFO_REQUEST,
+                                   DreamcastPeripheral::getRecipientAddress(mPlayerData.playerIndex, mAddr),
+                                   DreamcastPeripheral::HOST_ADDR,
+                                   static_cast<const uint32_t*>(NULL),
+                                   0);
+        }
+
+        //! Queues the info request unless one is already outstanding
+        //! @returns true iff the request was queued
+        bool requestInfo()
+        {
+            bool rv = false;
+            if (!mInfoRequestPending)
             {
-                if (!(*iter)->task(currentTimeUs))
-                {
-                    connected = false;
-                }
+                // Device info responses are 28 words
+                MapleTransaction transaction = {&mInfoRequestPacket,
+                                                 true,
+                                                 MapleBusInterface::readTimeoutUs(28),
+                                                 this,
+                                                 MapleTransaction::TRAFFIC_BULK};
+                rv = mBus.submit(transaction);
+                mInfoRequestPending = rv;
             }
+            return rv;
+        }
+
+        //! Run the peripheral's task
+        //! @param[in] currentTimeUs  The current time in microseconds
+        //! @return true if the peripheral is connected; false if it has disconnected
+        bool handlePeripherals(uint64_t currentTimeUs)
+        {
+            bool connected = mPeripheral.task(currentTimeUs);
 
             if (!connected)
             {
-                // One peripheral is no longer responding, so remove all
-                mPeripherals.clear();
+                // The peripheral is no longer responding, so remove it
+                mPeripheral.clear();
             }
 
             return connected;
         }
 
-        //! Try to get peripherals to handle the given data
-        //! @param[in] len  Number of words in payload
-        //! @param[in] cmd  The received command
-        //! @param[in] payload  Payload data associated with the command
-        //! @returns true iff the data was handled
-        bool handlePeripheralData(uint8_t len,
-                                  uint8_t cmd,
-                                  const uint32_t *payload)
+        //! @returns the time at which the peripheral's task is due
+        uint64_t getPeripheralsDueTime()
         {
-            bool handled = false;
-            for (std::vector<std::shared_ptr<DreamcastPeripheral>>::iterator iter = mPeripherals.begin();
-                 iter != mPeripherals.end() && !handled;
-                 ++iter)
-            {
-                handled = (*iter)->handleData(len, cmd, payload);
-            }
-            return handled;
+            return mPeripheral.getNextDueTime();
         }
 
         //! Factory function which generates peripheral objects for the given function code mask
         //! @param[in] functionCode  The function code mask
         virtual void peripheralFactory(uint32_t functionCode)
         {
-            mPeripherals.clear();
+            mPeripheral.clear();
 
             if (functionCode & DEVICE_FN_CONTROLLER)
             {
-                mPeripherals.push_back(std::make_shared<DreamcastController>(mAddr, mBus, mPlayerData));
+                mPeripheral.create<DreamcastController>(mAddr, mBus, mPlayerData);
             }
             else if (functionCode & DEVICE_FN_LCD)
             {
-                mPeripherals.push_back(std::make_shared<DreamcastScreen>(mAddr, mBus, mPlayerData));
+                mPeripheral.create<DreamcastScreen>(mAddr, mBus, mPlayerData);
             }
             // TODO: handle other peripherals here
             // TODO: add a stub peripheral if none were created
@@ -116,6 +169,9 @@ class DreamcastNode
         //! Default constructor - not implemented
         DreamcastNode();
 
+        //! Copy constructor - not implemented (peripherals are held in place)
+        DreamcastNode(const DreamcastNode&);
+
     protected:
         //! Maximum number of players
         static const uint32_t MAX_NUM_PLAYERS = 4;
@@ -125,6 +181,13 @@ class DreamcastNode
         MapleBusInterface& mBus;
         //! Player data on this node
         PlayerData mPlayerData;
-        //! The connected peripherals addressed to this node (usually 0 to 2 items)
-        std::vector<std::shared_ptr<DreamcastPeripheral>> mPeripherals;
+        //! The connected peripheral addressed to this node, made in place by peripheralFactory()
+        //! and dispatched statically
+        PeripheralSlot<DreamcastController, DreamcastScreen> mPeripheral;
+        //! Device info request for this node, encoded once and sent on every check
+        MapleEncodedPacketBuffer<0> mInfoRequestPacket;
+        //! True while mInfoRequestPacket is queued or in progress on the bus
+        bool mInfoRequestPending;
+        //! Sets the time between info requests while no peripheral is detected
+        PollingGovernor mDiscoveryGovernor;
 };
\ No newline at end of file
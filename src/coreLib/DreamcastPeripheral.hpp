@@ -2,9 +2,11 @@
 
 #include <stdint.h>
 #include "MapleBusInterface.hpp"
+#include "DeadlineScheduler.hpp"
 
-//! Base class for a connected Dreamcast peripheral
-class DreamcastPeripheral
+//! Base class for a connected Dreamcast peripheral. Each peripheral observes the transactions it
+//! submits, so responses are routed straight back to the peripheral which requested them.
+class DreamcastPeripheral : public MapleTransactionObserver
 {
     public:
         //! Constructor
@@ -15,8 +17,11 @@ class DreamcastPeripheral
             mBus(bus), mPlayerIndex(playerIndex), mAddr(addr)
         {}
 
-        //! Virtual destructor
-        virtual ~DreamcastPeripheral() {}
+        //! Virtual destructor - cancels any transactions still outstanding for this peripheral
+        virtual ~DreamcastPeripheral()
+        {
+            mBus.cancel(this);
+        }
 
         //! Handles incoming data destined for this device
         //! @param[in] len  Number of words in payload
@@ -34,21 +39,6 @@ class DreamcastPeripheral
             return SUB_PERIPHERAL_ADDR_START_MASK << subPeripheralIndex;
         }
 
-        //! @param[in] subPeripheralMask  Sub peripheral mask
-        //! @returns the index of the first sub peripheral mask that was matched
-        static inline int32_t subPeripheralIndex(uint8_t subPeripheralMask)
-        {
-            uint8_t mask = SUB_PERIPHERAL_ADDR_START_MASK;
-            for (uint32_t i = 0; i < MAX_SUB_PERIPHERALS; ++i, mask<<=1)
-            {
-                if (subPeripheralMask & mask)
-                {
-                    return i;
-                }
-            }
-            return -1;
-        }
-
         //! Get recipient address for a peripheral with given player index and address
         //! @param[in] playerIndex  Player index of peripheral [0,3]
         //! @param[in] addr  Peripheral's address (mask bit)
@@ -66,6 +56,10 @@ class DreamcastPeripheral
         //! @returns true iff still connected
         virtual bool task(uint64_t currentTimeUs) = 0;
 
+        //! @returns the time at which task() next has something to do, or DeadlineScheduler::NEVER
+        //!          if that only changes once an outstanding transaction completes
+        virtual uint64_t getNextDueTime() const = 0;
+
     public:
         //! The maximum number of sub peripherals that a main peripheral can handle
         static const uint32_t MAX_SUB_PERIPHERALS = 5;
@@ -73,6 +67,8 @@ class DreamcastPeripheral
         static const uint8_t MAIN_PERIPHERAL_ADDR_MASK = 0x20;
         //! The first sub peripheral address
         static const uint8_t SUB_PERIPHERAL_ADDR_START_MASK = 0x01;
+        //! The address of the host (this device)
+        static const uint8_t HOST_ADDR = 0x00;
 
     protected:
         //! The bus that this peripheral is connected to
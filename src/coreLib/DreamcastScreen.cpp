@@ -1,13 +1,24 @@
 #include "DreamcastScreen.hpp"
 #include "dreamcast_constants.h"
+#include "MaplePacket.hpp"
+
+const PollingGovernor::Profile DreamcastScreen::POLLING_PROFILE = {
+    16000,  // minPeriodUs
+    16000,  // maxPeriodUs
+    1,      // idlePollsPerBackoff
+    PollingGovernor::transactionCostUs(ScreenData::NUM_SCREEN_WORDS + 2, 0) // costUs
+};
 
 DreamcastScreen::DreamcastScreen(uint8_t addr, MapleBusInterface& bus, PlayerData playerData) :
     DreamcastPeripheral(addr, bus, playerData.playerIndex),
+    mGovernor(POLLING_PROFILE, &playerData.pollingBudget),
     mNextCheckTime(0),
-    mWaitingForData(false),
+    mWriteInFlight(false),
     mNoDataCount(0),
-    mFirstWrite(true),
-    mScreenData(playerData.screenData)
+    mLastVersion(ScreenData::NO_VERSION),
+    mWritePending(false),
+    mScreenData(playerData.screenData),
+    mWritePacket()
 {}
 
 DreamcastScreen::~DreamcastScreen()
@@ -17,50 +28,85 @@ bool DreamcastScreen::handleData(uint8_t len,
                         uint8_t cmd,
                         const uint32_t *payload)
 {
-    if (mWaitingForData)
-    {
-        mWaitingForData = false;
-        mNoDataCount = 0;
+    // The return code is ignored; a write which gets no valid response is resent by
+    // transactionComplete()
+    return true;
+}
 
-        // TODO: return code is ignored for now; in the future, try to resend on failure
+void DreamcastScreen::transactionComplete(Status status,
+                                          const uint32_t* response,
+                                          uint32_t len)
+{
+    mWriteInFlight = false;
 
-        return true;
+    MaplePacket packet(response, len);
+    if (status == STATUS_SUCCESS
+        && packet.isValid()
+        && handleData(packet.getPayloadLen(), packet.getCommand(), packet.getPayload()))
+    {
+        mNoDataCount = 0;
+    }
+    else
+    {
+        ++mNoDataCount;
+        // The screen may not have taken the write, so send it again even if no new screen data
+        // gets published
+        mWritePending = true;
     }
-    return false;
 }
 
 bool DreamcastScreen::task(uint64_t currentTimeUs)
 {
     bool connected = (mNoDataCount < NO_DATA_DISCONNECT_COUNT);
-    if (currentTimeUs > mNextCheckTime)
+    // The bus reads straight out of mWritePacket, so it is only touched while nothing is in flight
+    if (connected && !mWriteInFlight && currentTimeUs >= mNextCheckTime)
     {
-        // Increment count if we are still waiting for response from the last communication attempt
-        if (mWaitingForData)
+        // Write screen data
+        static const uint8_t partitionNum = 0; // Always 0
+        static const uint8_t sequenceNum = 0;  // 1 and only 1 in this sequence - always 0
+        static const uint16_t blockNum = 0;    // Always 0
+        static const uint32_t writeAddrWord =
+            MaplePacket::makeBlockAddr(partitionNum, sequenceNum, blockNum);
+        static const uint32_t header[2] = {DEVICE_FN_LCD, writeAddrWord};
+        // Screen words are encoded straight out of screen data storage, and only when a new
+        // screen has been published
+        if (mScreenData.readData(mWritePacket,
+                                 COMMAND_BLOCK_WRITE,
+                                 getRecipientAddress(),
+                                 HOST_ADDR,
+                                 header,
+                                 2,
+                                 mLastVersion))
         {
-            ++mNoDataCount;
-            mWaitingForData = false;
-            connected = (mNoDataCount < NO_DATA_DISCONNECT_COUNT);
+            mWritePending = true;
         }
 
-        if (connected && (mScreenData.isNewDataAvailable() || mFirstWrite))
+        if (mWritePending)
         {
-            // Write screen data
-            static const uint8_t partitionNum = 0; // Always 0
-            static const uint8_t sequenceNum = 0;  // 1 and only 1 in this sequence - always 0
-            static const uint16_t blockNum = 0;    // Always 0
-            static const uint32_t writeAddrWord = (partitionNum << 24) | (sequenceNum << 16) | blockNum;
-            uint32_t numPayloadWords = ScreenData::NUM_SCREEN_WORDS + 2;
-            uint32_t payload[numPayloadWords] = {DEVICE_FN_LCD, writeAddrWord, 0};
-            mScreenData.readData(&payload[2]);
-
-            if (mBus.write(COMMAND_BLOCK_WRITE, getRecipientAddress(), payload, numPayloadWords, true))
+            // The response (an acknowledgement with no payload) comes back through
+            // transactionComplete()
+            MapleTransaction transaction = {&mWritePacket,
+                                             true,
+                                             MapleBusInterface::readTimeoutUs(0),
+                                             this,
+                                             MapleTransaction::TRAFFIC_BULK};
+            if (mBus.submit(transaction))
             {
-                mWaitingForData = true;
-                mNextCheckTime = currentTimeUs + US_PER_CHECK;
+                mWriteInFlight = true;
+                mNextCheckTime = currentTimeUs + mGovernor.getPeriodUs();
+                mWritePending = false;
             }
-
-            mFirstWrite = false;
+        }
+        else
+        {
+            // Nothing to write - look for new screen data again at the next interval
+            mNextCheckTime = currentTimeUs + mGovernor.getPeriodUs();
         }
     }
     return true;
+}
+
+uint64_t DreamcastScreen::getNextDueTime() const
+{
+    return mWriteInFlight ? DeadlineScheduler::NEVER : mNextCheckTime;
 }
\ No newline at end of file
@@ -2,11 +2,13 @@
 
 #include "DreamcastPeripheral.hpp"
 #include "MapleBusInterface.hpp"
+#include "MapleEncodedPacket.hpp"
 #include "ScreenData.hpp"
 #include "PlayerData.hpp"
+#include "PollingGovernor.hpp"
 
 //! Handles communication with the Dreamcast screen peripheral
-class DreamcastScreen : public DreamcastPeripheral
+class DreamcastScreen final : public DreamcastPeripheral
 {
     public:
         //! Constructor
@@ -26,20 +28,34 @@ class DreamcastScreen : public DreamcastPeripheral
         //! Inherited from DreamcastPeripheral
         virtual bool task(uint64_t currentTimeUs) final;
 
+        //! Inherited from DreamcastPeripheral
+        virtual uint64_t getNextDueTime() const final;
+
+        //! Inherited from MapleTransactionObserver
+        virtual void transactionComplete(Status status,
+                                         const uint32_t* response,
+                                         uint32_t len) final;
+
     private:
         //! Number of times failed communication occurs before determining that the screen is
         //! disconnected
         static const uint32_t NO_DATA_DISCONNECT_COUNT = 5;
-        //! Time between each screen state poll (in microseconds)
-        static const uint32_t US_PER_CHECK = 16000;
+        //! Screen data is checked at 60 Hz, and a full screen write is budgeted for each check
+        static const PollingGovernor::Profile POLLING_PROFILE;
+        //! Sets the time between each screen state poll and reserves bus time for the writes
+        PollingGovernor mGovernor;
         //! Time which the next screen state poll will occur
         uint64_t mNextCheckTime;
-        //! True iff the screen is waiting for data
-        bool mWaitingForData;
+        //! True while mWritePacket is queued or in progress on the bus
+        bool mWriteInFlight;
         //! Number of consecutive times no data was received
         uint32_t mNoDataCount;
-        //! Initialized to true and set to false once the initial write is performed
-        bool mFirstWrite;
+        //! Version of the screen data last read (initially none, so the first screen is written)
+        uint32_t mLastVersion;
+        //! True when mWritePacket holds screen data which hasn't been sent yet
+        bool mWritePending;
         //! Reference to screen data which is externally modified in internally read
         ScreenData& mScreenData;
+        //! The last encoded screen write; only re-encoded when the screen data changes
+        MapleEncodedPacketBuffer<ScreenData::NUM_SCREEN_WORDS + 2> mWritePacket;
 };
@@ -1,5 +1,6 @@
 #include "DreamcastSubNode.hpp"
 #include "dreamcast_constants.h"
+#include "MaplePacket.hpp"
 
 
 DreamcastSubNode::DreamcastSubNode(uint8_t addr, MapleBusInterface& bus, PlayerData playerData) :
@@ -9,26 +10,19 @@ DreamcastSubNode::DreamcastSubNode(uint8_t addr, MapleBusInterface& bus, PlayerD
 {
 }
 
-DreamcastSubNode::DreamcastSubNode(const DreamcastSubNode& rhs) :
-    DreamcastNode(rhs),
-    mNextCheckTime(rhs.mNextCheckTime),
-    mConnected(rhs.mConnected)
-{
-}
-
 bool DreamcastSubNode::handleData(uint8_t len,
                         uint8_t cmd,
                         const uint32_t *payload)
 {
     // If device info received, add the sub peripheral
-    if (cmd == COMMAND_RESPONSE_DEVICE_INFO)
+    MaplePacket packet(cmd, payload, len);
+    if (packet.getCommand() == COMMAND_RESPONSE_DEVICE_INFO)
     {
-        peripheralFactory(payload[0]);
-        return (mPeripherals.size() > 0);
+        peripheralFactory(packet.getFunctionCode());
+        return (!mPeripheral.isEmpty());
     }
 
-    // Pass data to sub peripheral
-    return handlePeripheralData(len, cmd, payload);
+    return false;
 }
 
 void DreamcastSubNode::task(uint64_t currentTimeUs)
@@ -36,16 +30,12 @@ void DreamcastSubNode::task(uint64_t currentTimeUs)
     if (mConnected && currentTimeUs >= mNextCheckTime)
     {
         // Request device info new device was newly attached
-        if (mPeripherals.size() <= 0)
+        if (mPeripheral.isEmpty())
         {
-            // This will return false if bus is busy
-            if (mBus.write(COMMAND_DEVICE_INFO_REQUEST,
-                        DreamcastPeripheral::getRecipientAddress(mPlayerData.playerIndex, mAddr),
-                        NULL,
-                        0,
-                        true))
+            // This will return false if the bus queue is full or a request is already outstanding
+            if (requestInfo())
             {
-                mNextCheckTime = currentTimeUs + US_PER_CHECK;
+                mNextCheckTime = currentTimeUs + mDiscoveryGovernor.getPeriodUs();
             }
         }
         // Handle operations for peripherals (run task() of all peripherals)
@@ -62,9 +52,30 @@ void DreamcastSubNode::task(uint64_t currentTimeUs)
     }
 }
 
+uint64_t DreamcastSubNode::getNextDueTime()
+{
+    uint64_t dueTime = DeadlineScheduler::NEVER;
+    if (mConnected)
+    {
+        if (mPeripheral.isEmpty())
+        {
+            // The info request is repeated only after the outstanding one completes
+            if (!mInfoRequestPending)
+            {
+                dueTime = mNextCheckTime;
+            }
+        }
+        else
+        {
+            dueTime = getPeripheralsDueTime();
+        }
+    }
+    return dueTime;
+}
+
 void DreamcastSubNode::mainPeripheralDisconnected()
 {
-    mPeripherals.clear();
+    mPeripheral.clear();
 }
 
 void DreamcastSubNode::setConnected(bool connected)
@@ -75,7 +86,7 @@ void DreamcastSubNode::setConnected(bool connected)
         if (!mConnected)
         {
             // Once something has been disconnected, clear all peripherals
-            mPeripherals.clear();
+            mPeripheral.clear();
         }
     }
 }
\ No newline at end of file
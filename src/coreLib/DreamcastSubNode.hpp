@@ -12,9 +12,6 @@ class DreamcastSubNode : public DreamcastNode
         //! @param[in] playerData  The player data passed to any connected peripheral
         DreamcastSubNode(uint8_t addr, MapleBusInterface& bus, PlayerData playerData);
 
-        //! Copy constructor
-        DreamcastSubNode(const DreamcastSubNode& rhs);
-
         //! Inherited from DreamcastNode
         virtual bool handleData(uint8_t len,
                                 uint8_t cmd,
@@ -23,6 +20,9 @@ class DreamcastSubNode : public DreamcastNode
         //! Inherited from DreamcastNode
         virtual void task(uint64_t currentTimeUs);
 
+        //! Inherited from DreamcastNode
+        virtual uint64_t getNextDueTime();
+
         //! Called from the main node when a main peripheral disconnects. A main peripheral
         //! disconnecting should cause all sub peripherals to disconnect.
         virtual void mainPeripheralDisconnected();
@@ -31,8 +31,6 @@ class DreamcastSubNode : public DreamcastNode
         virtual void setConnected(bool connected);
 
     private:
-        //! Number of microseconds in between each info request when no peripheral is detected
-        static const uint32_t US_PER_CHECK = 16000;
         //! The clock time of the next info request when no peripheral is detected
         uint64_t mNextCheckTime;
         //! Detected peripheral connection state
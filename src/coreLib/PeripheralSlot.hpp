@@ -0,0 +1,170 @@
+#pragma once
+
+#include "DreamcastPeripheral.hpp"
+#include "DeadlineScheduler.hpp"
+
+#include <stdint.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+//! Storage for one peripheral of any of the given types. The peripheral is constructed in place
+//! and destroyed in place, so peripherals may come and go without ever touching the heap. The size
+//! of the storage is fixed at compile time by the largest of the given types.
+//!
+//! The slot remembers which of the given types it holds, so calls into the peripheral are
+//! dispatched statically: each type's final methods are called directly rather than through the
+//! vtable, and the compiler is free to inline them. A peripheral of any other type may be referred
+//! to by the slot without being owned by it, in which case calls are dispatched virtually.
+//! @tparam Types  Every peripheral type which may be created in this slot (each must be final)
+template <typename... Types>
+class PeripheralSlot
+{
+    public:
+        //! Constructor - the slot starts out empty
+        PeripheralSlot() :
+            mStorage(),
+            mPeripheral(NULL),
+            mType(TYPE_EMPTY)
+        {}
+
+        //! Destructor - destroys the peripheral held, if any
+        ~PeripheralSlot()
+        {
+            clear();
+        }
+
+        //! Creates a peripheral in this slot, clearing the one held before
+        //! @tparam T  The type of peripheral to create
+        //! @param[in] args  The arguments passed to the constructor of T
+        //! @returns the created peripheral
+        template <typename T, typename... Args>
+        T* create(Args&&... args)
+        {
+            static_assert(std::is_base_of<DreamcastPeripheral, T>::value,
+                          "Only peripherals may be created in a peripheral slot");
+            static_assert(std::is_final<T>::value,
+                          "Peripherals are dispatched statically, so they must be final");
+            static_assert(sizeof(T) <= sizeof(mStorage), "Peripheral slot too small for type");
+            static_assert(alignof(T) <= alignof(Storage), "Peripheral slot misaligned for type");
+            clear();
+            T* peripheral = new (&mStorage) T(std::forward<Args>(args)...);
+            mPeripheral = peripheral;
+            mType = TypeIndex<T, Types...>::VALUE;
+            return peripheral;
+        }
+
+        //! Refers to a peripheral which is owned elsewhere, clearing the one held before
+        //! @param[in] peripheral  The peripheral (must outlive its place in this slot)
+        void refer(DreamcastPeripheral* peripheral)
+        {
+            clear();
+            if (peripheral != NULL)
+            {
+                mPeripheral = peripheral;
+                mType = TYPE_REFERENCED;
+            }
+        }
+
+        //! Destroys the peripheral held or forgets the one referred to, if any
+        void clear()
+        {
+            if (mType >= TYPE_FIRST)
+            {
+                mPeripheral->~DreamcastPeripheral();
+            }
+            mPeripheral = NULL;
+            mType = TYPE_EMPTY;
+        }
+
+        //! @returns true iff no peripheral is held or referred to
+        inline bool isEmpty() const { return (mType == TYPE_EMPTY); }
+
+        //! @returns the peripheral held or referred to, or NULL if empty
+        inline DreamcastPeripheral* get() const { return mPeripheral; }
+
+        //! Runs the task of the peripheral
+        //! @param[in] currentTimeUs  The current time in microseconds
+        //! @returns true iff still connected (true when empty)
+        inline bool task(uint64_t currentTimeUs)
+        {
+            return Dispatch<TYPE_FIRST, Types...>::task(mType, mPeripheral, currentTimeUs);
+        }
+
+        //! @returns the time at which the peripheral's task is next due (NEVER when empty)
+        inline uint64_t getNextDueTime() const
+        {
+            return Dispatch<TYPE_FIRST, Types...>::getNextDueTime(mType, mPeripheral);
+        }
+
+    private:
+        //! Copy constructor - not implemented
+        PeripheralSlot(const PeripheralSlot&);
+
+        //! Assignment operator - not implemented
+        PeripheralSlot& operator=(const PeripheralSlot&);
+
+        //! Type index of an empty slot
+        static const uint32_t TYPE_EMPTY = 0;
+        //! Type index of a peripheral which is referred to but not owned
+        static const uint32_t TYPE_REFERENCED = 1;
+        //! Type index of the first of Types; the rest follow in order
+        static const uint32_t TYPE_FIRST = 2;
+
+        //! Finds the type index of T within Types
+        template <typename T, typename First, typename... Rest>
+        struct TypeIndex
+        {
+            static const uint32_t VALUE = TypeIndex<T, Rest...>::VALUE + 1;
+        };
+
+        template <typename T, typename... Rest>
+        struct TypeIndex<T, T, Rest...>
+        {
+            static const uint32_t VALUE = TYPE_FIRST;
+        };
+
+        //! Calls into the peripheral as whichever type it holds, checking each type in turn
+        template <uint32_t INDEX, typename... Remaining>
+        struct Dispatch
+        {
+            // None of Types matched, so the peripheral is referenced or there is none
+            static inline bool task(uint32_t type, DreamcastPeripheral* p, uint64_t currentTimeUs)
+            {
+                return (type == TYPE_EMPTY) || p->task(currentTimeUs);
+            }
+
+            static inline uint64_t getNextDueTime(uint32_t type, const DreamcastPeripheral* p)
+            {
+                return (type == TYPE_EMPTY) ? DeadlineScheduler::NEVER : p->getNextDueTime();
+            }
+        };
+
+        template <uint32_t INDEX, typename T, typename... Rest>
+        struct Dispatch<INDEX, T, Rest...>
+        {
+            static inline bool task(uint32_t type, DreamcastPeripheral* p, uint64_t currentTimeUs)
+            {
+                return (type == INDEX)
+                    ? static_cast<T*>(p)->T::task(currentTimeUs)
+                    : Dispatch<INDEX + 1, Rest...>::task(type, p, currentTimeUs);
+            }
+
+            static inline uint64_t getNextDueTime(uint32_t type, const DreamcastPeripheral* p)
+            {
+                return (type == INDEX)
+                    ? static_cast<const T*>(p)->T::getNextDueTime()
+                    : Dispatch<INDEX + 1, Rest...>::getNextDueTime(type, p);
+            }
+        };
+
+    private:
+        //! Raw storage suitable for any of the given types
+        typedef typename std::aligned_union<0, Types...>::type Storage;
+        //! Where a created peripheral is constructed
+        Storage mStorage;
+        //! The peripheral held or referred to, or NULL if empty
+        DreamcastPeripheral* mPeripheral;
+        //! Which kind of peripheral mPeripheral is (one of the TYPE_ values or a following index)
+        uint32_t mType;
+};
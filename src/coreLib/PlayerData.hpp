@@ -2,6 +2,8 @@
 
 #include "DreamcastControllerObserver.hpp"
 #include "ScreenData.hpp"
+#include "PollingGovernor.hpp"
+#include "UsbSofClock.hpp"
 
 //! Contains data that is tied to a specific player
 struct PlayerData
@@ -9,4 +11,7 @@ struct PlayerData
     const uint32_t playerIndex;
     DreamcastControllerObserver& gamepad;
     ScreenData& screenData;
+    PollingBudget& pollingBudget;
+    const UsbSofClock& usbSofClock;
+    FramePhaseMonitor& framePhaseMonitor;
 };
\ No newline at end of file
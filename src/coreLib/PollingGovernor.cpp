@@ -0,0 +1,95 @@
+#include "PollingGovernor.hpp"
+#include "configuration.h"
+
+PollingBudget::PollingBudget(uint32_t capacityPermille) :
+    mCapacityPermille(capacityPermille),
+    mUsedPermille(0)
+{}
+
+uint32_t PollingBudget::claim(uint32_t loadPermille)
+{
+    uint32_t available = getAvailablePermille();
+    if (loadPermille > available)
+    {
+        loadPermille = available;
+    }
+    mUsedPermille += loadPermille;
+    return loadPermille;
+}
+
+void PollingBudget::release(uint32_t loadPermille)
+{
+    mUsedPermille -= (loadPermille < mUsedPermille) ? loadPermille : mUsedPermille;
+}
+
+PollingGovernor::PollingGovernor(const Profile& profile, PollingBudget* budget) :
+    mProfile(profile),
+    mBudget(budget),
+    mPeriodUs(profile.maxPeriodUs),
+    mClaimedPermille(0),
+    mIdleCount(0)
+{
+    setPeriod(mProfile.minPeriodUs);
+}
+
+PollingGovernor::~PollingGovernor()
+{
+    if (mBudget != NULL)
+    {
+        mBudget->release(mClaimedPermille);
+    }
+}
+
+void PollingGovernor::activity()
+{
+    mIdleCount = 0;
+    if (mPeriodUs != mProfile.minPeriodUs)
+    {
+        setPeriod(mProfile.minPeriodUs);
+    }
+}
+
+void PollingGovernor::idle()
+{
+    if (++mIdleCount >= mProfile.idlePollsPerBackoff && mPeriodUs < mProfile.maxPeriodUs)
+    {
+        mIdleCount = 0;
+        setPeriod(mPeriodUs * 2);
+    }
+}
+
+uint32_t PollingGovernor::transactionCostUs(uint32_t writeWords, uint32_t responseWords)
+{
+    // Frame word, payload, and CRC byte each way plus start and end sequences of about a byte each
+    static const uint32_t OVERHEAD_BITS = (4 + 1 + 2) * 8;
+    // Time a peripheral typically takes to start responding
+    static const uint32_t TURNAROUND_US = 100;
+    uint32_t bits = (writeWords + responseWords) * 32 + (2 * OVERHEAD_BITS);
+    return (bits * MAPLE_NS_PER_BIT / 1000) + TURNAROUND_US;
+}
+
+void PollingGovernor::setPeriod(uint32_t periodUs)
+{
+    if (periodUs > mProfile.maxPeriodUs)
+    {
+        periodUs = mProfile.maxPeriodUs;
+    }
+
+    if (mBudget != NULL)
+    {
+        mBudget->release(mClaimedPermille);
+        uint32_t loadPermille = (mProfile.costUs * 1000 + periodUs - 1) / periodUs;
+        mClaimedPermille = mBudget->claim(loadPermille);
+        if (mClaimedPermille < loadPermille)
+        {
+            // Stretch the period to fit what's left of the budget, but never poll slower than the
+            // maximum period - a peripheral which isn't polled would look disconnected
+            uint32_t fitPeriodUs = (mClaimedPermille > 0)
+                                   ? (mProfile.costUs * 1000 + mClaimedPermille - 1) / mClaimedPermille
+                                   : mProfile.maxPeriodUs;
+            periodUs = (fitPeriodUs < mProfile.maxPeriodUs) ? fitPeriodUs : mProfile.maxPeriodUs;
+        }
+    }
+
+    mPeriodUs = periodUs;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//! Tracks how much of one bus's time is committed to periodic polling. Each PollingGovernor which
+//! shares a budget claims the fraction of bus time its poll rate costs, and a governor which would
+//! exceed the budget is held to a slower rate.
+class PollingBudget
+{
+    public:
+        //! Constructor
+        //! @param[in] capacityPermille  Portion of bus time which polling may use (1000 is all)
+        PollingBudget(uint32_t capacityPermille);
+
+        //! Claims as much of the given load as is available
+        //! @param[in] loadPermille  The load to claim
+        //! @returns the load which was actually claimed (no more than loadPermille)
+        uint32_t claim(uint32_t loadPermille);
+
+        //! Releases a load previously returned by claim()
+        //! @param[in] loadPermille  The load to release
+        void release(uint32_t loadPermille);
+
+        //! @returns the portion of bus time which hasn't been claimed
+        inline uint32_t getAvailablePermille() const { return mCapacityPermille - mUsedPermille; }
+
+    private:
+        //! Portion of bus time which polling may use
+        const uint32_t mCapacityPermille;
+        //! Portion of bus time currently claimed
+        uint32_t mUsedPermille;
+};
+
+//! Decides how often something is polled based on what kind of thing it is and whether its polls
+//! have recently turned up anything new. Activity drops the period straight to its minimum, and
+//! every run of idle polls doubles it up to its maximum.
+class PollingGovernor
+{
+    public:
+        //! Polling limits for one kind of peripheral
+        struct Profile
+        {
+            //! Shortest period, used while there is activity
+            uint32_t minPeriodUs;
+            //! Longest period, backed off to while idle
+            uint32_t maxPeriodUs;
+            //! Number of consecutive idle polls before the period is doubled
+            uint32_t idlePollsPerBackoff;
+            //! Bus time taken by one poll, including the response
+            uint32_t costUs;
+        };
+
+        //! Constructor - polling starts out at the minimum period
+        //! @param[in] profile  Polling limits
+        //! @param[in] budget  The budget of the bus being polled, or NULL if not budgeted
+        PollingGovernor(const Profile& profile, PollingBudget* budget);
+
+        //! Destructor - releases this governor's share of the budget
+        ~PollingGovernor();
+
+        //! @returns the time to wait between polls in microseconds
+        inline uint32_t getPeriodUs() const { return mPeriodUs; }
+
+        //! Called when a poll turned up something new
+        void activity();
+
+        //! Called when a poll turned up nothing new
+        void idle();
+
+        //! Estimates the bus time taken by a transaction of the given size
+        //! @param[in] writeWords  Number of payload words written
+        //! @param[in] responseWords  Number of payload words in the response
+        //! @returns the estimated time in microseconds
+        static uint32_t transactionCostUs(uint32_t writeWords, uint32_t responseWords);
+
+    private:
+        //! Moves to the given period, or to the shortest period at or above it the budget allows
+        void setPeriod(uint32_t periodUs);
+
+        //! Copy constructor - not implemented (a budget claim can't be shared)
+        PollingGovernor(const PollingGovernor&);
+        //! Assignment operator - not implemented
+        PollingGovernor& operator=(const PollingGovernor&);
+
+    private:
+        //! Polling limits
+        const Profile mProfile;
+        //! The budget of the bus being polled
+        PollingBudget* const mBudget;
+        //! Current time between polls
+        uint32_t mPeriodUs;
+        //! The load claimed from mBudget at mPeriodUs
+        uint32_t mClaimedPermille;
+        //! Number of consecutive idle polls since the period last changed
+        uint32_t mIdleCount;
+};
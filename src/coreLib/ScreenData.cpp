@@ -1,39 +1,120 @@
 #include "ScreenData.hpp"
 #include <string.h>
 #include <assert.h>
-#include <mutex>
-
-ScreenData::ScreenData(MutexInterface& mutex) :
-    mMutex(mutex),
-    // Default screen is a little VMU icon
-    mScreenData{
-        0x0000FFFF, 0x00000003, 0x8001C000, 0x00060000, 0x6000000C, 0x00003000, 0x0008000C, 0x10000009,
-        0xDC0C1000, 0x0009DC3F, 0x10000009, 0xDC3F1000, 0x0008000C, 0x10000008, 0x360C1000, 0x00083600,
-        0x10000008, 0x00001000, 0x00080000, 0x10000008, 0x7FFE1000, 0x0008FFFF, 0x10000008, 0xFFFF1000,
-        0x0008FFFF, 0x10000008, 0xFFFF1000, 0x0008FFFF, 0x10000008, 0xFFFF1000, 0x0008FFFF, 0x10000008,
-        0xFFFF1000, 0x0008FFFF, 0x10000008, 0xFFFF1000, 0x0008FFFF, 0x10000008, 0xFFFF1000, 0x0008FFFF,
-        0x10000008, 0x7FFE1000, 0x000C0000, 0x30000006, 0x00006000, 0x00038001, 0xC0000000, 0xFFFF0000
-    },
-    mNewDataAvailable(false)
+
+// Default screen is a little VMU icon
+static const uint32_t DEFAULT_SCREEN[ScreenData::NUM_SCREEN_WORDS] = {
+    0x0000FFFF, 0x00000003, 0x8001C000, 0x00060000, 0x6000000C, 0x00003000, 0x0008000C, 0x10000009,
+    0xDC0C1000, 0x0009DC3F, 0x10000009, 0xDC3F1000, 0x0008000C, 0x10000008, 0x360C1000, 0x00083600,
+    0x10000008, 0x00001000, 0x00080000, 0x10000008, 0x7FFE1000, 0x0008FFFF, 0x10000008, 0xFFFF1000,
+    0x0008FFFF, 0x10000008, 0xFFFF1000, 0x0008FFFF, 0x10000008, 0xFFFF1000, 0x0008FFFF, 0x10000008,
+    0xFFFF1000, 0x0008FFFF, 0x10000008, 0xFFFF1000, 0x0008FFFF, 0x10000008, 0xFFFF1000, 0x0008FFFF,
+    0x10000008, 0x7FFE1000, 0x000C0000, 0x30000006, 0x00006000, 0x00038001, 0xC0000000, 0xFFFF0000
+};
+
+const uint32_t ScreenData::NUM_SCREEN_WORDS;
+const uint32_t ScreenData::NO_VERSION;
+const uint32_t ScreenData::NUM_FRAMES;
+
+ScreenData::ScreenData() :
+    mFrames(),
+    mNewestIndex(0),
+    mReadingIndex(0)
+{
+    memcpy(mFrames[0].words, DEFAULT_SCREEN, sizeof(DEFAULT_SCREEN));
+    mFrames[0].version = NO_VERSION + 1;
+    mFrames[0].hash = computeHash(mFrames[0].words);
+}
+
+void ScreenData::setData(const uint32_t* data, uint32_t startIndex, uint32_t numWords)
+{
+    assert(startIndex + numWords <= NUM_SCREEN_WORDS);
+
+    // The barrier which ended the last publish orders it before this load of the reader's claim,
+    // and the reader orders its claim before checking that it is still the newest. So either the
+    // reader sees that the newest screen moved on, or the buffer it claimed is avoided here.
+    uint32_t newestIndex = mNewestIndex;
+    uint32_t readingIndex = mReadingIndex;
+    uint32_t nextIndex = 0;
+    while (nextIndex == newestIndex || nextIndex == readingIndex)
+    {
+        ++nextIndex;
+    }
+
+    const Frame& newest = mFrames[newestIndex];
+    Frame& next = mFrames[nextIndex];
+    if (startIndex > 0 || numWords < NUM_SCREEN_WORDS)
+    {
+        memcpy(next.words, newest.words, sizeof(next.words));
+    }
+    memcpy(next.words + startIndex, data, numWords * sizeof(data[0]));
+    next.version = newest.version + 1;
+    if (next.version == NO_VERSION)
+    {
+        ++next.version;
+    }
+    next.hash = computeHash(next.words);
+
+    // A redrawn screen isn't published again; the hash only rules out a redraw, so the words are
+    // compared once it matches
+    if (next.hash != newest.hash || memcmp(next.words, newest.words, sizeof(next.words)) != 0)
+    {
+        // Screen must be complete before it is published
+        __sync_synchronize();
+        mNewestIndex = nextIndex;
+        __sync_synchronize();
+    }
+}
+
+uint32_t ScreenData::readData(uint32_t* out)
 {
+    const Frame& frame = claimNewest();
+    memcpy(out, frame.words, sizeof(frame.words));
+    return frame.version;
 }
 
-void ScreenData::setData(uint32_t* data, uint32_t startIndex, uint32_t numWords)
+bool ScreenData::readData(MapleEncodedPacket& packet,
+                          uint8_t command,
+                          uint8_t recipientAddr,
+                          uint8_t senderAddr,
+                          const uint32_t* header,
+                          uint32_t headerLen,
+                          uint32_t& lastVersion)
 {
-    assert(startIndex + numWords <= sizeof(mScreenData));
-    std::lock_guard<MutexInterface> lockGuard(mMutex);
-    memcpy(mScreenData + startIndex, data, numWords);
-    mNewDataAvailable = true;
+    const Frame& frame = claimNewest();
+    // NO_VERSION is never published, so it never matches
+    bool encode = (frame.version != lastVersion);
+    lastVersion = frame.version;
+    if (encode)
+    {
+        const MapleCodec::Segment segments[2] = {
+            {header, headerLen},
+            {frame.words, NUM_SCREEN_WORDS}
+        };
+        packet.set(command, recipientAddr, senderAddr, segments, 2);
+    }
+    return encode;
 }
 
-bool ScreenData::isNewDataAvailable() const
+const ScreenData::Frame& ScreenData::claimNewest()
 {
-    return mNewDataAvailable;
+    uint32_t index;
+    do
+    {
+        index = mNewestIndex;
+        mReadingIndex = index;
+        // Claim must be visible to the writer before checking that it still holds the newest
+        __sync_synchronize();
+    } while (index != mNewestIndex);
+    return mFrames[index];
 }
 
-void ScreenData::readData(uint32_t* out)
+uint32_t ScreenData::computeHash(const uint32_t* words)
 {
-    std::lock_guard<MutexInterface> lockGuard(mMutex);
-    mNewDataAvailable = false;
-    memcpy(out, mScreenData, sizeof(mScreenData));
+    uint32_t hash = 2166136261U;
+    for (uint32_t i = NUM_SCREEN_WORDS; i > 0; --i)
+    {
+        hash = (hash ^ *words++) * 16777619U;
+    }
+    return hash;
 }
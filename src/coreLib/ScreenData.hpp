@@ -1,39 +1,92 @@
 #pragma once
 
-#include "MutexInterface.hpp"
+#include "MapleEncodedPacket.hpp"
 #include <stdint.h>
 
 //! Contains monochrome screen data
 //! A screen is 48 bits wide and 32 bits tall
+//!
+//! Screens are triple buffered so that one writer (USB core) and one reader (Maple core) never
+//! block each other. The writer always fills a buffer which is neither the newest screen nor the
+//! one the reader has claimed, then publishes it as the newest. The reader claims the newest
+//! screen and reads it in place. Each published screen carries a new version. A screen which is
+//! merely redrawn (its hash matches the newest screen's, and then so does every word) isn't
+//! published again, so the reader only ever sees a new version for a new screen.
 class ScreenData
 {
     public:
         //! Constructor
-        //! @param[in] mutex  Reference to the mutex to use
-        ScreenData(MutexInterface& mutex);
+        ScreenData();
 
-        //! Set the screen bits
+        //! Set the screen bits and publish the result as a new version, unless it is identical to
+        //! the newest screen. Only one context may call this. Words not covered by the given range
+        //! are carried over from the newest screen.
         //! @param[in] data  Screen words to set
         //! @param[in] startIndex  Starting screen word index (left to right, top to bottom)
         //! @param[in] numWords  Number of words to write
-        void setData(uint32_t* data, uint32_t startIndex=0, uint32_t numWords=NUM_SCREEN_WORDS);
+        void setData(const uint32_t* data,
+                     uint32_t startIndex=0,
+                     uint32_t numWords=NUM_SCREEN_WORDS);
 
-        //! @returns true if new data is available since last call to readData
-        bool isNewDataAvailable() const;
-
-        //! Copies screen data to the given array
+        //! Copies the newest screen data to the given array
         //! @param[out] out  The array to write to (must be at least 48 words in length)
-        void readData(uint32_t* out);
+        //! @returns the version of the screen copied
+        uint32_t readData(uint32_t* out);
+
+        //! Encodes a packet whose payload is the given header words followed by the newest screen
+        //! data, unless that screen's version was already read. The screen words are
+        //! encoded straight out of the claimed buffer, so no intermediate copy is made.
+        //! @param[out] packet  The packet to encode into
+        //! @param[in] command  The command byte - should be a value in Command enumeration
+        //! @param[in] recipientAddr  The address of the device receiving this command
+        //! @param[in] senderAddr  The address of the device sending this command
+        //! @param[in] header  Words to send ahead of the screen data
+        //! @param[in] headerLen  Number of words in header
+        //! @param[in,out] lastVersion  The version last read, or NO_VERSION to encode the newest
+        //!                             screen regardless; set to the newest version
+        //! @returns true iff packet was encoded
+        bool readData(MapleEncodedPacket& packet,
+                      uint8_t command,
+                      uint8_t recipientAddr,
+                      uint8_t senderAddr,
+                      const uint32_t* header,
+                      uint32_t headerLen,
+                      uint32_t& lastVersion);
 
     public:
         //! Number of words in a screen
         static const uint32_t NUM_SCREEN_WORDS = 48;
+        //! A version which is never published (the default screen is version 1)
+        static const uint32_t NO_VERSION = 0;
+
+    private:
+        //! One published screen
+        struct Frame
+        {
+            //! The screen words
+            uint32_t words[NUM_SCREEN_WORDS];
+            //! Incremented with each published screen
+            uint32_t version;
+            //! Hash of words
+            uint32_t hash;
+        };
+
+        //! Number of screen buffers
+        static const uint32_t NUM_FRAMES = 3;
+
+        //! Claims the newest screen for the reader; it won't be written until the next claim
+        //! @returns the newest screen
+        const Frame& claimNewest();
+
+        //! @param[in] words  The screen words to hash
+        //! @returns a 32-bit FNV-1a hash of the given screen words, one word at a time
+        static uint32_t computeHash(const uint32_t* words);
 
     private:
-        //! Mutex used to ensure integrity of data between multiple cores
-        MutexInterface& mMutex;
-        //! The current screen data
-        uint32_t mScreenData[NUM_SCREEN_WORDS];
-        //! Flag set to true in setData and set to false in readData
-        bool mNewDataAvailable;
+        //! The screen buffers
+        Frame mFrames[NUM_FRAMES];
+        //! Index of the newest published screen (only written by the writer)
+        volatile uint32_t mNewestIndex;
+        //! Index of the screen claimed by the reader (only written by the reader)
+        volatile uint32_t mReadingIndex;
 };
@@ -3,71 +3,120 @@
 #include "hardware/structs/systick.h"
 #include "hardware/regs/m0plus.h"
 #include "hardware/irq.h"
+#include "hardware/structs/iobank0.h"
 #include "configuration.h"
+#include "MaplePacket.hpp"
 #include "maple.pio.h"
-#include "string.h"
-
-MapleBus* mapleWriteIsr[4] = {};
-MapleBus* mapleReadIsr[4] = {};
+#include <string.h>
+
+//! Busses indexed by the maple_out state machine (and PIO IRQ flag) index
+MapleBus* MAPLE_CORE1_DATA(mapleWriteIsr)[MapleBus::MAX_BUSSES] = {};
+//! Busses indexed by the maple_in state machine (and PIO IRQ flag) index
+MapleBus* MAPLE_CORE1_DATA(mapleReadIsr)[MapleBus::MAX_BUSSES] = {};
+//! Storage of the small DMA buffers; these take every controller poll response, so they are kept
+//! with the rest of core1's hot bus state
+static uint32_t
+    MAPLE_CORE1_DATA(mapleSmallBuffers)[MAPLE_NUM_SMALL_BUFFERS][MAPLE_SMALL_BUFFER_WORDS];
+//! Storage of the large DMA buffers (too large for a scratch bank)
+static uint32_t mapleLargeBuffers[MAPLE_NUM_LARGE_BUFFERS][MapleBus::WRITE_BUFFER_WORDS];
+//! DMA buffers which busses borrow for each transaction. Every borrow and return is made with
+//! interrupts disabled on the one core which services the busses, so no lock of its own is needed.
+static MapleBus::BufferPool MAPLE_CORE1_DATA(mapleBufferPool)(mapleSmallBuffers, mapleLargeBuffers);
+
+//! Services each PIO IRQ flag routed to the given IRQ line. State machine n raises flag n, and
+//! flags 0 and 2 are routed to IRQ line 0 while 1 and 3 are routed to line 1.
+//! @param[in] pio  The PIO block which raised the IRQ
+//! @param[in] busses  Table of busses indexed by state machine
+//! @param[in] irqLine  The PIO IRQ line (0 or 1)
+//! @param[in] handler  The bus handler to call for each raised flag
+static inline void dispatch_maple_isrs(pio_hw_t* pio,
+                                       MapleBus* const* busses,
+                                       uint32_t irqLine,
+                                       void (MapleBus::*handler)())
+{
+    for (uint32_t i = irqLine; i < 4; i += 2)
+    {
+        const uint32_t mask = (1 << i);
+        if (pio->irq & mask)
+        {
+            if (busses[i] != NULL)
+            {
+                (busses[i]->*handler)();
+            }
+            hw_set_bits(&pio->irq, mask);
+        }
+    }
+}
 
 extern "C"
 {
-void maple_write_isr0(void)
+int64_t maple_alarm(alarm_id_t id, void* userData);
+}
+
+struct MapleAlarmPool
 {
-    if (MAPLE_OUT_PIO->irq & (0x01))
+    //! The pool, which fires every alarm on the core which services the busses
+    alarm_pool_t* pool;
+
+    inline int32_t add(uint64_t timeUs, void* userData)
     {
-        mapleWriteIsr[0]->writeIsr();
-        hw_set_bits(&MAPLE_OUT_PIO->irq, 0x01);
+        // Never fires in the past; 0 is returned instead
+        return alarm_pool_add_alarm_at(
+            pool, from_us_since_boot(timeUs), maple_alarm, userData, false);
     }
-    if (MAPLE_OUT_PIO->irq & (0x04))
+
+    inline void cancel(int32_t id)
     {
-        mapleWriteIsr[2]->writeIsr();
-        hw_set_bits(&MAPLE_OUT_PIO->irq, 0x04);
+        alarm_pool_cancel_alarm(pool, id);
     }
+};
+
+//! Alarm pool which fires every bus timeout on the core which services the busses
+static MapleAlarmPool MAPLE_CORE1_DATA(mapleAlarmPool) = {NULL};
+
+//! MapleBusTiming::WRITE_TIMEOUT_US, which is looked up for every write; this copy is filled in at
+//! compile time and kept with the hot path
+static const MapleBusTiming::Table MAPLE_HOT_DATA(writeTimeoutUsTable) =
+    MapleBusTiming::WRITE_TIMEOUT_US;
+//! MapleBusTiming::READ_TIMEOUT_US, which sizes the read buffer of every transaction
+static const MapleBusTiming::Table MAPLE_HOT_DATA(readTimeoutUsTable) =
+    MapleBusTiming::READ_TIMEOUT_US;
+
+extern "C"
+{
+void MAPLE_HOT_FUNC(maple_write_isr0)(void)
+{
+    dispatch_maple_isrs(MAPLE_OUT_PIO, mapleWriteIsr, 0, &MapleBus::writeIsr);
 }
-void maple_write_isr1(void)
+void MAPLE_HOT_FUNC(maple_write_isr1)(void)
 {
-    if (MAPLE_OUT_PIO->irq & (0x02))
-    {
-        mapleWriteIsr[1]->writeIsr();
-        hw_set_bits(&MAPLE_OUT_PIO->irq, 0x02);
-    }
-    if (MAPLE_OUT_PIO->irq & (0x08))
-    {
-        mapleWriteIsr[3]->writeIsr();
-        hw_set_bits(&MAPLE_OUT_PIO->irq, 0x08);
-    }
+    dispatch_maple_isrs(MAPLE_OUT_PIO, mapleWriteIsr, 1, &MapleBus::writeIsr);
 }
-void maple_read_isr0(void)
+void MAPLE_HOT_FUNC(maple_read_isr0)(void)
 {
-    if (MAPLE_IN_PIO->irq & (0x01))
-    {
-        mapleReadIsr[0]->readIsr();
-        hw_set_bits(&MAPLE_IN_PIO->irq, 0x01);
-    }
-    if (MAPLE_IN_PIO->irq & (0x04))
-    {
-        mapleReadIsr[2]->readIsr();
-        hw_set_bits(&MAPLE_IN_PIO->irq, 0x04);
-    }
+    dispatch_maple_isrs(MAPLE_IN_PIO, mapleReadIsr, 0, &MapleBus::readIsr);
 }
-void maple_read_isr1(void)
+void MAPLE_HOT_FUNC(maple_read_isr1)(void)
 {
-    if (MAPLE_IN_PIO->irq & (0x02))
-    {
-        mapleReadIsr[1]->readIsr();
-        hw_set_bits(&MAPLE_IN_PIO->irq, 0x02);
-    }
-    if (MAPLE_IN_PIO->irq & (0x08))
-    {
-        mapleReadIsr[3]->readIsr();
-        hw_set_bits(&MAPLE_IN_PIO->irq, 0x08);
-    }
+    dispatch_maple_isrs(MAPLE_IN_PIO, mapleReadIsr, 1, &MapleBus::readIsr);
+}
+int64_t MAPLE_HOT_FUNC(maple_alarm)(alarm_id_t id, void* userData)
+{
+    static_cast<MapleBus*>(userData)->alarmIsr(id);
+    // Never reschedule
+    return 0;
 }
 }
 
 void MapleBus::initIsrs()
 {
+    // Timeouts fire from a hardware alarm whose IRQ is serviced by this core
+    if (mapleAlarmPool.pool == NULL)
+    {
+        mapleAlarmPool.pool = alarm_pool_create_with_unused_hardware_alarm(
+            MapleAlarm<MapleAlarmPool>::POOL_SLOTS_PER_BUS * MAX_BUSSES);
+    }
+
     uint outIdx = pio_get_index(MAPLE_OUT_PIO);
     irq_set_exclusive_handler(PIO0_IRQ_0 + (outIdx * 2), maple_write_isr0);
     irq_set_exclusive_handler(PIO0_IRQ_1 + (outIdx * 2), maple_write_isr1);
@@ -89,6 +138,11 @@ void MapleBus::initIsrs()
     pio_set_irq1_source_enabled(MAPLE_IN_PIO, pis_interrupt3, true);
 }
 
+const MapleBus::BufferPool& MapleBus::getBufferPool()
+{
+    return mapleBufferPool;
+}
+
 MapleBus::MapleBus(uint32_t pinA, uint8_t senderAddr) :
     mPinA(pinA),
     mPinB(pinA + 1),
@@ -96,29 +150,45 @@ MapleBus::MapleBus(uint32_t pinA, uint8_t senderAddr) :
     mMaskB(1 << mPinB),
     mMaskAB(mMaskA | mMaskB),
     mSenderAddr(senderAddr),
-    mSmOut(CPU_FREQ_KHZ, MAPLE_NS_PER_BIT, mPinA),
+    mSmOut(MapleBusTiming::outClkDiv256(maple_out_DOUBLE_PHASE_TICKS), mPinA),
     mSmIn(mPinA),
     mDmaWriteChannel(dma_claim_unused_channel(true)),
     mDmaReadChannel(dma_claim_unused_channel(true)),
-    mWriteBuffer(),
-    mReadBuffer(),
-    mLastValidRead(),
+    mWriteBuffer(NULL),
+    mReadBuffer(NULL),
+    mReadBufferWords(0),
+    mLastValidRead(NULL),
+    mLastValidReadBuffer(NULL),
     mLastValidReadLen(0),
-    mNewDataAvailable(false),
-    mReadUpdated(false),
+    mRetrievedReadBuffer(NULL),
+    mCriticalSection(),
+    mQueue(),
+    mCurrentObserver(NULL),
+    mCompletions(),
+    mCompletionsHead(0),
+    mNumCompletions(0),
+    mAlarm(),
+    mOpenLineCheckInProgress(false),
+    mPendingWriteWords(NULL),
+    mPendingWriteNumWords(0),
+    mRetryPolicy(),
+    mReservedTimeUs(0),
+    mBulkHeldForUs(0),
     mWriteInProgress(false),
     mExpectingResponse(false),
     mReadInProgress(false),
-    mProcKillTime(0xFFFFFFFFFFFFFFFFULL),
+    mReadDrainInProgress(false),
     mRxDetected(false),
-    mReadTimeoutUs(0)
+    mReadTimeoutUs(0),
+    mCurrentRecipient(0),
+    mResponseWaitStartUs(0),
+    mResponseLatency()
 {
+    critical_section_init(&mCriticalSection);
+
     mapleWriteIsr[mSmOut.mSmIdx] = this;
     mapleReadIsr[mSmIn.mSmIdx] = this;
 
-    // This only needs to be called once but no issue calling it for each
-    initIsrs();
-
     // Setup DMA to automaticlly put data on the FIFO
     dma_channel_config c = dma_channel_get_default_config(mDmaWriteChannel);
     channel_config_set_read_increment(&c, true);
@@ -129,8 +199,8 @@ MapleBus::MapleBus(uint32_t pinA, uint8_t senderAddr) :
     dma_channel_configure(mDmaWriteChannel,
                             &c,
                             &mSmOut.mProgram.mPio->txf[mSmOut.mSmIdx],
-                            mWriteBuffer,
-                            sizeof(mWriteBuffer) / sizeof(mWriteBuffer[0]),
+                            NULL,
+                            0,
                             false);
 
     // Setup DMA to automaticlly read data from the FIFO
@@ -142,126 +212,259 @@ MapleBus::MapleBus(uint32_t pinA, uint8_t senderAddr) :
     channel_config_set_dreq(&c, pio_get_dreq(mSmIn.mProgram.mPio, mSmIn.mSmIdx, false));
     dma_channel_configure(mDmaReadChannel,
                             &c,
-                            mReadBuffer,
+                            NULL,
                             &mSmIn.mProgram.mPio->rxf[mSmIn.mSmIdx],
-                            (sizeof(mReadBuffer) / sizeof(mReadBuffer[0])),
+                            0,
                             false);
 }
 
-inline void MapleBus::readIsr()
+inline void MAPLE_HOT_FUNC(MapleBus::readIsr)()
 {
     if (!mRxDetected)
     {
+        critical_section_enter_blocking(&mCriticalSection);
         mRxDetected = true;
-        mProcKillTime = time_us_64() + mReadTimeoutUs;
+        if (mReadInProgress)
+        {
+            uint64_t currentTimeUs = time_us_64();
+            mResponseLatency.responded(mCurrentRecipient, currentTimeUs - mResponseWaitStartUs);
+            // Response has started - now allow enough time for the full read
+            armAlarm(currentTimeUs + mReadTimeoutUs);
+        }
+        critical_section_exit(&mCriticalSection);
     }
     else
     {
-        mSmIn.stop();
-        mReadInProgress = false;
-        mReadUpdated = true;
+        critical_section_enter_blocking(&mCriticalSection);
+        // processEvents() may have already timed this read out
+        if (mReadInProgress)
+        {
+            mSmIn.stop();
+            mReadInProgress = false;
+            finishRead();
+            startNextTransaction();
+        }
+        critical_section_exit(&mCriticalSection);
     }
 }
 
-inline void MapleBus::writeIsr()
+inline void MAPLE_HOT_FUNC(MapleBus::writeIsr)()
 {
-    mSmOut.stop();
-    if (mExpectingResponse)
+    critical_section_enter_blocking(&mCriticalSection);
+    // processEvents() may have already timed this write out
+    if (mWriteInProgress)
     {
-        mSmIn.start();
-        mProcKillTime = time_us_64() + MAPLE_RESPONSE_TIMEOUT_US;
-        mReadInProgress = true;
+        mSmOut.stop();
+        if (mExpectingResponse)
+        {
+            // The read is handed off from here rather than by the state machines themselves: PIO
+            // IRQ flags don't cross from MAPLE_OUT_PIO to MAPLE_IN_PIO, and a DMA chained off the
+            // write channel would enable the read while the last words are still shifting out.
+            // Everything else was set up in finishOpenLineCheck(), so this is a single register write.
+            mSmIn.start();
+            mReadInProgress = true;
+            mResponseWaitStartUs = time_us_64();
+            armAlarm(mResponseWaitStartUs + mResponseLatency.getTimeoutUs(mCurrentRecipient));
+            mWriteInProgress = false;
+        }
+        else
+        {
+            mWriteInProgress = false;
+            finishTransaction(MapleTransactionObserver::STATUS_SUCCESS, NULL, 0);
+            startNextTransaction();
+        }
     }
-    mWriteInProgress = false;
+    critical_section_exit(&mCriticalSection);
 }
 
-bool MapleBus::writeInit()
+bool MapleBus::startOpenLineCheck()
 {
-    const uint64_t targetTime = time_us_64() + MAPLE_OPEN_LINE_CHECK_TIME_US + 1;
+    bool rv = false;
 
-    // Ensure no one is pulling low
-    do
+    // Ensure no one is pulling low right now
+    if ((gpio_get_all() & mMaskAB) == mMaskAB)
     {
-        if ((gpio_get_all() & mMaskAB) != mMaskAB)
-        {
-            // Something is pulling low
-            return false;
-        }
-    } while (time_us_64() < targetTime);
+        // Any falling edge from here on is latched by the GPIO block, so the line doesn't need to
+        // be sampled continuously
+        gpio_acknowledge_irq(mPinA, GPIO_IRQ_EDGE_FALL);
+        gpio_acknowledge_irq(mPinB, GPIO_IRQ_EDGE_FALL);
+        rv = true;
+    }
+
+    return rv;
+}
 
-    mSmOut.start();
+bool MapleBus::isLineStillOpen()
+{
+    // Raw interrupt status latches edges whether or not the interrupt is enabled, and it does so
+    // while the pins are connected to MAPLE_OUT_PIO as they always are
+    const uint32_t fallA =
+        (iobank0_hw->intr[mPinA / 8] >> (4 * (mPinA % 8))) & GPIO_IRQ_EDGE_FALL;
+    const uint32_t fallB =
+        (iobank0_hw->intr[mPinB / 8] >> (4 * (mPinB % 8))) & GPIO_IRQ_EDGE_FALL;
+    return (fallA == 0 && fallB == 0 && (gpio_get_all() & mMaskAB) == mMaskAB);
+}
 
-    return true;
+bool MAPLE_HOT_FUNC(MapleBus::startWrite)(const volatile uint32_t* words,
+                                          uint32_t numWords,
+                                          bool expectResponse,
+                                          uint32_t readTimeoutUs,
+                                          MapleTransactionObserver* observer)
+{
+    mCurrentObserver = observer;
+    // Frame word was stored byte swapped
+    mCurrentRecipient = MaplePacket::frameRecipientAddr(MapleCodec::swapByteOrder(words[1]));
+    mExpectingResponse = expectResponse;
+    mReadTimeoutUs = readTimeoutUs;
+    mPendingWriteWords = words;
+    mPendingWriteNumWords = numWords;
+    mRetryPolicy.start();
+
+    return restartWrite();
 }
 
-bool MapleBus::write(uint32_t frameWord,
-                     const uint32_t* payload,
-                     uint8_t len,
-                     bool expectResponse,
-                     uint32_t readTimeoutUs)
+bool MAPLE_HOT_FUNC(MapleBus::restartWrite)()
 {
     bool rv = false;
 
-    processEvents();
+    // Make sure previous DMA instances are killed
+    dma_channel_abort(mDmaWriteChannel);
+    dma_channel_abort(mDmaReadChannel);
+
+    mRxDetected = false;
 
-    if (!isBusy())
+    if (startOpenLineCheck())
     {
-        // Make sure previous DMA instances are killed
-        dma_channel_abort(mDmaWriteChannel);
-        dma_channel_abort(mDmaReadChannel);
+        mOpenLineCheckInProgress = true;
 
-        mRxDetected = false;
-        mReadTimeoutUs = readTimeoutUs;
+        // Rather than busy waiting, come back once the line has been open for long enough. This
+        // lets every bus check its line at the same time.
+        armAlarm(time_us_64() + MAPLE_OPEN_LINE_CHECK_TIME_US + 1);
 
-        // First 32 bits sent to the state machine is how many bits to output.
-        uint32_t numBits = (len * 4 + 5) * 8;
-        mWriteBuffer[0] = numBits;
-        // The PIO state machine reads from "left to right" to achieve the right bit order, but the data
-        // out needs to be little endian. Therefore, the data bytes needs to be swapped. Might as well
-        // Compute the CRC while we're at it.
-        uint8_t crc = 0;
-        swapByteOrder(mWriteBuffer[1], frameWord, crc);
-        for (uint32_t i = 0; i < len; ++i)
+        rv = true;
+    }
+
+    return rv;
+}
+
+void MAPLE_HOT_FUNC(MapleBus::finishOpenLineCheck)()
+{
+    mOpenLineCheckInProgress = false;
+
+    if (isLineStillOpen())
+    {
+        mSmOut.start();
+        mWriteInProgress = true;
+
+        if (mExpectingResponse)
         {
-            swapByteOrder(mWriteBuffer[i + 2], *payload++, crc);
+            // Everything for the read is set up now so that the end of the write only needs to
+            // enable the read state machine
+            mSmIn.prepare();
+            // Start reading into the buffer borrowed for this transaction - no need to clear it
+            // since only the words that DMA actually transfers are ever validated
+            dma_channel_transfer_to_buffer_now(mDmaReadChannel, mReadBuffer, mReadBufferWords);
         }
-        // Last byte left shifted out is the CRC
-        mWriteBuffer[len + 2] = crc << 24;
 
-        if (writeInit())
+        // Start writing
+        dma_channel_transfer_from_buffer_now(
+            mDmaWriteChannel, mPendingWriteWords, mPendingWriteNumWords);
+
+        // The time which the write process should complete is looked up by payload length
+        uint32_t payloadLen = mPendingWriteNumWords - MapleCodec::numEncodedWords(0);
+        armAlarm(time_us_64() + writeTimeoutUsTable[payloadLen]);
+    }
+    else
+    {
+        // Something pulled the line low while it was being checked
+        finishTransaction(MapleTransactionObserver::STATUS_WRITE_FAILED, NULL, 0);
+        startNextTransaction();
+    }
+}
+
+bool MAPLE_HOT_FUNC(MapleBus::write)(uint32_t frameWord,
+                                     const uint32_t* payload,
+                                     uint8_t len,
+                                     bool expectResponse,
+                                     uint32_t readTimeoutUs)
+{
+    bool rv = false;
+
+    critical_section_enter_blocking(&mCriticalSection);
+    // Queued transactions take priority over direct writes
+    if (isReadyToStart()
+        && mQueue.isEmpty()
+        && borrowBuffers(MapleCodec::numEncodedWords(len),
+                         readBufferWords(expectResponse, readTimeoutUs)))
+    {
+        // The PIO state machine reads from "left to right" to achieve the right bit order, but the data
+        // out needs to be little endian. The codec swaps each word and computes the CRC as it goes.
+        uint32_t numWords = MapleCodec::encode(mWriteBuffer, frameWord, payload, len);
+        rv = startWrite(mWriteBuffer, numWords, expectResponse, readTimeoutUs, NULL);
+        if (!rv)
         {
-            // Update flags before beginning to write
-            mExpectingResponse = expectResponse;
-            mWriteInProgress = true;
+            giveBackBuffers();
+        }
+    }
+    critical_section_exit(&mCriticalSection);
 
-            if (expectResponse)
-            {
-                // Flush the read buffer
-                updateLastValidReadBuffer();
-                // Clear out the read buffer for good measure
-                for (uint32_t i = 0; i < sizeof(mReadBuffer) / sizeof(mReadBuffer[0]); ++i)
-                {
-                    mReadBuffer[i] = 0;
-                }
-                // Start reading
-                dma_channel_transfer_to_buffer_now(
-                    mDmaReadChannel, mReadBuffer, sizeof(mReadBuffer) / sizeof(mReadBuffer[0]));
-            }
+    return rv;
+}
+
+bool MapleBus::write(uint8_t command,
+                     uint8_t recipientAddr,
+                     const MapleCodec::Segment* segments,
+                     uint8_t numSegments,
+                     bool expectResponse,
+                     uint32_t readTimeoutUs)
+{
+    bool rv = false;
 
-            // Start writing
-            dma_channel_transfer_from_buffer_now(mDmaWriteChannel, mWriteBuffer, len + 3);
+    uint32_t len = MapleCodec::payloadLen(segments, numSegments);
 
-            uint32_t totalWriteTimeNs = numBits * MAPLE_NS_PER_BIT;
-            // Start and stop sequence takes less than 14 bit periods
-            totalWriteTimeNs += 14 * MAPLE_NS_PER_BIT;
-            // Multiply by the extra percentage
-            totalWriteTimeNs *= (1 + (MAPLE_WRITE_TIMEOUT_EXTRA_PERCENT / 100.0));
-            // And then compute the time which the write process should complete
-            mProcKillTime = time_us_64() + (totalWriteTimeNs / 1000.0 + 0.5) + 1;
+    critical_section_enter_blocking(&mCriticalSection);
+    if (isReadyToStart()
+        && mQueue.isEmpty()
+        && len <= 0xFF
+        && borrowBuffers(MapleCodec::numEncodedWords(len),
+                         readBufferWords(expectResponse, readTimeoutUs)))
+    {
+        uint32_t frameWord =
+            MaplePacket::makeFrameWord(command, recipientAddr, mSenderAddr, len);
+        // Each segment is swapped straight out of its source storage into the DMA buffer
+        uint32_t numWords = MapleCodec::encode(mWriteBuffer, frameWord, segments, numSegments);
+        rv = startWrite(mWriteBuffer, numWords, expectResponse, readTimeoutUs, NULL);
+        if (!rv)
+        {
+            giveBackBuffers();
+        }
+    }
+    critical_section_exit(&mCriticalSection);
 
-            rv = true;
+    return rv;
+}
+
+bool MAPLE_HOT_FUNC(MapleBus::write)(const MapleEncodedPacket& packet,
+                                     bool expectResponse,
+                                     uint32_t readTimeoutUs)
+{
+    bool rv = false;
+
+    critical_section_enter_blocking(&mCriticalSection);
+    if (isReadyToStart()
+        && mQueue.isEmpty()
+        && packet.isValid()
+        && borrowBuffers(0, readBufferWords(expectResponse, readTimeoutUs)))
+    {
+        // The packet's words go straight to DMA - nothing to encode
+        rv = startWrite(
+            packet.getWords(), packet.getNumWords(), expectResponse, readTimeoutUs, NULL);
+        if (!rv)
+        {
+            giveBackBuffers();
         }
     }
+    critical_section_exit(&mCriticalSection);
 
     return rv;
 }
@@ -281,80 +484,411 @@ bool MapleBus::write(uint8_t command,
                      bool expectResponse,
                      uint32_t readTimeoutUs)
 {
-    uint32_t frameWord = (len) | (mSenderAddr << 8) | (recipientAddr << 16) | (command << 24);
+    uint32_t frameWord = MaplePacket::makeFrameWord(command, recipientAddr, mSenderAddr, len);
     return write(frameWord, payload, len, expectResponse, readTimeoutUs);
 }
 
-void MapleBus::processEvents(uint64_t currentTimeUs)
+bool MAPLE_HOT_FUNC(MapleBus::submit)(const MapleTransaction& transaction)
 {
-    if (isBusy())
+    bool rv = false;
+
+    if (transaction.packet != NULL && transaction.packet->isValid())
     {
-        // If currentTimeUs wasn't set, get the current time
-        if (currentTimeUs == 0)
+        critical_section_enter_blocking(&mCriticalSection);
+        rv = mQueue.push(transaction);
+        if (rv)
         {
-            currentTimeUs = time_us_64();
+            // Starts right away if the bus is idle
+            startNextTransaction();
         }
+        critical_section_exit(&mCriticalSection);
+    }
+
+    return rv;
+}
 
-        if (currentTimeUs > mProcKillTime)
+void MapleBus::cancel(const MapleTransactionObserver* observer)
+{
+    critical_section_enter_blocking(&mCriticalSection);
+    mQueue.remove(observer);
+    if (mCurrentObserver == observer)
+    {
+        mCurrentObserver = NULL;
+    }
+    for (uint32_t i = 0; i < MAX_PENDING_COMPLETIONS; ++i)
+    {
+        if (mCompletions[i].observer == observer)
         {
-            if (mWriteInProgress)
-            {
-                mSmOut.stop();
-                mWriteInProgress = false;
-            }
-            if (mReadInProgress)
-            {
-                mSmIn.stop();
-                mReadInProgress = false;
-            }
+            mCompletions[i].observer = NULL;
         }
     }
+    critical_section_exit(&mCriticalSection);
+}
+
+void MapleBus::reserve(uint64_t timeUs)
+{
+    critical_section_enter_blocking(&mCriticalSection);
+    mReservedTimeUs = timeUs;
+    critical_section_exit(&mCriticalSection);
 }
 
-void MapleBus::updateLastValidReadBuffer()
+void MAPLE_HOT_FUNC(MapleBus::startNextTransaction)()
 {
-    if (mReadUpdated)
+    MapleTransaction transaction;
+    while (isReadyToStart() && mQueue.peek(transaction))
     {
-        // Wait up to 1 ms for the RX FIFO to become empty (automatically drained by the read DMA)
-        uint64_t timeoutTime = time_us_64() + 1000;
-        while (!pio_sm_is_rx_fifo_empty(mSmIn.mProgram.mPio, mSmIn.mSmIdx)
-               && time_us_64() < timeoutTime);
+        bool critical = (transaction.trafficClass == MapleTransaction::TRAFFIC_LATENCY_CRITICAL);
+        if (!critical && holdForReservation(transaction))
+        {
+            // Started once the latency critical transaction finishes or the reservation passes
+            break;
+        }
 
-        mReadUpdated = false;
-        uint32_t buffer[256];
-        // The frame word always contains how many proceeding words there are [0,255]
-        uint32_t len = mReadBuffer[0] >> 24;
-        uint8_t crc = 0;
-        // Bytes are loaded to the left, but the first byte is actually the LSB.
-        // This means we need to byte swap (compute crc while we're at it)
-        for (uint32_t i = 0; i < len + 1; ++i)
+        if (!borrowBuffers(0, readBufferWords(transaction.expectResponse,
+                                              transaction.readTimeoutUs)))
         {
-            swapByteOrder(buffer[i], mReadBuffer[i], crc);
+            // Started once any bus gives a buffer back
+            mapleBufferPool.markWaiting(mSmOut.mSmIdx);
+            break;
         }
-        // crc in the last word does not need to be byte swapped
-        // Data is only valid if the CRC is correct and first word has something in it (cmd 0 is invalid)
-        if (crc == mReadBuffer[len + 1] && mReadBuffer[0] != 0)
+
+        if (critical)
+        {
+            // Reservation is fulfilled
+            mReservedTimeUs = 0;
+        }
+        else
+        {
+            mBulkHeldForUs = 0;
+        }
+
+        mQueue.pop(transaction);
+        const MapleEncodedPacket& packet = *transaction.packet;
+        if (!startWrite(packet.getWords(),
+                        packet.getNumWords(),
+                        transaction.expectResponse,
+                        transaction.readTimeoutUs,
+                        transaction.observer))
         {
-            memcpy(mLastValidRead, buffer, (len + 1) * 4);
-            mLastValidReadLen = len + 1;
-            mNewDataAvailable = true;
+            // Line wasn't open - fail this one and move on to the next
+            mCurrentObserver = transaction.observer;
+            finishTransaction(MapleTransactionObserver::STATUS_WRITE_FAILED, NULL, 0);
         }
     }
 }
 
-const uint32_t* MapleBus::getReadData(uint32_t& len, bool& newData)
+bool MapleBus::holdForReservation(const MapleTransaction& transaction)
+{
+    bool rv = false;
+
+    // A bulk transaction is only ever held back for one reservation, so none of them starve
+    if (mReservedTimeUs > 0 && (mBulkHeldForUs == 0 || mBulkHeldForUs == mReservedTimeUs))
+    {
+        uint64_t currentTimeUs = time_us_64();
+        if (currentTimeUs < mReservedTimeUs
+            && (currentTimeUs + estimateDurationUs(transaction)
+                > mReservedTimeUs + MAPLE_MAX_POLL_JITTER_US))
+        {
+            mBulkHeldForUs = mReservedTimeUs;
+            rv = true;
+        }
+    }
+
+    return rv;
+}
+
+uint32_t MapleBus::estimateDurationUs(const MapleTransaction& transaction) const
+{
+    // Open line check, then the write up until it would time out
+    uint32_t durationUs = MAPLE_OPEN_LINE_CHECK_TIME_US + 1
+        + writeTimeoutUsTable[transaction.packet->getPayloadLen()];
+    if (transaction.expectResponse)
+    {
+        durationUs += mResponseLatency.getTimeoutUs(transaction.getRecipientAddr())
+                      + transaction.readTimeoutUs;
+    }
+    return durationUs;
+}
+
+void MAPLE_HOT_FUNC(MapleBus::finishTransaction)(MapleTransactionObserver::Status status,
+                                                 const uint32_t* response,
+                                                 uint32_t len)
+{
+    // A transaction is only started while a completion slot is free
+    Completion& completion =
+        mCompletions[(mCompletionsHead + mNumCompletions) % MAX_PENDING_COMPLETIONS];
+    completion.observer = mCurrentObserver;
+    completion.status = status;
+    completion.response = response;
+    completion.len = len;
+    completion.buffer = NULL;
+    if (response != NULL)
+    {
+        // The response is held until it is handed out
+        completion.buffer = mReadBuffer;
+        mReadBuffer = NULL;
+    }
+    giveBackBuffers();
+    ++mNumCompletions;
+    mCurrentObserver = NULL;
+    disarmAlarm();
+}
+
+void MAPLE_HOT_FUNC(MapleBus::armAlarm)(uint64_t timeUs)
+{
+    if (mAlarm.arm(mapleAlarmPool, timeUs, this) == MapleAlarm<MapleAlarmPool>::RESULT_EXPIRED)
+    {
+        // Time already passed - handle it right away
+        alarmExpired();
+    }
+    // Otherwise, the alarm either fires at the given time or, if the pool ran out of alarms,
+    // processEvents() notices once the time passes
+}
+
+void MAPLE_HOT_FUNC(MapleBus::disarmAlarm)()
 {
-    updateLastValidReadBuffer();
-    if (mNewDataAvailable)
+    mAlarm.disarm(mapleAlarmPool);
+}
+
+void MAPLE_HOT_FUNC(MapleBus::finishRead)()
+{
+    mReadDrainInProgress = false;
+
+    // The last words were pushed just before the IRQ, so the read DMA may still be moving them out
+    // of the RX FIFO
+    bool drained = pio_sm_is_rx_fifo_empty(mSmIn.mProgram.mPio, mSmIn.mSmIdx);
+    if (!drained && dma_channel_is_busy(mDmaReadChannel))
     {
-        mNewDataAvailable = false;
-        newData = true;
+        // Come back once it has had time to rather than waiting for it here. Should that time
+        // already be up, this is called again right away, but DMA is done with the FIFO by then.
+        mReadDrainInProgress = true;
+        armAlarm(time_us_64() + RX_DRAIN_TIME_US);
+    }
+    else if (!drained)
+    {
+        // DMA stopped at the end of the buffer, so the response overflowed it - it is cut short,
+        // so sending again wouldn't help
+        finishTransaction(MapleTransactionObserver::STATUS_CRC_ERROR, NULL, 0);
     }
     else
     {
-        newData = false;
+        // Only the words which DMA actually transferred are considered
+        uint32_t numReceived =
+            mReadBufferWords - dma_channel_hw_addr(mDmaReadChannel)->transfer_count;
+        uint32_t len = 0;
+        // Bytes are loaded to the left, but the first byte is actually the LSB. The codec swaps
+        // each word back in place and validates the CRC.
+        bool valid = MapleCodec::decode(mReadBuffer, mReadBuffer, numReceived, len);
+        MapleRetryPolicy::Action action =
+            mRetryPolicy.onResponse(valid, valid ? MaplePacket::frameCommand(mReadBuffer[0]) : 0);
+        if (action == MapleRetryPolicy::ACTION_RETRY)
+        {
+            // The peripheral just released the line, so it should be open right away
+            action = mRetryPolicy.retryStarted(restartWrite());
+        }
+
+        if (action == MapleRetryPolicy::ACTION_ACCEPT)
+        {
+            finishTransaction(MapleTransactionObserver::STATUS_SUCCESS, mReadBuffer, len);
+        }
+        else if (action == MapleRetryPolicy::ACTION_FAIL)
+        {
+            finishTransaction(MapleTransactionObserver::STATUS_CRC_ERROR, NULL, 0);
+        }
+    }
+}
+
+bool MAPLE_HOT_FUNC(MapleBus::borrowBuffers)(uint32_t writeWords, uint32_t readWords)
+{
+    bool rv = true;
+    uint32_t capacity = 0;
+
+    if (writeWords > 0)
+    {
+        mWriteBuffer = mapleBufferPool.borrow(writeWords, capacity);
+        rv = (mWriteBuffer != NULL);
+    }
+
+    if (rv && readWords > 0)
+    {
+        mReadBuffer = mapleBufferPool.borrow(readWords, mReadBufferWords);
+        rv = (mReadBuffer != NULL);
+    }
+
+    if (!rv)
+    {
+        giveBackBuffers();
+    }
+
+    return rv;
+}
+
+void MAPLE_HOT_FUNC(MapleBus::giveBackBuffers)()
+{
+    mapleBufferPool.giveBack(mWriteBuffer);
+    mWriteBuffer = NULL;
+    mapleBufferPool.giveBack(mReadBuffer);
+    mReadBuffer = NULL;
+    mReadBufferWords = 0;
+}
+
+uint32_t MAPLE_HOT_FUNC(MapleBus::readBufferWords)(bool expectResponse, uint32_t readTimeoutUs)
+{
+    uint32_t numWords = 0;
+    if (expectResponse)
+    {
+        // A longer response would be cut off by the timeout anyway
+        numWords = readTimeoutUsTable.lengthWithin(readTimeoutUs) + READ_EXTRA_WORDS;
+    }
+    return numWords;
+}
+
+void MAPLE_HOT_FUNC(MapleBus::startWokenBusses)()
+{
+    critical_section_enter_blocking(&mCriticalSection);
+    uint32_t woken = mapleBufferPool.takeWoken();
+    critical_section_exit(&mCriticalSection);
+
+    // Each bus is started under its own critical section, one at a time
+    for (uint32_t i = 0; woken != 0; ++i, woken >>= 1)
+    {
+        MapleBus* bus = mapleWriteIsr[i];
+        if ((woken & 1) != 0 && bus != NULL)
+        {
+            critical_section_enter_blocking(&bus->mCriticalSection);
+            bus->startNextTransaction();
+            critical_section_exit(&bus->mCriticalSection);
+        }
+    }
+}
+
+void MAPLE_HOT_FUNC(MapleBus::alarmIsr)(alarm_id_t id)
+{
+    critical_section_enter_blocking(&mCriticalSection);
+    // Ignore an alarm which was superseded just as it fired
+    if (mAlarm.fired(id))
+    {
+        alarmExpired();
+    }
+    critical_section_exit(&mCriticalSection);
+}
+
+void MAPLE_HOT_FUNC(MapleBus::alarmExpired)()
+{
+    if (mOpenLineCheckInProgress)
+    {
+        finishOpenLineCheck();
+    }
+    else if (mReadDrainInProgress)
+    {
+        finishRead();
+        startNextTransaction();
+    }
+    else if (mWriteInProgress)
+    {
+        mSmOut.stop();
+        mWriteInProgress = false;
+        finishTransaction(MapleTransactionObserver::STATUS_WRITE_FAILED, NULL, 0);
+        startNextTransaction();
+    }
+    else if (mReadInProgress)
+    {
+        mSmIn.stop();
+        mReadInProgress = false;
+        if (!mRxDetected)
+        {
+            // Wait a little longer next time in case this peripheral just got slower
+            mResponseLatency.timedOut(mCurrentRecipient);
+        }
+        finishTransaction(MapleTransactionObserver::STATUS_READ_TIMEOUT, NULL, 0);
+        startNextTransaction();
+    }
+}
+
+uint32_t MAPLE_HOT_FUNC(MapleBus::processEvents)(uint64_t currentTimeUs)
+{
+    uint32_t numProcessed = 0;
+
+    critical_section_enter_blocking(&mCriticalSection);
+    // Timeouts are normally handled by alarm; the time only needs checking here in the unlikely
+    // case that no alarm was free when this bus needed one
+    if (mAlarm.isDeferred())
+    {
+        if (currentTimeUs == 0)
+        {
+            currentTimeUs = time_us_64();
+        }
+        if (mAlarm.deferredExpired(currentTimeUs))
+        {
+            alarmExpired();
+        }
     }
-    len = mLastValidReadLen;
-    return mLastValidRead;
+    // A bulk transaction may have been held back for a reservation which has now passed
+    startNextTransaction();
+    critical_section_exit(&mCriticalSection);
+
+    // Notify observers outside of the critical section so that they may submit more transactions
+    while (true)
+    {
+        critical_section_enter_blocking(&mCriticalSection);
+        bool available = (mNumCompletions > 0);
+        Completion completion = mCompletions[mCompletionsHead];
+        critical_section_exit(&mCriticalSection);
+
+        if (!available)
+        {
+            break;
+        }
+
+        if (completion.observer != NULL)
+        {
+            completion.observer->transactionComplete(
+                completion.status, completion.response, completion.len);
+        }
+
+        critical_section_enter_blocking(&mCriticalSection);
+        if (completion.response != NULL)
+        {
+            // The buffer is held for getReadData(); one which was never retrieved goes back
+            mapleBufferPool.giveBack(mLastValidReadBuffer);
+            mLastValidRead = completion.response;
+            mLastValidReadBuffer = completion.buffer;
+            mLastValidReadLen = completion.len;
+        }
+        else
+        {
+            mapleBufferPool.giveBack(completion.buffer);
+        }
+        mCompletionsHead = (mCompletionsHead + 1) % MAX_PENDING_COMPLETIONS;
+        --mNumCompletions;
+        // A completion slot (and possibly a read buffer) just freed up
+        startNextTransaction();
+        critical_section_exit(&mCriticalSection);
+
+        ++numProcessed;
+    }
+
+    // Buffers given back by this bus, here or from its ISRs, may be what other busses wait on
+    startWokenBusses();
+
+    return numProcessed;
 }
 
+const uint32_t* MapleBus::getReadData(uint32_t& len, bool& newData)
+{
+    critical_section_enter_blocking(&mCriticalSection);
+    // The caller is done with whatever was retrieved last time
+    mapleBufferPool.giveBack(mRetrievedReadBuffer);
+    mRetrievedReadBuffer = mLastValidReadBuffer;
+    const uint32_t* dat = mLastValidRead;
+    newData = (dat != NULL);
+    len = newData ? mLastValidReadLen : 0;
+    mLastValidRead = NULL;
+    mLastValidReadBuffer = NULL;
+    mLastValidReadLen = 0;
+    critical_section_exit(&mCriticalSection);
+
+    // The buffer given back may be what this or another bus waits on
+    startWokenBusses();
+    return dat;
+}
@@ -2,7 +2,15 @@
 #define __MAPLE_BUS_H__
 
 #include "MapleBusInterface.hpp"
+#include "MapleCodec.hpp"
+#include "MapleTransactionQueue.hpp"
+#include "MapleResponseLatency.hpp"
+#include "MapleTiming.hpp"
+#include "MapleBufferPool.hpp"
+#include "MapleAlarm.hpp"
+#include "MapleRetryPolicy.hpp"
 #include "pico/stdlib.h"
+#include "pico/critical_section.h"
 #include "hardware/structs/systick.h"
 #include "hardware/dma.h"
 #include "configuration.h"
@@ -10,6 +18,9 @@
 #include "maple.pio.h"
 #include "hardware/pio.h"
 
+//! The pico SDK alarm pool which every bus schedules its timeouts in (see MapleBus.cpp)
+struct MapleAlarmPool;
+
 //! Handles communication over Maple Bus. This class is currently only setup to handle communication
 //! from a host which initiates communication. This can easily be modified to handle communication
 //! for a device, but that is not a use-case of this project.
@@ -18,9 +29,48 @@
 //! sample the full end sequence. The application side should wait a sufficient amount of time
 //! after bus goes neutral before responding in that case. Waiting for neutral bus is enough anyway.
 //!
-//! @warning this class is not "thread safe" - it should only be used by 1 core.
+//! Transactions may be queued with submit(). The next queued transaction is started from the ISR
+//! which completes the previous one, so there is no idle gap waiting for the calling loop to come
+//! back around. Responses are validated in the ISR, and timeouts are fired by a hardware alarm
+//! rather than by polling the time, but observers are only ever notified from processEvents().
+//!
+//! The time each peripheral takes to start responding is learned, so a dropped response only holds
+//! the bus for a little longer than that peripheral normally takes. Once a response starts, the
+//! read is given the timeout of its transaction, which should be based on the expected length.
+//!
+//! A response which fails CRC, or which asks for the last packet to be sent again, is answered by
+//! sending the same packet again right from the ISR, up to MAPLE_TRANSACTION_MAX_RETRIES times per
+//! transaction (see MapleRetryPolicy). Observers only see the outcome of the last attempt.
+//!
+//! DMA buffers aren't owned by a bus. Each transaction which expects a response borrows a buffer to
+//! receive into from a pool shared by every bus (see MapleBufferPool), sized for the longest
+//! response which could complete within its read timeout, and the buffer goes back once the
+//! response has been handed to its observer and then out by getReadData(). A queued transaction
+//! which finds no buffer of its size free is started as soon as any bus gives one back.
+//!
+//! Queued transactions are arbitrated by traffic class (see MapleTransactionQueue), and a latency
+//! critical transaction may reserve the bus ahead of time so that bulk traffic doesn't start just
+//! before it is due (see reserve()). A latency critical transaction therefore waits for at most
+//! one transaction already in progress, which is never one that was started within its reservation
+//! unless that transaction had already been held back once.
+//!
+//! @warning apart from the ISRs, this class is not "thread safe" - it should only be used by 1 core,
+//!          and since busses share their buffers, every bus must be used by that same core.
 class MapleBus : public MapleBusInterface
 {
+    public:
+        //! Maximum number of busses (one for each state machine of a PIO block)
+        static const uint32_t MAX_BUSSES = 4;
+        //! Number of words in a full write - 256 + 2 extra words for bit count and CRC
+        static const uint32_t WRITE_BUFFER_WORDS = 258;
+        //! Number of words in a read besides its payload - the frame word and CRC
+        static const uint32_t READ_EXTRA_WORDS = 2;
+        //! DMA buffers shared by every bus
+        typedef MapleBufferPool<MAPLE_SMALL_BUFFER_WORDS,
+                                MAPLE_NUM_SMALL_BUFFERS,
+                                WRITE_BUFFER_WORDS,
+                                MAPLE_NUM_LARGE_BUFFERS> BufferPool;
+
     public:
         //! Maple Bus constructor
         //! @param[in] pinA  GPIO index for pin A. The very next GPIO will be designated as pin B.
@@ -43,6 +93,23 @@ class MapleBus : public MapleBusInterface
                    bool expectResponse,
                    uint32_t readTimeoutUs=DEFAULT_MAPLE_READ_TIMEOUT_US);
 
+        //! Writes a command whose payload is gathered from several segments (ex: function code,
+        //! address word, and a pointer to bulk data). Each segment is encoded straight from its own
+        //! storage into the write buffer, so nothing needs to be staged beforehand.
+        //! @param[in] command  The command byte - should be a value in Command enumeration
+        //! @param[in] recipientAddr  The address of the device receiving this command
+        //! @param[in] segments  The payload segments, in order (no more than 255 words in total)
+        //! @param[in] numSegments  Number of segments
+        //! @param[in] expectResponse  Set to true in order to start receive after send is complete
+        //! @param[in] readTimeoutUs  When response is expected, the receive timeout in microseconds
+        //! @returns true iff the bus was "open" and send has started
+        bool write(uint8_t command,
+                   uint8_t recipientAddr,
+                   const MapleCodec::Segment* segments,
+                   uint8_t numSegments,
+                   bool expectResponse,
+                   uint32_t readTimeoutUs=DEFAULT_MAPLE_READ_TIMEOUT_US);
+
         //! Writes a command with the given custom frame word. The internal sender address is
         //! ignored and instead the given frame word is sent verbatim.
         //! @param[in] frameWord  The first word to put out on the bus
@@ -69,52 +136,181 @@ class MapleBus : public MapleBusInterface
                    bool expectResponse,
                    uint32_t readTimeoutUs=DEFAULT_MAPLE_READ_TIMEOUT_US);
 
+        //! Writes a packet which was encoded ahead of time. No copy is made - the packet's words are
+        //! read directly by DMA, so the packet must not be modified or destroyed until the write
+        //! completes. The same packet may be written on several busses at once.
+        //! @param[in] packet  The encoded packet to send
+        //! @param[in] expectResponse  Set to true in order to start receive after send is complete
+        //! @param[in] readTimeoutUs  When response is expected, the receive timeout in microseconds
+        //! @returns true iff the bus was "open" and send has started
+        bool write(const MapleEncodedPacket& packet,
+                   bool expectResponse,
+                   uint32_t readTimeoutUs=DEFAULT_MAPLE_READ_TIMEOUT_US);
+
+        //! Inherited from MapleBusInterface
+        bool submit(const MapleTransaction& transaction);
+
+        //! Inherited from MapleBusInterface
+        void cancel(const MapleTransactionObserver* observer);
+
+        //! Inherited from MapleBusInterface
+        void reserve(uint64_t timeUs);
+
         //! Called from a PIO ISR when read has completed for this sender.
         void readIsr();
 
         //! Called from a PIO ISR when write has completed for this sender.
         void writeIsr();
 
-        //! Retrieves the last valid set of data read.
-        //! @param[out] len  The number of words received
+        //! Called from the alarm's ISR when the open line check is done or when the transaction in
+        //! progress has run too long
+        //! @param[in] id  The alarm which fired
+        void alarmIsr(alarm_id_t id);
+
+        //! Registers the PIO ISRs and creates the timeout alarm pool. Every ISR fires on the core
+        //! which calls this, so it must be called once from the core which services the busses
+        //! before any transaction is started.
+        static void initIsrs();
+
+        //! Retrieves the last valid packet handed out by processEvents() which wasn't retrieved yet.
+        //! The packet is not copied; this points into the buffer it was received into, which is
+        //! held until the next call and then given back to the pool. A packet which is superseded
+        //! before it is retrieved is given back right away.
+        //! @param[out] len  The number of words received (0 if no new data)
         //! @param[out] newData  Set to true iff new data was received since the last call
-        //! @returns a pointer to the bytes read.
-        //! @warning this call should be serialized with calls to write() as those calls may change
-        //!          the data in the underlying buffer which is returned.
+        //! @returns a pointer to the whole packet, valid until the next call (NULL if no new data)
         const uint32_t* getReadData(uint32_t& len, bool& newData);
 
-        //! Processes timing events for the current time.
+        //! Notifies observers of any transactions which have completed. Timeouts are driven by a
+        //! hardware alarm, so the given time is only needed if no alarm was free when one was due
+        //! to be scheduled.
         //! @param[in] currentTimeUs  The current time to process for (0 to internally get time)
-        void processEvents(uint64_t currentTimeUs=0);
+        //! @returns the number of completed transactions which were handed out
+        uint32_t processEvents(uint64_t currentTimeUs=0);
 
         //! @returns true iff the bus is currently busy reading or writing.
-        inline bool isBusy() { return mWriteInProgress || mReadInProgress; }
+        inline bool isBusy()
+        {
+            return (mOpenLineCheckInProgress
+                    || mWriteInProgress
+                    || mReadInProgress
+                    || mReadDrainInProgress);
+        }
+
+        //! @returns the number of transactions which were sent again so far; the counts are only
+        //!          ever incremented a word at a time, so they may be read from the other core
+        inline const MapleRetryPolicy::Stats& getRetryStats() const
+        {
+            return mRetryPolicy.getStats();
+        }
+
+        //! @returns the pool which every bus borrows its buffers from
+        static const BufferPool& getBufferPool();
 
     private:
-        //! Ensures that the bus is open and starts the write PIO state machine.
-        bool writeInit();
-
-        //! If new data is available and is valid, updates mLastValidRead.
-        void updateLastValidReadBuffer();
-
-        //! Swaps the endianness of a 32 bit word from the given source to the given destination
-        //! while also computing a crc over the 4 bytes.
-        //! @param[out] dest  destination word to write to
-        //! @param[in] source  source word to read from
-        //! @param[in,out] crc  crc word to start from and write to
-        static inline void swapByteOrder(volatile uint32_t& dest, uint32_t source, uint8_t& crc)
+        //! Checks that the bus is open right now and starts watching it for activity
+        //! @returns true iff the line is open
+        bool startOpenLineCheck();
+
+        //! @returns true iff nothing has pulled the line low since startOpenLineCheck()
+        bool isLineStillOpen();
+
+        //! Called once the line has been watched for long enough. If it stayed open, the pending
+        //! write is started; otherwise the transaction fails. Must be called with
+        //! mCriticalSection held.
+        void finishOpenLineCheck();
+
+        //! Starts a transaction which writes the given encoded words, assuming the bus isn't busy
+        //! and a completion slot is free. The line is first watched for activity in the background,
+        //! and the words go out from the alarm once it has stayed open long enough. Must be called
+        //! with mCriticalSection held.
+        //! @param[in] words  Encoded words (bit count, frame word, payload, CRC)
+        //! @param[in] numWords  Number of encoded words
+        //! @param[in] expectResponse  Set to true in order to start receive after send is complete
+        //! @param[in] readTimeoutUs  When response is expected, the receive timeout in microseconds
+        //! @param[in] observer  Notified once this write completes (may be NULL)
+        //! @returns true iff the bus was "open" and the send is underway
+        bool startWrite(const volatile uint32_t* words,
+                        uint32_t numWords,
+                        bool expectResponse,
+                        uint32_t readTimeoutUs,
+                        MapleTransactionObserver* observer);
+
+        //! Starts writing the words of the current transaction. Must be called with
+        //! mCriticalSection held.
+        //! @returns true iff the bus was "open" and the send is underway
+        bool restartWrite();
+
+        //! @returns true iff a write may be started right now. Must be called with
+        //!          mCriticalSection held.
+        inline bool isReadyToStart()
         {
-            const uint8_t* src = reinterpret_cast<uint8_t*>(&source);
-            volatile uint8_t* dst = reinterpret_cast<volatile uint8_t*>(&dest) + 3;
-            for (uint j = 0; j < 4; ++j, ++src, --dst)
-            {
-                *dst = *src;
-                crc ^= *src;
-            }
+            return (!isBusy() && mNumCompletions < MAX_PENDING_COMPLETIONS);
         }
 
-        //! Initializes all interrupt service routines for all Maple Busses
-        static void initIsrs();
+        //! Starts queued transactions until one is in progress or nothing more can be started.
+        //! Must be called with mCriticalSection held.
+        void startNextTransaction();
+
+        //! Checks whether the given bulk transaction must wait for the reserved latency critical
+        //! transaction. Must be called with mCriticalSection held.
+        //! @param[in] transaction  The next bulk transaction
+        //! @returns true iff the transaction must not be started yet
+        bool holdForReservation(const MapleTransaction& transaction);
+
+        //! @param[in] transaction  A transaction
+        //! @returns the longest time the given transaction may take, including timeouts
+        uint32_t estimateDurationUs(const MapleTransaction& transaction) const;
+
+        //! Records the outcome of the transaction in progress so that its observer is notified on
+        //! the next call to processEvents(). Must be called with mCriticalSection held.
+        //! @param[in] status  The outcome of the transaction
+        //! @param[in] response  The validated response (NULL if none)
+        //! @param[in] len  Number of words in response, including the frame word
+        void finishTransaction(MapleTransactionObserver::Status status,
+                               const uint32_t* response,
+                               uint32_t len);
+
+        //! Validates the words just received into mReadBuffer and either finishes the transaction
+        //! or sends it again. If the read DMA is still draining the RX FIFO, this is instead called
+        //! again from the alarm once it has had time to. A response which overflowed mReadBuffer
+        //! fails as a CRC error. Must be called with mCriticalSection held.
+        void finishRead();
+
+        //! Schedules this bus's alarm, replacing any which is already scheduled. If the time already
+        //! passed, alarmExpired() is called right away; if no alarm is free, processEvents() checks
+        //! the time instead. Must be called with mCriticalSection held.
+        //! @param[in] timeUs  The time at which alarmExpired() is called
+        void armAlarm(uint64_t timeUs);
+
+        //! Cancels the alarm if one is scheduled. Must be called with mCriticalSection held.
+        void disarmAlarm();
+
+        //! Finishes the open line check, or stops the transaction in progress and reports it as
+        //! failed. Must be called with mCriticalSection held.
+        void alarmExpired();
+
+        //! Borrows the buffers a transaction needs from the shared pool. Must be called with
+        //! mCriticalSection held.
+        //! @param[in] writeWords  Number of words to encode into a borrowed write buffer (0 when the
+        //!                        words to write are stored elsewhere)
+        //! @param[in] readWords  Number of words to allow for the response (0 if none expected)
+        //! @returns true iff every buffer needed was borrowed; nothing is borrowed otherwise
+        bool borrowBuffers(uint32_t writeWords, uint32_t readWords);
+
+        //! Returns the buffers still held by the current transaction to the shared pool. Must be
+        //! called with mCriticalSection held.
+        void giveBackBuffers();
+
+        //! @param[in] expectResponse  true iff a response is expected
+        //! @param[in] readTimeoutUs  The receive timeout of the response
+        //! @returns the number of words to borrow for the response: enough for the longest one
+        //!          which could be received before the timeout (0 if none is expected)
+        static uint32_t readBufferWords(bool expectResponse, uint32_t readTimeoutUs);
+
+        //! Starts the queued transactions of every bus which was waiting for a buffer when one was
+        //! given back. Must be called without mCriticalSection held.
+        void startWokenBusses();
 
     private:
         //! Pin A GPIO index for this bus
@@ -138,30 +334,90 @@ class MapleBus : public MapleBusInterface
         //! The DMA channel used for reading by this bus
         const int mDmaReadChannel;
 
-        //! The output word buffer - 256 + 2 extra words for bit count and CRC
-        volatile uint32_t mWriteBuffer[258];
-        //! The input word buffer - 256 + 1 extra word for CRC
-        volatile uint32_t mReadBuffer[257];
-        //! Holds the last know valid read buffer (no CRC - that was validated)
-        uint32_t mLastValidRead[256];
-        //! Number of words stored in mLastValidRead, including the frame word
+        //! Time to give the read DMA to drain the RX FIFO once a read ends; DMA takes a few cycles
+        //! for each of the FIFO's 4 words
+        static const uint32_t RX_DRAIN_TIME_US = 1;
+        //! Maximum number of completed transactions which may wait for processEvents()
+        static const uint32_t MAX_PENDING_COMPLETIONS = 2;
+        //! The buffer borrowed to encode a direct write into (NULL if the words are stored
+        //! elsewhere)
+        uint32_t* mWriteBuffer;
+        //! The buffer borrowed for DMA to read the response of the transaction in progress into.
+        //! Words are decoded in place, so a validated buffer holds host-order words and the CRC
+        //! word is left behind at the end.
+        uint32_t* mReadBuffer;
+        //! Number of words in mReadBuffer
+        uint32_t mReadBufferWords;
+        //! The last valid packet handed out by processEvents() and not yet by getReadData() (NULL
+        //! if none)
+        const uint32_t* mLastValidRead;
+        //! The borrowed buffer which holds mLastValidRead
+        uint32_t* mLastValidReadBuffer;
+        //! Number of words in mLastValidRead, including the frame word
         uint32_t mLastValidReadLen;
-        //! True iff mLastValidRead was updated since last call to getReadData()
-        bool mNewDataAvailable;
-        //! True iff mReadBuffer was updated since last call to updateLastValidReadBuffer()
-        volatile bool mReadUpdated;
+        //! The borrowed buffer of the packet last returned by getReadData() (NULL if none)
+        uint32_t* mRetrievedReadBuffer;
+
+        //! A finished transaction waiting for its observer to be notified
+        struct Completion
+        {
+            //! Observer to notify (NULL if none or canceled)
+            MapleTransactionObserver* observer;
+            //! The outcome of the transaction
+            MapleTransactionObserver::Status status;
+            //! Points into buffer at the validated response (NULL if none)
+            const uint32_t* response;
+            //! The borrowed buffer which holds response, given back once it is handed out
+            uint32_t* buffer;
+            //! Number of words in response, including the frame word
+            uint32_t len;
+        };
+
+        //! Serializes transaction state between processEvents() and the ISRs, which may run on
+        //! either core
+        critical_section_t mCriticalSection;
+        //! Transactions waiting for the bus
+        MapleTransactionQueue<MAPLE_TRANSACTION_QUEUE_SIZE> mQueue;
+        //! Observer of the transaction in progress
+        MapleTransactionObserver* mCurrentObserver;
+        //! Circular buffer of completions waiting for processEvents()
+        Completion mCompletions[MAX_PENDING_COMPLETIONS];
+        //! Index of the oldest completion in mCompletions
+        uint32_t mCompletionsHead;
+        //! Number of completions in mCompletions
+        uint32_t mNumCompletions;
+        //! The alarm which ends the open line check or times out the transaction in progress
+        MapleAlarm<MapleAlarmPool> mAlarm;
+        //! True while the line is being watched before a write
+        volatile bool mOpenLineCheckInProgress;
+        //! Encoded words of the current transaction, written once the open line check passes
+        const volatile uint32_t* mPendingWriteWords;
+        //! Number of words in mPendingWriteWords
+        uint32_t mPendingWriteNumWords;
+        //! Decides whether the current transaction is sent again and counts retries
+        MapleRetryPolicy mRetryPolicy;
+        //! When the reserved latency critical transaction is due (0 if not reserved)
+        uint64_t mReservedTimeUs;
+        //! The reservation which the next bulk transaction was held back for (0 if none)
+        uint64_t mBulkHeldForUs;
         //! True when write is currently in progress
         volatile bool mWriteInProgress;
         //! True if read should be started immediately after write has completed
         bool mExpectingResponse;
         //! True when read is currently in progress
         volatile bool mReadInProgress;
-        //! The time at which the next timeout will occur
-        volatile uint64_t mProcKillTime;
+        //! True while the read has ended but the read DMA is still draining the RX FIFO
+        volatile bool mReadDrainInProgress;
         //! True once receive is detected
         volatile bool mRxDetected;
         //! Receive timeout for the current expected response
         uint32_t mReadTimeoutUs;
+        //! Recipient address of the transaction in progress
+        uint8_t mCurrentRecipient;
+        //! Time at which the write completed and the response was awaited
+        uint64_t mResponseWaitStartUs;
+        //! The learned response latency of each peripheral on this bus
+        MapleResponseLatency mResponseLatency;
 };
 
 #endif // __MAPLE_BUS_H__
@@ -1,8 +1,13 @@
 #include "UsbControllerDevice.h"
 #include <stdint.h>
 #include "class/hid/hid_device.h"
+#include "hardware/structs/usb.h"
 
-UsbControllerDevice::UsbControllerDevice() : mIsUsbConnected(false), mIsControllerConnected(false) {}
+UsbControllerDevice::UsbControllerDevice() :
+  mIsUsbConnected(false),
+  mIsControllerConnected(false),
+  mReportStats()
+{}
 UsbControllerDevice::~UsbControllerDevice() {}
 
 void UsbControllerDevice::updateUsbConnected(bool connected)
@@ -41,3 +46,8 @@ bool UsbControllerDevice::sendReport(uint8_t instance, uint8_t report_id)
   }
   return sent;
 }
+
+void UsbControllerDevice::recordFlush(bool sent)
+{
+  mReportStats.recordFlush(sent, isUsbConnected(), usb_hw->sof_rd & USB_SOF_RD_BITS);
+}
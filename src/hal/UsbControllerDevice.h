@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "UsbControllerInterface.hpp"
+#include "UsbReportStats.hpp"
 
 //! Base class for a USB controller device
 class UsbControllerDevice : public UsbControllerInterface
@@ -48,18 +49,28 @@ class UsbControllerDevice : public UsbControllerInterface
     //! @returns the current controller connected state
     virtual bool isControllerConnected();
 
+    //! @returns statistics on report submission, only to be read from the USB core
+    inline const UsbReportStats::Counts& getReportStats() const { return mReportStats.getCounts(); }
+
   protected:
     //! Helper function which retrieves and sends report to tiny USB
     //! @param[in] instance The USB instance number (0-based)
     //! @param[in] report_id The USB report ID number
     bool sendReport(uint8_t instance, uint8_t report_id);
 
+    //! Records that a pending report was either sent or had to be put off
+    //! @param[in] sent  true iff the report was sent
+    void recordFlush(bool sent);
+
   protected:
     //! True when this USB device is connected to a host
     bool mIsUsbConnected;
 
     //! True when this controller is connected
     bool mIsControllerConnected;
+
+    //! Statistics on report submission
+    UsbReportStats mReportStats;
 };
 
 #endif // __USB_CONTROLLER_DEVICE_H__
@@ -213,6 +213,7 @@ bool UsbGamepad::send(bool force)
     {
       buttonsUpdated = false;
     }
+    recordFlush(sent);
     return sent;
   }
   else
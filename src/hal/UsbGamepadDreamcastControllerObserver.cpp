@@ -1,10 +1,84 @@
 #include "UsbGamepadDreamcastControllerObserver.hpp"
+#include "pico/multicore.h"
 
-UsbGamepadDreamcastControllerObserver::UsbGamepadDreamcastControllerObserver(UsbGamepad& usbController) :
-    mUsbController(usbController)
+volatile bool UsbGamepadDreamcastControllerObserver::sDoorbellMissed = false;
+
+UsbGamepadDreamcastControllerObserver::UsbGamepadDreamcastControllerObserver(UsbGamepad& usbController,
+                                                                             uint32_t doorbellId) :
+    mUsbController(usbController),
+    mDoorbellId(doorbellId),
+    mCondition(),
+    mLastConditionSequence(0),
+    mControllerConnected(false),
+    mAppliedControllerConnected(false)
 {}
 
 void UsbGamepadDreamcastControllerObserver::setControllerCondition(const ControllerCondition& controllerCondition)
+{
+    mCondition.write(controllerCondition);
+    ringDoorbell();
+}
+
+void UsbGamepadDreamcastControllerObserver::controllerConnected()
+{
+    mControllerConnected = true;
+    ringDoorbell();
+}
+
+void UsbGamepadDreamcastControllerObserver::controllerDisconnected()
+{
+    mControllerConnected = false;
+    ringDoorbell();
+}
+
+void UsbGamepadDreamcastControllerObserver::ringDoorbell()
+{
+    // Never wait on core0; if the FIFO is somehow full, core0 checks everything instead
+    if (multicore_fifo_wready())
+    {
+        multicore_fifo_push_blocking(mDoorbellId);
+    }
+    else
+    {
+        sDoorbellMissed = true;
+    }
+}
+
+bool UsbGamepadDreamcastControllerObserver::checkDoorbellMissed()
+{
+    bool missed = sDoorbellMissed;
+    if (missed)
+    {
+        sDoorbellMissed = false;
+    }
+    return missed;
+}
+
+bool UsbGamepadDreamcastControllerObserver::process()
+{
+    bool updated = false;
+
+    bool connected = mControllerConnected;
+    if (connected != mAppliedControllerConnected)
+    {
+        mAppliedControllerConnected = connected;
+        mUsbController.updateControllerConnected(connected);
+        updated = true;
+    }
+
+    // Connecting or disconnecting releases everything first; a condition is only applied while
+    // connected so that a stale one can't leave buttons held after a disconnect
+    ControllerCondition controllerCondition;
+    if (mCondition.read(controllerCondition, mLastConditionSequence) && connected)
+    {
+        applyCondition(controllerCondition);
+        updated = true;
+    }
+
+    return updated;
+}
+
+void UsbGamepadDreamcastControllerObserver::applyCondition(const ControllerCondition& controllerCondition)
 {
     mUsbController.setButton(UsbGamepad::GAMEPAD_BUTTON_A, 0 == controllerCondition.a);
     mUsbController.setButton(UsbGamepad::GAMEPAD_BUTTON_B, 0 == controllerCondition.b);
@@ -33,16 +107,4 @@ void UsbGamepadDreamcastControllerObserver::setControllerCondition(const Control
     mUsbController.setAnalogThumbY(true, static_cast<int32_t>(controllerCondition.lAnalogUD) - 128);
     mUsbController.setAnalogThumbX(false, static_cast<int32_t>(controllerCondition.rAnalogLR) - 128);
     mUsbController.setAnalogThumbY(false, static_cast<int32_t>(controllerCondition.rAnalogUD) - 128);
-
-    mUsbController.send();
-}
-
-void UsbGamepadDreamcastControllerObserver::controllerConnected()
-{
-    mUsbController.updateControllerConnected(true);
-}
-
-void UsbGamepadDreamcastControllerObserver::controllerDisconnected()
-{
-    mUsbController.updateControllerConnected(false);
 }
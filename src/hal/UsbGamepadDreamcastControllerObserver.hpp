@@ -3,15 +3,21 @@
 
 #include "DreamcastControllerObserver.hpp"
 #include "UsbGamepad.h"
+#include "SeqLock.hpp"
 
 //! Yes, I know this name is ridiculous, but at least it's descriptive!
-//! This connects the Dreamcast controller observer to a USB gamepad device
+//! This connects the Dreamcast controller observer to a USB gamepad device.
+//!
+//! The observer methods are called from the Maple Bus core (core1) and only ever publish what they
+//! are given, then ring core0's doorbell. The USB gamepad is only ever touched from core0 through
+//! process(), so neither core blocks the other and TinyUSB is only used from core0.
 class UsbGamepadDreamcastControllerObserver : public DreamcastControllerObserver
 {
     public:
         //! Constructor for UsbKeyboardGenesisControllerObserver
         //! @param[in] usbController  The USB controller to update when keys are pressed or released
-        UsbGamepadDreamcastControllerObserver(UsbGamepad& usbController);
+        //! @param[in] doorbellId  Value pushed into the inter-core FIFO when there is an update
+        UsbGamepadDreamcastControllerObserver(UsbGamepad& usbController, uint32_t doorbellId);
 
         //! Sets the current Dreamcast controller condition
         //! @param[in] controllerCondition  The current condition of the Dreamcast controller
@@ -23,9 +29,36 @@ class UsbGamepadDreamcastControllerObserver : public DreamcastControllerObserver
         //! Called when controller disconnected
         virtual void controllerDisconnected() final;
 
+        //! Applies any update published by core1 to the USB gamepad - only call from core0
+        //! @returns true iff the gamepad was updated
+        bool process();
+
+        //! @returns true iff an update was published while the doorbell FIFO was full; clears the
+        //!          condition - only call from core0
+        static bool checkDoorbellMissed();
+
+    private:
+        //! Lets core0 know that this observer has an update waiting
+        void ringDoorbell();
+
+        //! Applies a controller condition to the USB gamepad
+        void applyCondition(const ControllerCondition& controllerCondition);
+
     private:
         //! The USB controller I update
         UsbGamepad& mUsbController;
+        //! Value pushed into the inter-core FIFO when there is an update
+        const uint32_t mDoorbellId;
+        //! The latest condition, from core1 to core0
+        SeqLock<ControllerCondition> mCondition;
+        //! Sequence of the condition last applied (core0 only)
+        uint32_t mLastConditionSequence;
+        //! The connected state as last set by core1
+        volatile bool mControllerConnected;
+        //! The connected state last applied to the USB gamepad (core0 only)
+        bool mAppliedControllerConnected;
+        //! Set when a doorbell couldn't be rung because the FIFO was full
+        static volatile bool sDoorbellMissed;
 };
 
 #endif // __USB_CONTROLLER_DREAMCAST_CONTROLLER_OBSERVER_H__
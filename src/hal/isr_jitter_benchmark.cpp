@@ -0,0 +1,129 @@
+#include "isr_jitter_benchmark.h"
+
+#include "configuration.h"
+#include "utils.h"
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+#include "hardware/dma.h"
+#include "hardware/structs/systick.h"
+#include "hardware/regs/m0plus.h"
+#include <stdio.h>
+#include <stdint.h>
+
+//! Interrupt entry times, in processor cycles, gathered over one set of samples
+struct EntryCycles
+{
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t numSamples;
+};
+
+//! Number of words the contention load writes before it needs to be triggered again
+static const uint32_t CONTENTION_TRANSFERS = 0x10000;
+//! Wrap the contention load's write address within 2^10 bytes
+static const uint32_t CONTENTION_RING_BITS = 10;
+
+//! Word which the contention load reads over and over
+static uint32_t contentionSource = 0;
+//! Buffer which the contention load writes over and over (aligned for write address wrapping)
+static uint32_t contentionBuffer[(1 << CONTENTION_RING_BITS) / sizeof(uint32_t)]
+    __attribute__((aligned(1 << CONTENTION_RING_BITS)));
+//! DMA channel which runs the contention load
+static int contentionDmaChannel = -1;
+//! The software interrupt which is measured
+static int benchmarkIrq = -1;
+
+//! SysTick count just before the interrupt was set pending; it is kept with core1's bus state so
+//! that the interrupt's first data access is affected by the layout in the same way
+static volatile uint32_t MAPLE_CORE1_DATA(triggerTicks) = 0;
+//! Samples gathered so far by core1
+static EntryCycles MAPLE_CORE1_DATA(gathering) = {0xFFFFFFFF, 0, 0, 0};
+//! The last full set of samples, handed from core1 to core0
+static EntryCycles completed = {};
+//! Set by core1 once completed holds a full set of samples; cleared by core0 once reported
+static volatile bool completedReady = false;
+
+//! Records the time taken to enter this interrupt
+static void MAPLE_HOT_FUNC(isr_jitter_benchmark_isr)(void)
+{
+    // SysTick counts down through 24 bits
+    uint32_t cycles = (triggerTicks - systick_hw->cvr) & M0PLUS_SYST_RVR_RELOAD_BITS;
+    if (cycles < gathering.min)
+    {
+        gathering.min = cycles;
+    }
+    if (cycles > gathering.max)
+    {
+        gathering.max = cycles;
+    }
+    gathering.total += cycles;
+    ++gathering.numSamples;
+}
+
+void isr_jitter_benchmark_init()
+{
+    // Free running processor clock count on this core
+    systick_hw->rvr = M0PLUS_SYST_RVR_RELOAD_BITS;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+
+    benchmarkIrq = user_irq_claim_unused(true);
+    irq_set_exclusive_handler(benchmarkIrq, isr_jitter_benchmark_isr);
+    irq_set_enabled(benchmarkIrq, true);
+
+    // Unpaced memory to memory copies into striped main SRAM
+    contentionDmaChannel = dma_claim_unused_channel(true);
+    dma_channel_config config = dma_channel_get_default_config(contentionDmaChannel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_ring(&config, true, CONTENTION_RING_BITS);
+    dma_channel_configure(contentionDmaChannel,
+                          &config,
+                          contentionBuffer,
+                          &contentionSource,
+                          CONTENTION_TRANSFERS,
+                          true);
+}
+
+void MAPLE_HOT_FUNC(isr_jitter_benchmark_sample)()
+{
+    // Keep the contention load going
+    if (!dma_channel_is_busy(contentionDmaChannel))
+    {
+        dma_channel_set_trans_count(contentionDmaChannel, CONTENTION_TRANSFERS, true);
+    }
+
+    triggerTicks = systick_hw->cvr;
+    // The interrupt is taken right away
+    irq_set_pending(benchmarkIrq);
+
+    if (gathering.numSamples >= ISR_JITTER_BENCHMARK_SAMPLES && !completedReady)
+    {
+        completed = gathering;
+        __sync_synchronize();
+        completedReady = true;
+
+        gathering.min = 0xFFFFFFFF;
+        gathering.max = 0;
+        gathering.total = 0;
+        gathering.numSamples = 0;
+    }
+}
+
+void isr_jitter_benchmark_task()
+{
+    if (completedReady)
+    {
+        __sync_synchronize();
+        uint32_t mean = (uint32_t)(completed.total / completed.numSamples);
+        printf("ISR entry: min %lu, mean %lu, max %lu cycles (jitter %lu) over %lu samples\n",
+               (unsigned long)completed.min,
+               (unsigned long)mean,
+               (unsigned long)completed.max,
+               (unsigned long)(completed.max - completed.min),
+               (unsigned long)completed.numSamples);
+        completedReady = false;
+    }
+}
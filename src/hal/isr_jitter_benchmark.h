@@ -0,0 +1,16 @@
+#ifndef __ISR_JITTER_BENCHMARK_H__
+#define __ISR_JITTER_BENCHMARK_H__
+
+// Measures how long core1 takes to enter an interrupt while a DMA channel floods striped main SRAM
+// on top of the usual bus and USB traffic. Comparing builds with and without MAPLE_SCRATCH_BANKS
+// shows what the memory layout does to ISR entry jitter.
+
+//! Starts the SRAM contention load and claims the interrupt to measure; must be called on core1
+void isr_jitter_benchmark_init();
+//! Takes one sample of interrupt entry time; needs to be called constantly by core1
+void isr_jitter_benchmark_sample();
+//! Reports each completed set of ISR_JITTER_BENCHMARK_SAMPLES samples over stdio; needs to be
+//! called constantly by main()
+void isr_jitter_benchmark_task();
+
+#endif // __ISR_JITTER_BENCHMARK_H__
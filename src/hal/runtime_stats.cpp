@@ -0,0 +1,74 @@
+#include "runtime_stats.h"
+
+#include "configuration.h"
+#include "MapleBus.hpp"
+#include "UsbGamepad.h"
+#include "UsbSofClock.hpp"
+#include "pico/stdlib.h"
+#include <stdio.h>
+
+//! The busses reported on
+static const MapleBus* statsBusses = NULL;
+//! The gamepads reported on
+static const UsbGamepad* statsGamepads = NULL;
+//! The frame phase monitors reported on
+static const FramePhaseMonitor* statsFramePhases = NULL;
+//! Number of busses, gamepads and frame phase monitors reported on
+static uint32_t statsNumBusses = 0;
+//! Time at which the last report was made
+static uint64_t periodStartUs = 0;
+
+void runtime_stats_init(const MapleBus* busses,
+                        const UsbGamepad* gamepads,
+                        const FramePhaseMonitor* framePhaseMonitors,
+                        uint32_t numBusses)
+{
+    statsBusses = busses;
+    statsGamepads = gamepads;
+    statsFramePhases = framePhaseMonitors;
+    statsNumBusses = numBusses;
+    periodStartUs = time_us_64();
+}
+
+void runtime_stats_task()
+{
+    uint64_t currentTimeUs = time_us_64();
+    if (currentTimeUs - periodStartUs >= (RUNTIME_STATS_PERIOD_MS * 1000ULL))
+    {
+        periodStartUs = currentTimeUs;
+
+        // The counts are updated by core1 one word at a time, so each one read here is whole
+        for (uint32_t i = 0; i < statsNumBusses; ++i)
+        {
+            const MapleRetryPolicy::Stats& retries = statsBusses[i].getRetryStats();
+            printf("Bus %lu: %lu CRC retries, %lu resend retries, %lu failed\n",
+                   (unsigned long)(i + 1),
+                   (unsigned long)retries.numCrcRetries,
+                   (unsigned long)retries.numResendRetries,
+                   (unsigned long)retries.numRetriesFailed);
+
+            // Also measured by core1, which publishes a consistent copy after each measurement
+            FramePhaseStats phase;
+            statsFramePhases[i].read(phase);
+            if (phase.numSamples > 0)
+            {
+                printf("Bus %lu: %lu of %lu conditions on time, "
+                       "%lu-%lu us (average %lu us) before a frame\n",
+                       (unsigned long)(i + 1),
+                       (unsigned long)phase.numOnTime,
+                       (unsigned long)phase.numSamples,
+                       (unsigned long)phase.minLeadUs,
+                       (unsigned long)phase.maxLeadUs,
+                       (unsigned long)(phase.totalLeadUs / phase.numSamples));
+            }
+
+            // Report submission is counted on this core
+            const UsbReportStats::Counts& reports = statsGamepads[i].getReportStats();
+            printf("Gamepad %lu: %lu reports sent, %lu flushes deferred, at most %lu frames late\n",
+                   (unsigned long)(i + 1),
+                   (unsigned long)reports.numSent,
+                   (unsigned long)reports.numDeferred,
+                   (unsigned long)reports.maxFramesDeferred);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef __RUNTIME_STATS_H__
+#define __RUNTIME_STATS_H__
+
+#include <stdint.h>
+
+class MapleBus;
+class UsbGamepad;
+class FramePhaseMonitor;
+
+//! Sets what is reported on and starts the first period (stdio must already be initialized)
+//! @param[in] busses  The busses
+//! @param[in] gamepads  The USB gamepad of each bus
+//! @param[in] framePhaseMonitors  Where each bus's controller conditions arrive relative to USB
+//!                                frames
+//! @param[in] numBusses  Number of busses (and gamepads and frame phase monitors)
+void runtime_stats_init(const MapleBus* busses,
+                        const UsbGamepad* gamepads,
+                        const FramePhaseMonitor* framePhaseMonitors,
+                        uint32_t numBusses);
+//! Reports the totals counted so far over stdio once every RUNTIME_STATS_PERIOD_MS: Maple Bus
+//! retries and controller condition timing for each bus, and HID report submission for each
+//! gamepad; needs to be called constantly by main()
+void runtime_stats_task();
+
+#endif // __RUNTIME_STATS_H__
@@ -62,6 +62,11 @@ extern "C" {
  * - CFG_TUSB_MEM SECTION : __attribute__ (( section(".usb_ram") ))
  * - CFG_TUSB_MEM_ALIGN   : __attribute__ ((aligned(4)))
  */
+#if defined(MAPLE_SCRATCH_BANKS) && MAPLE_SCRATCH_BANKS
+// Keep core0's USB buffers in SCRATCH_Y with core0's stack, away from core1's Maple Bus state
+#define CFG_TUSB_MEM_SECTION __attribute__((section(".scratch_y.tusb")))
+#endif
+
 #ifndef CFG_TUSB_MEM_SECTION
 #define CFG_TUSB_MEM_SECTION
 #endif
@@ -12,6 +12,7 @@
 #include "device/dcd.h"
 #include "usb_descriptors.h"
 #include "class/hid/hid_device.h"
+#include "hardware/structs/usb.h"
 
 bool usbEnabled = false;
 
@@ -28,6 +29,13 @@ void set_usb_devices(UsbControllerInterface** devices, uint8_t n)
   numUsbDevices = n;
 }
 
+UsbSofClock* pSofClock = nullptr;
+
+void set_usb_sof_clock(UsbSofClock* clock)
+{
+  pSofClock = clock;
+}
+
 bool gIsConnected = false;
 
 void led_task()
@@ -82,9 +90,42 @@ void usb_init()
   tusb_init();
 }
 
+void flush_reports()
+{
+  // Reports are only ever submitted from this core; each device sends only if it has an update
+  UsbControllerInterface** pdevs = pAllUsbDevices;
+  for (uint32_t i = numUsbDevices; i > 0; --i, ++pdevs)
+  {
+    (*pdevs)->send();
+  }
+}
+
+void sof_task()
+{
+  // The frame number register updates at each SOF; polling it from this tight loop only adds the
+  // few microseconds the rest of the loop takes, which UsbSofClock filters out
+  static uint32_t lastFrameNumber = 0xFFFFFFFF;
+  if (gIsConnected)
+  {
+    uint32_t frameNumber = usb_hw->sof_rd & USB_SOF_RD_BITS;
+    if (frameNumber != lastFrameNumber)
+    {
+      lastFrameNumber = frameNumber;
+      if (pSofClock != nullptr)
+      {
+        pSofClock->frameStarted(frameNumber, time_us_64());
+      }
+      // Anything updated during the last frame goes out now
+      flush_reports();
+    }
+  }
+}
+
 void usb_task()
 {
+  sof_task();
   tud_task(); // tinyusb device task
+  sof_task();
   led_task();
 }
 
@@ -112,6 +153,10 @@ void tud_umount_cb(void)
     (*pdevs)->updateUsbConnected(false);
   }
   gIsConnected = false;
+  if (pSofClock != nullptr)
+  {
+    pSofClock->framesStopped();
+  }
 }
 
 // Invoked when usb bus is suspended
@@ -126,6 +171,10 @@ void tud_suspend_cb(bool remote_wakeup_en)
     (*pdevs)->updateUsbConnected(false);
   }
   gIsConnected = false;
+  if (pSofClock != nullptr)
+  {
+    pSofClock->framesStopped();
+  }
 }
 
 // Invoked when usb bus is resumed
@@ -163,6 +212,16 @@ uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_t
   }
 }
 
+// Invoked when a report was taken by the host and the endpoint is ready for another
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len)
+{
+  (void) instance;
+  (void) report;
+  (void) len;
+  // Whatever was put off while the endpoint was busy can go out right away
+  flush_reports();
+}
+
 // Invoked when received SET_REPORT control request or
 // received data on OUT endpoint ( Report ID = 0, Type = 0 )
 void tud_hid_set_report_cb(uint8_t instance,
@@ -2,10 +2,13 @@
 #define __USB_EXECUTION_H__
 
 #include "UsbControllerInterface.hpp"
+#include "UsbSofClock.hpp"
 #include <stdint.h>
 
 //! Sets all of the USB devices to execute with
 void set_usb_devices(UsbControllerInterface** devices, uint8_t n);
+//! Sets the clock which is updated at every USB start of frame
+void set_usb_sof_clock(UsbSofClock* clock);
 //! USB initialization
 void usb_init();
 //! USB task that needs to be called constantly by main()
@@ -0,0 +1,50 @@
+#include "xip_cache_stats.h"
+
+#include "configuration.h"
+#include "pico/stdlib.h"
+#include "hardware/structs/xip_ctrl.h"
+#include <stdio.h>
+#include <stdint.h>
+
+//! Time at which the counters were last cleared
+static uint64_t periodStartUs = 0;
+
+//! Clears both counters; they saturate rather than wrap, so they are cleared after every report
+static inline void clear_counters()
+{
+    // Writing any value clears a counter
+    xip_ctrl_hw->ctr_hit = 0;
+    xip_ctrl_hw->ctr_acc = 0;
+}
+
+void xip_cache_stats_init()
+{
+    clear_counters();
+    periodStartUs = time_us_64();
+}
+
+void xip_cache_stats_task()
+{
+    uint64_t currentTimeUs = time_us_64();
+    uint64_t elapsedUs = currentTimeUs - periodStartUs;
+    if (elapsedUs >= (XIP_CACHE_STATS_PERIOD_MS * 1000ULL))
+    {
+        // Hits are read first so that they never outnumber the accesses read after them
+        uint32_t hits = xip_ctrl_hw->ctr_hit;
+        uint32_t accesses = xip_ctrl_hw->ctr_acc;
+        clear_counters();
+        periodStartUs = currentTimeUs;
+
+        // Both cores share the one cache, so these are the totals for both
+        uint32_t misses = accesses - hits;
+        uint32_t accessesPerSec = (uint32_t)(((uint64_t)accesses * 1000000) / elapsedUs);
+        uint32_t missesPerSec = (uint32_t)(((uint64_t)misses * 1000000) / elapsedUs);
+        uint32_t missPermille =
+            (accesses > 0) ? (uint32_t)(((uint64_t)misses * 1000) / accesses) : 0;
+        printf("XIP cache: %lu accesses/s, %lu misses/s (%lu.%lu%% missed)\n",
+               (unsigned long)accessesPerSec,
+               (unsigned long)missesPerSec,
+               (unsigned long)(missPermille / 10),
+               (unsigned long)(missPermille % 10));
+    }
+}
@@ -0,0 +1,10 @@
+#ifndef __XIP_CACHE_STATS_H__
+#define __XIP_CACHE_STATS_H__
+
+//! Clears the XIP cache counters (stdio must already be initialized)
+void xip_cache_stats_init();
+//! Reports XIP cache accesses and misses per second over stdio once every
+//! XIP_CACHE_STATS_PERIOD_MS; needs to be called constantly by main()
+void xip_cache_stats_task();
+
+#endif // __XIP_CACHE_STATS_H__
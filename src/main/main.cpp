@@ -13,13 +13,16 @@
 #include "MapleBus.hpp"
 #include "DreamcastNode.hpp"
 #include "DreamcastMainNode.hpp"
+#include "DreamcastSubNode.hpp"
 #include "PlayerData.hpp"
-#include "CriticalSectionMutex.hpp"
 
 #include "UsbGamepad.h"
 #include "UsbGamepadDreamcastControllerObserver.hpp"
 #include "usb_descriptors.h"
 #include "usb_execution.h"
+#include "xip_cache_stats.h"
+#include "runtime_stats.h"
+#include "isr_jitter_benchmark.h"
 
 #define BUTTON_PIN 2
 
@@ -36,23 +39,29 @@ UsbGamepad usbGamepads[NUMBER_OF_DEVICES] = {
     UsbGamepad(ITF_NUM_HID4)
 };
 UsbGamepadDreamcastControllerObserver usbGamepadDreamcastControllerObservers[NUMBER_OF_DEVICES] = {
-    UsbGamepadDreamcastControllerObserver(usbGamepads[0]),
-    UsbGamepadDreamcastControllerObserver(usbGamepads[1]),
-    UsbGamepadDreamcastControllerObserver(usbGamepads[2]),
-    UsbGamepadDreamcastControllerObserver(usbGamepads[3])
+    UsbGamepadDreamcastControllerObserver(usbGamepads[0], 0),
+    UsbGamepadDreamcastControllerObserver(usbGamepads[1], 1),
+    UsbGamepadDreamcastControllerObserver(usbGamepads[2], 2),
+    UsbGamepadDreamcastControllerObserver(usbGamepads[3], 3)
 };
-CriticalSectionMutex screenMutexes[NUMBER_OF_DEVICES];
-ScreenData screenData[NUMBER_OF_DEVICES] = {
-    ScreenData(screenMutexes[0]),
-    ScreenData(screenMutexes[1]),
-    ScreenData(screenMutexes[2]),
-    ScreenData(screenMutexes[3])
+ScreenData screenData[NUMBER_OF_DEVICES];
+PollingBudget pollingBudgets[NUMBER_OF_DEVICES] = {
+    PollingBudget(MAPLE_POLLING_BUDGET_PERMILLE),
+    PollingBudget(MAPLE_POLLING_BUDGET_PERMILLE),
+    PollingBudget(MAPLE_POLLING_BUDGET_PERMILLE),
+    PollingBudget(MAPLE_POLLING_BUDGET_PERMILLE)
 };
+UsbSofClock usbSofClock;
+FramePhaseMonitor framePhaseMonitors[NUMBER_OF_DEVICES];
 PlayerData playerData[NUMBER_OF_DEVICES] = {
-    {0, usbGamepadDreamcastControllerObservers[0], screenData[0]},
-    {1, usbGamepadDreamcastControllerObservers[1], screenData[1]},
-    {2, usbGamepadDreamcastControllerObservers[2], screenData[2]},
-    {3, usbGamepadDreamcastControllerObservers[3], screenData[3]}
+    {0, usbGamepadDreamcastControllerObservers[0], screenData[0], pollingBudgets[0], usbSofClock,
+        framePhaseMonitors[0]},
+    {1, usbGamepadDreamcastControllerObservers[1], screenData[1], pollingBudgets[1], usbSofClock,
+        framePhaseMonitors[1]},
+    {2, usbGamepadDreamcastControllerObservers[2], screenData[2], pollingBudgets[2], usbSofClock,
+        framePhaseMonitors[2]},
+    {3, usbGamepadDreamcastControllerObservers[3], screenData[3], pollingBudgets[3], usbSofClock,
+        framePhaseMonitors[3]}
 };
 MapleBus busses[NUMBER_OF_DEVICES] = {
     MapleBus(P1_BUS_START_PIN, MAPLE_HOST_ADDRESS),
@@ -60,11 +69,53 @@ MapleBus busses[NUMBER_OF_DEVICES] = {
     MapleBus(P3_BUS_START_PIN, MAPLE_HOST_ADDRESS),
     MapleBus(P4_BUS_START_PIN, MAPLE_HOST_ADDRESS),
 };
+// Nodes are constructed in place; they hold their peripherals and may not be copied
+DreamcastSubNode dreamcastSubNodes[NUMBER_OF_DEVICES][DreamcastPeripheral::MAX_SUB_PERIPHERALS] = {
+    {
+        {DreamcastPeripheral::subPeripheralMask(0), busses[0], playerData[0]},
+        {DreamcastPeripheral::subPeripheralMask(1), busses[0], playerData[0]},
+        {DreamcastPeripheral::subPeripheralMask(2), busses[0], playerData[0]},
+        {DreamcastPeripheral::subPeripheralMask(3), busses[0], playerData[0]},
+        {DreamcastPeripheral::subPeripheralMask(4), busses[0], playerData[0]}
+    },
+    {
+        {DreamcastPeripheral::subPeripheralMask(0), busses[1], playerData[1]},
+        {DreamcastPeripheral::subPeripheralMask(1), busses[1], playerData[1]},
+        {DreamcastPeripheral::subPeripheralMask(2), busses[1], playerData[1]},
+        {DreamcastPeripheral::subPeripheralMask(3), busses[1], playerData[1]},
+        {DreamcastPeripheral::subPeripheralMask(4), busses[1], playerData[1]}
+    },
+    {
+        {DreamcastPeripheral::subPeripheralMask(0), busses[2], playerData[2]},
+        {DreamcastPeripheral::subPeripheralMask(1), busses[2], playerData[2]},
+        {DreamcastPeripheral::subPeripheralMask(2), busses[2], playerData[2]},
+        {DreamcastPeripheral::subPeripheralMask(3), busses[2], playerData[2]},
+        {DreamcastPeripheral::subPeripheralMask(4), busses[2], playerData[2]}
+    },
+    {
+        {DreamcastPeripheral::subPeripheralMask(0), busses[3], playerData[3]},
+        {DreamcastPeripheral::subPeripheralMask(1), busses[3], playerData[3]},
+        {DreamcastPeripheral::subPeripheralMask(2), busses[3], playerData[3]},
+        {DreamcastPeripheral::subPeripheralMask(3), busses[3], playerData[3]},
+        {DreamcastPeripheral::subPeripheralMask(4), busses[3], playerData[3]}
+    }
+};
+DreamcastSubNode* const
+    dreamcastSubNodePointers[NUMBER_OF_DEVICES][DreamcastPeripheral::MAX_SUB_PERIPHERALS] = {
+    {&dreamcastSubNodes[0][0], &dreamcastSubNodes[0][1], &dreamcastSubNodes[0][2],
+        &dreamcastSubNodes[0][3], &dreamcastSubNodes[0][4]},
+    {&dreamcastSubNodes[1][0], &dreamcastSubNodes[1][1], &dreamcastSubNodes[1][2],
+        &dreamcastSubNodes[1][3], &dreamcastSubNodes[1][4]},
+    {&dreamcastSubNodes[2][0], &dreamcastSubNodes[2][1], &dreamcastSubNodes[2][2],
+        &dreamcastSubNodes[2][3], &dreamcastSubNodes[2][4]},
+    {&dreamcastSubNodes[3][0], &dreamcastSubNodes[3][1], &dreamcastSubNodes[3][2],
+        &dreamcastSubNodes[3][3], &dreamcastSubNodes[3][4]}
+};
 DreamcastMainNode dreamcastMainNodes[NUMBER_OF_DEVICES] = {
-    DreamcastMainNode(busses[0], playerData[0]),
-    DreamcastMainNode(busses[1], playerData[1]),
-    DreamcastMainNode(busses[2], playerData[2]),
-    DreamcastMainNode(busses[3], playerData[3])
+    {busses[0], playerData[0], dreamcastSubNodePointers[0]},
+    {busses[1], playerData[1], dreamcastSubNodePointers[1]},
+    {busses[2], playerData[2], dreamcastSubNodePointers[2]},
+    {busses[3], playerData[3], dreamcastSubNodePointers[3]}
 };
 
 UsbControllerInterface* devices[NUMBER_OF_DEVICES] = {
@@ -74,21 +125,71 @@ UsbControllerInterface* devices[NUMBER_OF_DEVICES] = {
     &usbGamepads[3]
 };
 
+// Applies controller updates published by core1 as soon as its doorbell rings
+void process_doorbells()
+{
+    while (multicore_fifo_rvalid())
+    {
+        uint32_t idx = multicore_fifo_pop_blocking();
+        if (idx < NUMBER_OF_DEVICES && usbGamepadDreamcastControllerObservers[idx].process())
+        {
+            // Get the report into the endpoint ahead of the host's next poll
+            usbGamepads[idx].send();
+        }
+    }
+
+    if (UsbGamepadDreamcastControllerObserver::checkDoorbellMissed())
+    {
+        for (uint32_t i = 0; i < NUMBER_OF_DEVICES; ++i)
+        {
+            if (usbGamepadDreamcastControllerObservers[i].process())
+            {
+                usbGamepads[i].send();
+            }
+        }
+    }
+}
+
 void core1()
 {
     set_sys_clock_khz(CPU_FREQ_KHZ, true);
 
+    // All Maple Bus interrupts and timeout alarms are serviced on this core
+    MapleBus::initIsrs();
+
+#if MAPLE_ISR_JITTER_BENCHMARK
+    isr_jitter_benchmark_init();
+#endif
+
     // Wait for steady state
     sleep_ms(100);
 
     while(true)
     {
+#if MAPLE_ISR_JITTER_BENCHMARK
+        isr_jitter_benchmark_sample();
+#endif
+
         uint64_t time = time_us_64();
+        uint64_t wakeTime = time + CORE1_MAX_IDLE_US;
         for (DreamcastMainNode* p_node = &dreamcastMainNodes[0];
              p_node <= &dreamcastMainNodes[NUMBER_OF_DEVICES - 1];
              ++p_node)
         {
             p_node->task(time);
+
+            uint64_t dueTime = p_node->getNextDueTime();
+            if (dueTime < wakeTime)
+            {
+                wakeTime = dueTime;
+            }
+        }
+
+        // Sleep until a bus interrupt or alarm fires (completions are then handed out on the next
+        // pass) or until the earliest node deadline
+        if (wakeTime > time_us_64())
+        {
+            best_effort_wfe_or_timeout(from_us_since_boot(wakeTime));
         }
     }
 }
@@ -99,9 +200,20 @@ int main()
 
     board_init();
 
+#if MAPLE_XIP_CACHE_STATS || MAPLE_RUNTIME_STATS || MAPLE_ISR_JITTER_BENCHMARK
+    stdio_init_all();
+#endif
+#if MAPLE_XIP_CACHE_STATS
+    xip_cache_stats_init();
+#endif
+#if MAPLE_RUNTIME_STATS
+    runtime_stats_init(busses, usbGamepads, framePhaseMonitors, NUMBER_OF_DEVICES);
+#endif
+
     multicore_launch_core1(core1);
 
     set_usb_devices(devices, sizeof(devices) / sizeof(devices[1]));
+    set_usb_sof_clock(&usbSofClock);
 
     usb_init();
 
@@ -119,7 +231,17 @@ int main()
 
     while(true)
     {
+        process_doorbells();
         usb_task();
+#if MAPLE_XIP_CACHE_STATS
+        xip_cache_stats_task();
+#endif
+#if MAPLE_RUNTIME_STATS
+        runtime_stats_task();
+#endif
+#if MAPLE_ISR_JITTER_BENCHMARK
+        isr_jitter_benchmark_task();
+#endif
     }
 }
 
@@ -0,0 +1,118 @@
+#include "DeadlineScheduler.hpp"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+//! Records the order in which tasks run and reschedules itself a fixed period later
+class RecordingTask : public DeadlineScheduler::Task
+{
+    public:
+        RecordingTask(uint32_t id, uint64_t periodUs, std::vector<uint32_t>& runOrder) :
+            mId(id), mPeriodUs(periodUs), mRunOrder(runOrder)
+        {}
+
+        virtual uint64_t runTask(uint64_t currentTimeUs)
+        {
+            mRunOrder.push_back(mId);
+            return (mPeriodUs == DeadlineScheduler::NEVER) ? mPeriodUs : currentTimeUs + mPeriodUs;
+        }
+
+        const uint32_t mId;
+        uint64_t mPeriodUs;
+        std::vector<uint32_t>& mRunOrder;
+};
+
+TEST(DeadlineSchedulerTest, runsOnlyDueTasksInDeadlineOrder)
+{
+    // --- SETUP ---
+    std::vector<uint32_t> runOrder;
+    RecordingTask t1(1, 100, runOrder);
+    RecordingTask t2(2, 100, runOrder);
+    RecordingTask t3(3, 100, runOrder);
+    RecordingTask t4(4, 100, runOrder);
+    DeadlineScheduler scheduler;
+    scheduler.schedule(&t1, 40);
+    scheduler.schedule(&t2, 10);
+    scheduler.schedule(&t3, 30);
+    scheduler.schedule(&t4, 20);
+
+    // --- TEST EXECUTION ---
+    uint32_t numRun = scheduler.runDue(30);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(numRun, 3U);
+    EXPECT_EQ(runOrder, (std::vector<uint32_t>{2, 4, 3}));
+    // Task 1 is still waiting, and everything else was rescheduled 100 us later
+    EXPECT_EQ(scheduler.getNextDueTime(), 40U);
+    EXPECT_EQ(scheduler.size(), 4U);
+}
+
+TEST(DeadlineSchedulerTest, rescheduleAndUnschedule)
+{
+    // --- SETUP ---
+    std::vector<uint32_t> runOrder;
+    RecordingTask t1(1, DeadlineScheduler::NEVER, runOrder);
+    RecordingTask t2(2, DeadlineScheduler::NEVER, runOrder);
+    RecordingTask t3(3, DeadlineScheduler::NEVER, runOrder);
+    DeadlineScheduler scheduler;
+    scheduler.schedule(&t1, 10);
+    scheduler.schedule(&t2, 20);
+    scheduler.schedule(&t3, 30);
+
+    // --- TEST EXECUTION ---
+    // Move task 1 behind the others, pull task 3 ahead of them, and drop task 2
+    scheduler.schedule(&t1, 50);
+    scheduler.schedule(&t3, 5);
+    scheduler.unschedule(&t2);
+    scheduler.runDue(100);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(runOrder, (std::vector<uint32_t>{3, 1}));
+    // Tasks which return NEVER are dropped from the schedule
+    EXPECT_EQ(scheduler.size(), 0U);
+    EXPECT_EQ(scheduler.getNextDueTime(), DeadlineScheduler::NEVER);
+}
+
+TEST(DeadlineSchedulerTest, taskDueAgainImmediatelyRunsOncePerCall)
+{
+    // --- SETUP ---
+    std::vector<uint32_t> runOrder;
+    RecordingTask t1(1, 0, runOrder);
+    RecordingTask t2(2, 0, runOrder);
+    DeadlineScheduler scheduler;
+    scheduler.schedule(&t1, 0);
+    scheduler.schedule(&t2, 0);
+
+    // --- TEST EXECUTION ---
+    scheduler.runDue(10);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(runOrder.size(), 2U);
+    EXPECT_EQ(scheduler.getNextDueTime(), 10U);
+}
+
+TEST(DeadlineSchedulerTest, capacityLimit)
+{
+    // --- SETUP ---
+    std::vector<uint32_t> runOrder;
+    std::vector<RecordingTask> tasks;
+    tasks.reserve(DeadlineScheduler::MAX_TASKS + 1);
+    for (uint32_t i = 0; i <= DeadlineScheduler::MAX_TASKS; ++i)
+    {
+        tasks.push_back(RecordingTask(i, 10, runOrder));
+    }
+    DeadlineScheduler scheduler;
+
+    // --- TEST EXECUTION / EXPECTATIONS ---
+    for (uint32_t i = 0; i < DeadlineScheduler::MAX_TASKS; ++i)
+    {
+        EXPECT_TRUE(scheduler.schedule(&tasks[i], 100 - i));
+    }
+    EXPECT_FALSE(scheduler.schedule(&tasks[DeadlineScheduler::MAX_TASKS], 0));
+    EXPECT_EQ(scheduler.getNextDueTime(), 100U - (DeadlineScheduler::MAX_TASKS - 1));
+
+    scheduler.clear();
+    EXPECT_EQ(scheduler.size(), 0U);
+    EXPECT_TRUE(scheduler.schedule(&tasks[DeadlineScheduler::MAX_TASKS], 0));
+}
@@ -0,0 +1,140 @@
+#include "MockedMapleBus.hpp"
+#include "MockedDreamcastControllerObserver.hpp"
+
+#include "DreamcastController.hpp"
+#include "dreamcast_constants.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+using ::testing::_;
+using ::testing::Return;
+using ::testing::NiceMock;
+using ::testing::DoAll;
+using ::testing::SaveArg;
+
+class DreamcastControllerTest : public ::testing::Test
+{
+    public:
+        DreamcastControllerTest() :
+            mDreamcastControllerObserver(),
+            mScreenData(),
+            mPollingBudget(1000),
+            mUsbSofClock(),
+            mFramePhaseMonitor(),
+            mPlayerData{0,
+                        mDreamcastControllerObserver,
+                        mScreenData,
+                        mPollingBudget,
+                        mUsbSofClock,
+                        mFramePhaseMonitor},
+            mMapleBus()
+        {}
+
+    protected:
+        NiceMock<MockedDreamcastControllerObserver> mDreamcastControllerObserver;
+        ScreenData mScreenData;
+        PollingBudget mPollingBudget;
+        UsbSofClock mUsbSofClock;
+        FramePhaseMonitor mFramePhaseMonitor;
+        PlayerData mPlayerData;
+        NiceMock<MockedMapleBus> mMapleBus;
+
+        //! Delivers a condition response to the controller; each call reports a different condition
+        void respond(DreamcastController& controller)
+        {
+            static uint32_t counter = 0;
+            uint32_t response[4] = {
+                (COMMAND_RESPONSE_DATA_XFER << 24) | 3, DEVICE_FN_CONTROLLER, ++counter, 0};
+            controller.transactionComplete(MapleTransactionObserver::STATUS_SUCCESS, response, 4);
+        }
+};
+
+TEST_F(DreamcastControllerTest, pollsWithoutFramesUseGovernorPeriod)
+{
+    // --- SETUP ---
+    DreamcastController controller(0x20, mMapleBus, mPlayerData);
+
+    // --- MOCKING ---
+    EXPECT_CALL(mMapleBus, submit(_)).Times(1).WillOnce(Return(true));
+
+    // --- TEST EXECUTION ---
+    controller.task(1000123);
+    respond(controller);
+
+    // --- EXPECTATIONS ---
+    // No USB frames seen, so polling is free running at 1 kHz
+    EXPECT_EQ(controller.getNextDueTime(), 1001123U);
+    FramePhaseStats stats;
+    mFramePhaseMonitor.read(stats);
+    EXPECT_EQ(stats.numSamples, 0U);
+}
+
+TEST_F(DreamcastControllerTest, pollsAreLatencyCriticalAndReserveTheNextPoll)
+{
+    // --- SETUP ---
+    DreamcastController controller(0x20, mMapleBus, mPlayerData);
+    MapleTransaction transaction = {};
+
+    // --- MOCKING ---
+    EXPECT_CALL(mMapleBus, submit(_))
+        .Times(1)
+        .WillOnce(DoAll(SaveArg<0>(&transaction), Return(true)));
+    EXPECT_CALL(mMapleBus, reserve(1001123U)).Times(1);
+
+    // --- TEST EXECUTION ---
+    controller.task(1000123);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(transaction.trafficClass, MapleTransaction::TRAFFIC_LATENCY_CRITICAL);
+}
+
+TEST_F(DreamcastControllerTest, pollsAlignToUsbFrames)
+{
+    // --- SETUP ---
+    DreamcastController controller(0x20, mMapleBus, mPlayerData);
+    // Poll start ahead of each frame (poll time plus margin), and the time a poll takes
+    const uint32_t leadUs = PollingGovernor::transactionCostUs(1, 3) + USB_SOF_POLL_MARGIN_US;
+    const uint32_t pollUs = PollingGovernor::transactionCostUs(1, 3);
+    // The host's frames start 437 us into each millisecond of our clock, and the USB core notices
+    // each one anywhere up to 40 us late
+    const uint64_t firstSofUs = 1000437;
+    uint32_t frameNumber = 0;
+    uint64_t nextSofUs = firstSofUs;
+
+    // --- MOCKING ---
+    EXPECT_CALL(mMapleBus, submit(_)).WillRepeatedly(Return(true));
+
+    // --- TEST EXECUTION ---
+    uint64_t timeUs = 1000000;
+    mUsbSofClock.frameStarted(frameNumber++, timeUs - 563 + 17);
+    for (uint32_t i = 0; i < 200; ++i)
+    {
+        // Run the USB core's view of the frames up to now
+        while (nextSofUs <= timeUs)
+        {
+            mUsbSofClock.frameStarted(frameNumber++, nextSofUs + ((frameNumber * 7919) % 41));
+            nextSofUs += 1000;
+        }
+
+        // Start the poll, then deliver its condition once the bus is done with it
+        controller.task(timeUs);
+        respond(controller);
+        controller.task(timeUs + pollUs);
+
+        // Wake up for the next poll a little late
+        timeUs = controller.getNextDueTime() + (i % 5);
+    }
+
+    // --- EXPECTATIONS ---
+    FramePhaseStats stats;
+    mFramePhaseMonitor.read(stats);
+    // Once the clock has settled, every condition lands in the window just before a frame
+    EXPECT_EQ(stats.numSamples, 200U);
+    EXPECT_GE(stats.numOnTime, 195U);
+    uint64_t averageLeadUs = stats.totalLeadUs / stats.numSamples;
+    EXPECT_LE(averageLeadUs, leadUs - pollUs);
+    EXPECT_GE(averageLeadUs, leadUs - pollUs - 50);
+    // Polls stayed at 1 kHz rather than slipping a frame
+    EXPECT_NEAR(static_cast<double>(timeUs - 1000000), 200000.0, 1000.0);
+}
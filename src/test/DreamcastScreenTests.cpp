@@ -0,0 +1,103 @@
+#include "MockedMapleBus.hpp"
+#include "MockedDreamcastControllerObserver.hpp"
+
+#include "DreamcastScreen.hpp"
+#include "dreamcast_constants.h"
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+using ::testing::_;
+using ::testing::Return;
+using ::testing::NiceMock;
+
+class DreamcastScreenTest : public ::testing::Test
+{
+    public:
+        DreamcastScreenTest() :
+            mDreamcastControllerObserver(),
+            mScreenData(),
+            mPollingBudget(1000),
+            mUsbSofClock(),
+            mFramePhaseMonitor(),
+            mPlayerData{0,
+                        mDreamcastControllerObserver,
+                        mScreenData,
+                        mPollingBudget,
+                        mUsbSofClock,
+                        mFramePhaseMonitor},
+            mMapleBus()
+        {}
+
+    protected:
+        NiceMock<MockedDreamcastControllerObserver> mDreamcastControllerObserver;
+        ScreenData mScreenData;
+        PollingBudget mPollingBudget;
+        UsbSofClock mUsbSofClock;
+        FramePhaseMonitor mFramePhaseMonitor;
+        PlayerData mPlayerData;
+        NiceMock<MockedMapleBus> mMapleBus;
+
+        //! Runs one screen period and acknowledges any write
+        void runPeriod(DreamcastScreen& screen, uint64_t& currentTimeUs)
+        {
+            screen.task(currentTimeUs);
+            uint32_t response[1] = {COMMAND_RESPONSE_ACK << 24};
+            screen.transactionComplete(MapleTransactionObserver::STATUS_SUCCESS, response, 1);
+            currentTimeUs += 16000;
+        }
+};
+
+TEST_F(DreamcastScreenTest, redrawnScreenIsNotWrittenAgain)
+{
+    // --- SETUP ---
+    DreamcastScreen screen(0x01, mMapleBus, mPlayerData);
+    uint64_t currentTimeUs = 0;
+    uint32_t words[ScreenData::NUM_SCREEN_WORDS] = {};
+    uint32_t writeFrameWord = MapleEncodedPacket::makeFrameWord(
+        COMMAND_BLOCK_WRITE, 0x01, 0x00, ScreenData::NUM_SCREEN_WORDS + 2);
+
+    // --- MOCKING ---
+    // Default screen, then the new screen, then nothing for the redraws, then the changed screen
+    EXPECT_CALL(mMapleBus, submit(TransactionIs(writeFrameWord, &screen)))
+        .Times(3)
+        .WillRepeatedly(Return(true));
+
+    // --- TEST EXECUTION ---
+    runPeriod(screen, currentTimeUs);
+    mScreenData.setData(words);
+    runPeriod(screen, currentTimeUs);
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        mScreenData.setData(words);
+        runPeriod(screen, currentTimeUs);
+    }
+    words[0] = 1;
+    mScreenData.setData(words);
+    runPeriod(screen, currentTimeUs);
+}
+
+TEST_F(DreamcastScreenTest, failedWriteIsSentAgain)
+{
+    // --- SETUP ---
+    DreamcastScreen screen(0x01, mMapleBus, mPlayerData);
+    uint64_t currentTimeUs = 0;
+    uint32_t words[ScreenData::NUM_SCREEN_WORDS] = {};
+    uint32_t writeFrameWord = MapleEncodedPacket::makeFrameWord(
+        COMMAND_BLOCK_WRITE, 0x01, 0x00, ScreenData::NUM_SCREEN_WORDS + 2);
+    runPeriod(screen, currentTimeUs);
+    mScreenData.setData(words);
+
+    // --- MOCKING ---
+    // The failed write, then the same screen again, then nothing once it is acknowledged
+    EXPECT_CALL(mMapleBus, submit(TransactionIs(writeFrameWord, &screen)))
+        .Times(2)
+        .WillRepeatedly(Return(true));
+
+    // --- TEST EXECUTION ---
+    screen.task(currentTimeUs);
+    screen.transactionComplete(MapleTransactionObserver::STATUS_CRC_ERROR, NULL, 0);
+    currentTimeUs += 16000;
+    runPeriod(screen, currentTimeUs);
+    runPeriod(screen, currentTimeUs);
+}
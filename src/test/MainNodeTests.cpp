@@ -1,7 +1,6 @@
 #include "MockedMapleBus.hpp"
 #include "MockedDreamcastControllerObserver.hpp"
 #include "MockedDreamcastPeripheral.hpp"
-#include "MockedMutex.hpp"
 #include "MockedUsbController.hpp"
 
 #include "DreamcastMainNode.hpp"
@@ -18,6 +17,9 @@ using ::testing::_;
 using ::testing::Return;
 using ::testing::SetArgReferee;
 using ::testing::DoAll;
+using ::testing::An;
+using ::testing::Invoke;
+using ::testing::AnyNumber;
 
 class MockedDreamcastSubNode : public DreamcastSubNode
 {
@@ -38,27 +40,39 @@ class MockedDreamcastSubNode : public DreamcastSubNode
         MOCK_METHOD(void, setConnected, (bool connected), (override));
 };
 
-class DreamcastMainNodeOverride : public DreamcastMainNode
+//! Mocked sub nodes, held in a base class so that they exist before the main node is given them
+struct MockedDreamcastSubNodes
 {
-    public:
-        DreamcastMainNodeOverride(MapleBusInterface& bus, PlayerData playerData) :
-            DreamcastMainNode(bus, playerData),
-            mMockedSubNodes()
+    MockedDreamcastSubNodes(MapleBusInterface& bus, PlayerData playerData) :
+        mMockedSubNodes(),
+        mSubNodePointers()
+    {
+        uint32_t numSubNodes = DreamcastPeripheral::MAX_SUB_PERIPHERALS;
+        mMockedSubNodes.reserve(numSubNodes);
+        for (uint32_t i = 0; i < numSubNodes; ++i)
         {
-            // Swap out the real sub nodes with mocked sub nodes
-            mSubNodes.clear();
-            uint32_t numSubNodes = DreamcastPeripheral::MAX_SUB_PERIPHERALS;
-            mMockedSubNodes.reserve(numSubNodes);
-            mSubNodes.reserve(numSubNodes);
-            for (uint32_t i = 0; i < numSubNodes; ++i)
-            {
-                std::shared_ptr<MockedDreamcastSubNode> mockedSubNode =
-                    std::make_shared<MockedDreamcastSubNode>(
-                        DreamcastPeripheral::subPeripheralMask(i), mBus, mPlayerData);
-                mMockedSubNodes.push_back(mockedSubNode);
-                mSubNodes.push_back(mockedSubNode);
-            }
+            std::shared_ptr<MockedDreamcastSubNode> mockedSubNode =
+                std::make_shared<MockedDreamcastSubNode>(
+                    DreamcastPeripheral::subPeripheralMask(i), bus, playerData);
+            mMockedSubNodes.push_back(mockedSubNode);
+            mSubNodePointers[i] = mockedSubNode.get();
         }
+    }
+
+    //! The mocked sub nodes
+    std::vector<std::shared_ptr<MockedDreamcastSubNode>> mMockedSubNodes;
+
+    //! The mocked sub nodes as given to the main node
+    DreamcastSubNode* mSubNodePointers[DreamcastPeripheral::MAX_SUB_PERIPHERALS];
+};
+
+class DreamcastMainNodeOverride : public MockedDreamcastSubNodes, public DreamcastMainNode
+{
+    public:
+        DreamcastMainNodeOverride(MapleBusInterface& bus, PlayerData playerData) :
+            MockedDreamcastSubNodes(bus, playerData),
+            DreamcastMainNode(bus, playerData, mSubNodePointers)
+        {}
 
         //! Called from peripheralFactory below so we can test what function code it was called with
         MOCK_METHOD(void, mockMethodPeripheralFactory, (uint32_t functionCode));
@@ -67,7 +81,7 @@ class DreamcastMainNodeOverride : public DreamcastMainNode
         //! created.
         void peripheralFactory(uint32_t functionCode) override
         {
-            mPeripherals = mPeripheralsToAdd;
+            mPeripheral.refer(mPeripheralToAdd.get());
             mockMethodPeripheralFactory(functionCode);
         }
 
@@ -77,17 +91,20 @@ class DreamcastMainNodeOverride : public DreamcastMainNode
         //! Allows the test to initialize the value of mNextCheckTime
         void setNextCheckTime(uint64_t t) {mNextCheckTime = t;}
 
-        //! Allows the test to check what peripherals the node has
-        std::vector<std::shared_ptr<DreamcastPeripheral>>& getPeripherals()
+        //! Allows the test to connect a peripheral which it owns
+        void connectPeripheral(DreamcastPeripheral* peripheral) {mPeripheral.refer(peripheral);}
+
+        //! Allows the test to run the real peripheral factory
+        void realPeripheralFactory(uint32_t functionCode)
         {
-            return mPeripherals;
+            DreamcastMainNode::peripheralFactory(functionCode);
         }
 
-        //! The mocked nodes set in the constructor
-        std::vector<std::shared_ptr<MockedDreamcastSubNode>> mMockedSubNodes;
+        //! Allows the test to check which peripheral the node has (NULL if none)
+        DreamcastPeripheral* getPeripheral() {return mPeripheral.get();}
 
-        //! Allows the test to set what peripherals to add on next call to peripheralFactory()
-        std::vector<std::shared_ptr<DreamcastPeripheral>> mPeripheralsToAdd;
+        //! Allows the test to set what peripheral to add on next call to peripheralFactory()
+        std::shared_ptr<DreamcastPeripheral> mPeripheralToAdd;
 };
 
 class MainNodeTest : public ::testing::Test
@@ -96,23 +113,35 @@ class MainNodeTest : public ::testing::Test
         //! Sets up the DreamcastMainNode with mocked interfaces
         MainNodeTest() :
             mDreamcastControllerObserver(),
-            mMutex(),
-            mScreenData(mMutex),
-            mPlayerData{0, mDreamcastControllerObserver, mScreenData},
+            mScreenData(),
+            mPollingBudget(1000),
+            mUsbSofClock(),
+            mFramePhaseMonitor(),
+            mPlayerData{0,
+                        mDreamcastControllerObserver,
+                        mScreenData,
+                        mPollingBudget,
+                        mUsbSofClock,
+                        mFramePhaseMonitor},
             mMapleBus(),
             mDreamcastMainNode(mMapleBus, mPlayerData)
         {}
 
     protected:
         MockedDreamcastControllerObserver mDreamcastControllerObserver;
-        MockedMutex mMutex;
         ScreenData mScreenData;
+        PollingBudget mPollingBudget;
+        UsbSofClock mUsbSofClock;
+        FramePhaseMonitor mFramePhaseMonitor;
         PlayerData mPlayerData;
         MockedMapleBus mMapleBus;
         DreamcastMainNodeOverride mDreamcastMainNode;
 
         virtual void SetUp()
-        {}
+        {
+            // Nodes cancel anything they left queued on the bus whenever they are torn down
+            EXPECT_CALL(mMapleBus, cancel(_)).Times(AnyNumber());
+        }
 
         virtual void TearDown()
         {}
@@ -128,13 +157,7 @@ TEST_F(MainNodeTest, successfulInfoRequest)
         .Times(1)
         .WillOnce(DoAll(SetArgReferee<0>((uint32_t)0), SetArgReferee<1>(false), Return((const uint32_t*)NULL)));
     // Since no peripherals are detected, the main node should do a info request, and it will be successful
-    EXPECT_CALL(mMapleBus,
-                write((uint8_t)COMMAND_DEVICE_INFO_REQUEST,
-                      (uint8_t)0x20,
-                      (const uint32_t*)NULL,
-                      (uint8_t)0,
-                      true,
-                      _))
+    EXPECT_CALL(mMapleBus, submit(TransactionIs(0x01200000, &mDreamcastMainNode)))
         .Times(1)
         .WillOnce(Return(true));
 
@@ -156,13 +179,7 @@ TEST_F(MainNodeTest, unsuccessfulInfoRequest)
         .Times(1)
         .WillOnce(DoAll(SetArgReferee<0>((uint32_t)0), SetArgReferee<1>(false), Return((const uint32_t*)NULL)));
     // Since no peripherals are detected, the main node should do a info request, and it will be unsuccessful
-    EXPECT_CALL(mMapleBus,
-                write((uint8_t)COMMAND_DEVICE_INFO_REQUEST,
-                      (uint8_t)0x20,
-                      (const uint32_t*)NULL,
-                      (uint8_t)0,
-                      true,
-                      _))
+    EXPECT_CALL(mMapleBus, submit(TransactionIs(0x01200000, &mDreamcastMainNode)))
         .Times(1)
         .WillOnce(Return(false));
 
@@ -174,6 +191,57 @@ TEST_F(MainNodeTest, unsuccessfulInfoRequest)
     EXPECT_LE(mDreamcastMainNode.getNextCheckTime(), 1000000);
 }
 
+TEST_F(MainNodeTest, infoRequestNotRepeatedWhilePending)
+{
+    // --- MOCKING ---
+    EXPECT_CALL(mMapleBus, processEvents(_)).Times(2);
+    EXPECT_CALL(mMapleBus, getReadData(_, _))
+        .Times(2)
+        .WillRepeatedly(DoAll(SetArgReferee<0>((uint32_t)0), SetArgReferee<1>(false), Return((const uint32_t*)NULL)));
+    // Only one info request is queued until its transaction completes
+    EXPECT_CALL(mMapleBus, submit(TransactionIs(0x01200000, &mDreamcastMainNode)))
+        .Times(1)
+        .WillOnce(Return(true));
+
+    // --- TEST EXECUTION ---
+    mDreamcastMainNode.task(1000000);
+    mDreamcastMainNode.task(1020000);
+
+    // --- EXPECTATIONS ---
+    // Next check time was only pushed out by the first request
+    EXPECT_EQ(mDreamcastMainNode.getNextCheckTime(), 1016000);
+}
+
+TEST_F(MainNodeTest, infoRequestRepeatedAfterTimeout)
+{
+    // --- SETUP ---
+    mDreamcastMainNode.setNextCheckTime(999999);
+
+    // --- MOCKING ---
+    // The outstanding info request times out while processing events
+    EXPECT_CALL(mMapleBus, processEvents(1000000))
+        .Times(1)
+        .WillOnce(Invoke([&](uint64_t) {
+            mDreamcastMainNode.transactionComplete(
+                MapleTransactionObserver::STATUS_READ_TIMEOUT, NULL, 0);
+            return 1;
+        }));
+    EXPECT_CALL(mMapleBus, getReadData(_, _))
+        .Times(1)
+        .WillOnce(DoAll(SetArgReferee<0>((uint32_t)0), SetArgReferee<1>(false), Return((const uint32_t*)NULL)));
+    // No peripheral is created, and the info request is queued again
+    EXPECT_CALL(mDreamcastMainNode, mockMethodPeripheralFactory(_)).Times(0);
+    EXPECT_CALL(mMapleBus, submit(TransactionIs(0x01200000, &mDreamcastMainNode)))
+        .Times(1)
+        .WillOnce(Return(true));
+
+    // --- TEST EXECUTION ---
+    mDreamcastMainNode.task(1000000);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(mDreamcastMainNode.getNextCheckTime(), 1016000);
+}
+
 TEST_F(MainNodeTest, peripheralConnect)
 {
     // --- SETUP ---
@@ -182,13 +250,22 @@ TEST_F(MainNodeTest, peripheralConnect)
     // The mocked factory will add a mocked peripheral
     std::shared_ptr<MockedDreamcastPeripheral> mockedDreamcastPeripheral =
         std::make_shared<MockedDreamcastPeripheral>(0x20, mMapleBus, mPlayerData.playerIndex);
-    mDreamcastMainNode.mPeripheralsToAdd.push_back(mockedDreamcastPeripheral);
+    mDreamcastMainNode.mPeripheralToAdd = mockedDreamcastPeripheral;
 
     // --- MOCKING ---
-    // The task should always first process events on the maple bus
-    EXPECT_CALL(mMapleBus, processEvents(1000000)).Times(1);
-    // The task will then read data from the bus, and peripheral status will be returned
+    // The peripheral is asked when it is next due as it is scheduled
+    EXPECT_CALL(*mockedDreamcastPeripheral, getNextDueTime()).Times(AnyNumber());
+    // The task should always first process events on the maple bus, which delivers the response
+    // to the main node's info request
     uint32_t data[2] = {0x05002001, 0x00000001};
+    EXPECT_CALL(mMapleBus, processEvents(1000000))
+        .Times(1)
+        .WillOnce(Invoke([&](uint64_t) {
+            mDreamcastMainNode.transactionComplete(
+                MapleTransactionObserver::STATUS_SUCCESS, data, 2);
+            return 1;
+        }));
+    // The task will then read data from the bus to check which sub peripherals are connected
     EXPECT_CALL(mMapleBus, getReadData(_, _))
         .Times(1)
         .WillOnce(DoAll(SetArgReferee<0>((uint32_t)2), SetArgReferee<1>(true), Return((const uint32_t*)data)));
@@ -209,7 +286,9 @@ TEST_F(MainNodeTest, peripheralConnect)
     EXPECT_CALL(*mDreamcastMainNode.mMockedSubNodes[3], task(1000000)).Times(1);
     EXPECT_CALL(*mDreamcastMainNode.mMockedSubNodes[4], task(1000000)).Times(1);
     // No write operation should be called but the main node
-    EXPECT_CALL(mMapleBus, write(_, _, _, _, _, _)).Times(0);
+    EXPECT_CALL(mMapleBus, write(_, _, An<const uint32_t*>(), _, _, _)).Times(0);
+    EXPECT_CALL(mMapleBus, write(_, _, An<const MapleCodec::Segment*>(), _, _, _)).Times(0);
+    EXPECT_CALL(mMapleBus, submit(_)).Times(0);
 
     // --- TEST EXECUTION ---
     mDreamcastMainNode.task(1000000);
@@ -227,7 +306,7 @@ TEST_F(MainNodeTest, peripheralDisconnect)
     // A main peripheral is currently connected
     std::shared_ptr<MockedDreamcastPeripheral> mockedDreamcastPeripheral =
         std::make_shared<MockedDreamcastPeripheral>(0x20, mMapleBus, mPlayerData.playerIndex);
-    mDreamcastMainNode.getPeripherals().push_back(mockedDreamcastPeripheral);
+    mDreamcastMainNode.connectPeripheral(mockedDreamcastPeripheral.get());
 
     // --- MOCKING ---
     // The task should always first process events on the maple bus
@@ -254,7 +333,76 @@ TEST_F(MainNodeTest, peripheralDisconnect)
     // Next check time should be set to current time
     EXPECT_EQ(mDreamcastMainNode.getNextCheckTime(), 1000000);
     // All peripherals removed
-    EXPECT_EQ(mDreamcastMainNode.getPeripherals().size(), 0);
+    EXPECT_EQ(mDreamcastMainNode.getPeripheral(), (DreamcastPeripheral*)NULL);
+}
+
+TEST_F(MainNodeTest, onlyDueTasksRun)
+{
+    // --- SETUP ---
+    // A main peripheral is currently connected
+    std::shared_ptr<MockedDreamcastPeripheral> mockedDreamcastPeripheral =
+        std::make_shared<MockedDreamcastPeripheral>(0x20, mMapleBus, mPlayerData.playerIndex);
+    mDreamcastMainNode.connectPeripheral(mockedDreamcastPeripheral.get());
+
+    // --- MOCKING ---
+    // Nothing completes on the first two passes, then something completes on the third
+    EXPECT_CALL(mMapleBus, processEvents(_))
+        .Times(3)
+        .WillOnce(Return(0))
+        .WillOnce(Return(0))
+        .WillOnce(Return(1));
+    EXPECT_CALL(mMapleBus, getReadData(_, _))
+        .Times(3)
+        .WillRepeatedly(DoAll(SetArgReferee<0>((uint32_t)0), SetArgReferee<1>(false), Return((const uint32_t*)NULL)));
+    // The peripheral is next due 16 ms after it runs
+    EXPECT_CALL(*mockedDreamcastPeripheral, getNextDueTime())
+        .WillRepeatedly(Return(1016000));
+    EXPECT_CALL(*mockedDreamcastPeripheral, task(1000000)).Times(1).WillOnce(Return(true));
+    EXPECT_CALL(*mockedDreamcastPeripheral, task(1002000)).Times(1).WillOnce(Return(true));
+    // Sub nodes run when first scheduled, and once again after the completion. The real sub nodes
+    // are disconnected, so they report that they are never due otherwise.
+    for (uint32_t i = 0; i < DreamcastPeripheral::MAX_SUB_PERIPHERALS; ++i)
+    {
+        EXPECT_CALL(*mDreamcastMainNode.mMockedSubNodes[i], task(1000000)).Times(1);
+        EXPECT_CALL(*mDreamcastMainNode.mMockedSubNodes[i], task(1002000)).Times(1);
+    }
+
+    // --- TEST EXECUTION ---
+    mDreamcastMainNode.task(1000000);
+    uint64_t dueTimeAfterFirstPass = mDreamcastMainNode.getNextDueTime();
+    mDreamcastMainNode.task(1001000);
+    mDreamcastMainNode.task(1002000);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(dueTimeAfterFirstPass, 1016000U);
+    EXPECT_EQ(mDreamcastMainNode.getNextDueTime(), 1016000U);
+}
+
+TEST_F(MainNodeTest, peripheralFactoryReusesSlot)
+{
+    // --- MOCKING ---
+    // Each peripheral cancels its transactions when it is destroyed
+    EXPECT_CALL(mMapleBus, cancel(_)).Times(::testing::AnyNumber());
+    // The controller is connected when created and disconnected when replaced by the screen
+    EXPECT_CALL(mDreamcastControllerObserver, controllerConnected()).Times(1);
+    EXPECT_CALL(mDreamcastControllerObserver, controllerDisconnected()).Times(1);
+
+    // --- TEST EXECUTION ---
+    mDreamcastMainNode.realPeripheralFactory(DEVICE_FN_CONTROLLER);
+    DreamcastPeripheral* controller = mDreamcastMainNode.getPeripheral();
+    bool isController = (dynamic_cast<DreamcastController*>(controller) != NULL);
+    mDreamcastMainNode.realPeripheralFactory(DEVICE_FN_LCD);
+    DreamcastPeripheral* screen = mDreamcastMainNode.getPeripheral();
+    bool isScreen = (dynamic_cast<DreamcastScreen*>(screen) != NULL);
+    mDreamcastMainNode.realPeripheralFactory(0);
+
+    // --- EXPECTATIONS ---
+    EXPECT_TRUE(isController);
+    EXPECT_TRUE(isScreen);
+    // Both were constructed in the same place within the node
+    EXPECT_EQ(controller, screen);
+    // Nothing is created for an unknown function code
+    EXPECT_EQ(mDreamcastMainNode.getPeripheral(), (DreamcastPeripheral*)NULL);
 }
 
 class MainNodeSubPeripheralConnectTest : public MainNodeTest, public ::testing::WithParamInterface<int>
@@ -270,13 +418,22 @@ TEST_P(MainNodeSubPeripheralConnectTest, subPeripheralConnect)
     // A main peripheral is currently connected
     std::shared_ptr<MockedDreamcastPeripheral> mockedDreamcastPeripheral =
         std::make_shared<MockedDreamcastPeripheral>(0x01, mMapleBus, mPlayerData.playerIndex);
-    mDreamcastMainNode.getPeripherals().push_back(mockedDreamcastPeripheral);
+    mDreamcastMainNode.connectPeripheral(mockedDreamcastPeripheral.get());
 
     // --- MOCKING ---
-    // The task should always first process events on the maple bus
-    EXPECT_CALL(mMapleBus, processEvents(1000000)).Times(1);
-    // The task will then read data from the bus, and a sub peripheral's info is returned
+    // The peripheral is asked when it is next due as it is scheduled
+    EXPECT_CALL(*mockedDreamcastPeripheral, getNextDueTime()).Times(AnyNumber());
+    // The task should always first process events on the maple bus, which delivers a sub
+    // peripheral's info straight to the sub node which requested it
     uint32_t data[2] = {0x05000001U | (0x01U << (idx + 8)), 8675309};
+    EXPECT_CALL(mMapleBus, processEvents(1000000))
+        .Times(1)
+        .WillOnce(Invoke([&](uint64_t) {
+            mDreamcastMainNode.mMockedSubNodes[idx]->transactionComplete(
+                MapleTransactionObserver::STATUS_SUCCESS, data, 2);
+            return 1;
+        }));
+    // The task will then read the same data from the bus, but it isn't from the main peripheral
     EXPECT_CALL(mMapleBus, getReadData(_, _))
         .Times(1)
         .WillOnce(DoAll(SetArgReferee<0>((uint32_t)2), SetArgReferee<1>(true), Return((const uint32_t*)data)));
@@ -305,4 +462,4 @@ TEST_P(MainNodeSubPeripheralConnectTest, subPeripheralConnect)
 INSTANTIATE_TEST_CASE_P(
         MainNodeSubPeripheralConnectTests,
         MainNodeSubPeripheralConnectTest,
-        ::testing::Values(0, 1, 2, 3, 4));
\ No newline at end of file
+        ::testing::Values(0, 1, 2, 3, 4));
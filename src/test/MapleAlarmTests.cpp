@@ -0,0 +1,243 @@
+#include "MapleAlarm.hpp"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    //! Behaves like the pico SDK's alarm pool: a fixed number of slots, and a slot stays taken
+    //! until the callback of the alarm which holds it returns
+    class FakeAlarmPool
+    {
+        public:
+            //! Called when an alarm fires
+            typedef void (*Callback)(int32_t id, void* userData);
+
+            FakeAlarmPool(uint32_t numSlots, Callback callback) :
+                mNumSlots(numSlots),
+                mCallback(callback),
+                mCurrentTimeUs(0),
+                mNextId(1),
+                mSlots()
+            {}
+
+            int32_t add(uint64_t timeUs, void* userData)
+            {
+                if (timeUs <= mCurrentTimeUs)
+                {
+                    return 0;
+                }
+                for (uint32_t i = 0; i < mNumSlots; ++i)
+                {
+                    if (mSlots[i].id == 0)
+                    {
+                        mSlots[i].id = mNextId++;
+                        mSlots[i].timeUs = timeUs;
+                        mSlots[i].userData = userData;
+                        mSlots[i].firing = false;
+                        return mSlots[i].id;
+                    }
+                }
+                return -1;
+            }
+
+            void cancel(int32_t id)
+            {
+                for (uint32_t i = 0; i < mNumSlots; ++i)
+                {
+                    // A firing alarm's slot is freed by the pool once its callback returns
+                    if (mSlots[i].id == id && !mSlots[i].firing)
+                    {
+                        mSlots[i].id = 0;
+                    }
+                }
+            }
+
+            //! Advances time and fires every alarm which is due, one at a time
+            void advance(uint64_t timeUs)
+            {
+                mCurrentTimeUs = timeUs;
+                for (uint32_t i = 0; i < mNumSlots; ++i)
+                {
+                    if (mSlots[i].id != 0 && !mSlots[i].firing && mSlots[i].timeUs <= timeUs)
+                    {
+                        mSlots[i].firing = true;
+                        mCallback(mSlots[i].id, mSlots[i].userData);
+                        mSlots[i].id = 0;
+                        mSlots[i].firing = false;
+                    }
+                }
+            }
+
+            uint64_t getCurrentTimeUs() const { return mCurrentTimeUs; }
+
+        private:
+            static const uint32_t MAX_SLOTS = 16;
+
+            struct Slot
+            {
+                int32_t id;
+                uint64_t timeUs;
+                void* userData;
+                bool firing;
+            };
+
+            const uint32_t mNumSlots;
+            const Callback mCallback;
+            uint64_t mCurrentTimeUs;
+            int32_t mNextId;
+            Slot mSlots[MAX_SLOTS];
+    };
+
+    typedef MapleAlarm<FakeAlarmPool> TestAlarm;
+
+    //! Arms its alarm the way MapleBus does: the open line check, then the write timeout armed
+    //! from within the open line check's alarm
+    class FakeBus
+    {
+        public:
+            FakeBus() :
+                mPool(NULL),
+                mAlarm(),
+                mWriteStarted(false),
+                mNumExpired(0),
+                mNumDeferred(0)
+            {}
+
+            void startOpenLineCheck(FakeAlarmPool& pool)
+            {
+                mPool = &pool;
+                arm(pool.getCurrentTimeUs() + 11);
+            }
+
+            static void alarmCallback(int32_t id, void* userData)
+            {
+                FakeBus* bus = static_cast<FakeBus*>(userData);
+                if (bus->mAlarm.fired(id))
+                {
+                    bus->alarmExpired();
+                }
+            }
+
+            void alarmExpired()
+            {
+                if (!mWriteStarted)
+                {
+                    // Open line check passed - start the write and its timeout
+                    mWriteStarted = true;
+                    arm(mPool->getCurrentTimeUs() + 100);
+                }
+                else
+                {
+                    ++mNumExpired;
+                }
+            }
+
+            void arm(uint64_t timeUs)
+            {
+                TestAlarm::Result result = mAlarm.arm(*mPool, timeUs, this);
+                if (result == TestAlarm::RESULT_EXPIRED)
+                {
+                    alarmExpired();
+                }
+                else if (result == TestAlarm::RESULT_DEFERRED)
+                {
+                    ++mNumDeferred;
+                }
+            }
+
+            FakeAlarmPool* mPool;
+            TestAlarm mAlarm;
+            bool mWriteStarted;
+            uint32_t mNumExpired;
+            uint32_t mNumDeferred;
+    };
+}
+
+TEST(MapleAlarmTest, everyBusArmedAtOnceFitsInPool)
+{
+    // --- SETUP ---
+    const uint32_t numBusses = 4;
+    FakeAlarmPool pool(TestAlarm::POOL_SLOTS_PER_BUS * numBusses, &FakeBus::alarmCallback);
+    FakeBus busses[numBusses];
+
+    // --- TEST EXECUTION ---
+    for (uint32_t i = 0; i < numBusses; ++i)
+    {
+        busses[i].startOpenLineCheck(pool);
+    }
+    // Every open line check finishes, each arming its write timeout from within its callback while
+    // every other bus still holds its own alarm
+    pool.advance(11);
+    uint32_t numExpiredEarly = 0;
+    for (uint32_t i = 0; i < numBusses; ++i)
+    {
+        numExpiredEarly += busses[i].mNumExpired;
+    }
+    pool.advance(111);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(numExpiredEarly, 0U);
+    for (uint32_t i = 0; i < numBusses; ++i)
+    {
+        EXPECT_TRUE(busses[i].mWriteStarted) << "bus " << i;
+        EXPECT_EQ(busses[i].mNumDeferred, 0U) << "bus " << i;
+        EXPECT_EQ(busses[i].mNumExpired, 1U) << "bus " << i;
+    }
+}
+
+TEST(MapleAlarmTest, exhaustedPoolDefersInsteadOfExpiring)
+{
+    // --- SETUP ---
+    // One slot for each bus isn't enough once an alarm is re-armed from its own callback
+    const uint32_t numBusses = 4;
+    FakeAlarmPool pool(numBusses, &FakeBus::alarmCallback);
+    FakeBus busses[numBusses];
+    for (uint32_t i = 0; i < numBusses; ++i)
+    {
+        busses[i].startOpenLineCheck(pool);
+    }
+
+    // --- TEST EXECUTION ---
+    // Only the first bus's alarm fires; the other 3 still hold their slots
+    FakeBus::alarmCallback(1, &busses[0]);
+    bool deferred = busses[0].mAlarm.isDeferred();
+    bool expiredTooEarly = busses[0].mAlarm.deferredExpired(50);
+    bool expiredOnTime = busses[0].mAlarm.deferredExpired(100);
+    bool expiredAgain = busses[0].mAlarm.deferredExpired(200);
+
+    // --- EXPECTATIONS ---
+    EXPECT_TRUE(busses[0].mWriteStarted);
+    EXPECT_EQ(busses[0].mNumDeferred, 1U);
+    // The write is not failed just because no alarm was free
+    EXPECT_EQ(busses[0].mNumExpired, 0U);
+    EXPECT_TRUE(deferred);
+    EXPECT_FALSE(expiredTooEarly);
+    EXPECT_TRUE(expiredOnTime);
+    EXPECT_FALSE(expiredAgain);
+}
+
+TEST(MapleAlarmTest, pastTimeExpiresAndSupersededAlarmIsIgnored)
+{
+    // --- SETUP ---
+    FakeAlarmPool pool(2, &FakeBus::alarmCallback);
+    pool.advance(1000);
+    TestAlarm alarm;
+
+    // --- TEST EXECUTION ---
+    TestAlarm::Result pastResult = alarm.arm(pool, 500, NULL);
+    TestAlarm::Result firstResult = alarm.arm(pool, 2000, NULL);
+    // Re-arming cancels the first alarm
+    TestAlarm::Result secondResult = alarm.arm(pool, 3000, NULL);
+    bool firstFired = alarm.fired(1);
+    bool secondFired = alarm.fired(2);
+    bool secondFiredAgain = alarm.fired(2);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(pastResult, TestAlarm::RESULT_EXPIRED);
+    EXPECT_EQ(firstResult, TestAlarm::RESULT_ARMED);
+    EXPECT_EQ(secondResult, TestAlarm::RESULT_ARMED);
+    EXPECT_FALSE(firstFired);
+    EXPECT_TRUE(secondFired);
+    EXPECT_FALSE(secondFiredAgain);
+    EXPECT_FALSE(alarm.isDeferred());
+}
@@ -0,0 +1,192 @@
+#include "MapleBufferPool.hpp"
+#include "MapleBusInterface.hpp"
+#include "configuration.h"
+
+#include <gtest/gtest.h>
+
+typedef MapleBufferPool<4, 2, 16, 1> TestPool;
+
+namespace
+{
+    //! Number of busses in the firmware
+    const uint32_t NUM_BUSSES = 4;
+
+    //! The pool as the firmware configures it
+    typedef MapleBufferPool<MAPLE_SMALL_BUFFER_WORDS,
+                            MAPLE_NUM_SMALL_BUFFERS,
+                            258,
+                            MAPLE_NUM_LARGE_BUFFERS> FirmwarePool;
+
+    //! Number of words MapleBus borrows for a response with the given read timeout (the frame word
+    //! and CRC on top of the longest payload which fits in the timeout)
+    uint32_t readBufferWords(uint32_t readTimeoutUs)
+    {
+        return MapleBusTiming::READ_TIMEOUT_US.lengthWithin(readTimeoutUs) + 2;
+    }
+}
+
+class MapleBufferPoolTest : public ::testing::Test
+{
+    public:
+        MapleBufferPoolTest() :
+            mSmall(),
+            mLarge(),
+            mPool(mSmall, mLarge)
+        {}
+
+    protected:
+        uint32_t mSmall[2][4];
+        uint32_t mLarge[1][16];
+        TestPool mPool;
+};
+
+TEST_F(MapleBufferPoolTest, smallRequestsTakeSmallBuffersFirst)
+{
+    // --- SETUP ---
+    uint32_t capacity1 = 0;
+    uint32_t capacity2 = 0;
+    uint32_t capacity3 = 0;
+    uint32_t capacity4 = 0;
+
+    // --- TEST EXECUTION ---
+    uint32_t* buffer1 = mPool.borrow(3, capacity1);
+    uint32_t* buffer2 = mPool.borrow(4, capacity2);
+    // Small buffers are all taken, so this one falls back to the large buffer
+    uint32_t* buffer3 = mPool.borrow(1, capacity3);
+    // Nothing is left
+    uint32_t* buffer4 = mPool.borrow(1, capacity4);
+
+    // --- EXPECTATIONS ---
+    EXPECT_NE(buffer1, (uint32_t*)NULL);
+    EXPECT_EQ(capacity1, 4U);
+    EXPECT_NE(buffer2, (uint32_t*)NULL);
+    EXPECT_NE(buffer2, buffer1);
+    EXPECT_EQ(capacity2, 4U);
+    EXPECT_NE(buffer3, (uint32_t*)NULL);
+    EXPECT_EQ(capacity3, 16U);
+    EXPECT_EQ(buffer4, (uint32_t*)NULL);
+    EXPECT_EQ(capacity4, 0U);
+    EXPECT_EQ(mPool.getNumFreeSmall(), 0U);
+    EXPECT_EQ(mPool.getNumFreeLarge(), 0U);
+}
+
+TEST_F(MapleBufferPoolTest, largeRequestsOnlyTakeLargeBuffers)
+{
+    // --- SETUP ---
+    uint32_t capacity1 = 0;
+    uint32_t capacity2 = 0;
+    uint32_t capacity3 = 0;
+
+    // --- TEST EXECUTION ---
+    uint32_t* buffer1 = mPool.borrow(5, capacity1);
+    uint32_t* buffer2 = mPool.borrow(16, capacity2);
+    // Larger than any buffer
+    uint32_t* buffer3 = mPool.borrow(17, capacity3);
+
+    // --- EXPECTATIONS ---
+    EXPECT_NE(buffer1, (uint32_t*)NULL);
+    EXPECT_EQ(capacity1, 16U);
+    // The only large buffer is on loan, and small ones don't fit
+    EXPECT_EQ(buffer2, (uint32_t*)NULL);
+    EXPECT_EQ(capacity2, 0U);
+    EXPECT_EQ(buffer3, (uint32_t*)NULL);
+    EXPECT_EQ(mPool.getNumFreeSmall(), 2U);
+}
+
+TEST_F(MapleBufferPoolTest, givenBackBuffersAreLentAgain)
+{
+    // --- SETUP ---
+    uint32_t capacity = 0;
+    uint32_t* small1 = mPool.borrow(4, capacity);
+    uint32_t* small2 = mPool.borrow(4, capacity);
+    uint32_t* large = mPool.borrow(16, capacity);
+
+    // --- TEST EXECUTION ---
+    mPool.giveBack(small2);
+    mPool.giveBack(large);
+    // NULL is ignored
+    mPool.giveBack(NULL);
+    uint32_t numFreeSmall = mPool.getNumFreeSmall();
+    uint32_t numFreeLarge = mPool.getNumFreeLarge();
+    uint32_t* small3 = mPool.borrow(4, capacity);
+    uint32_t* large2 = mPool.borrow(16, capacity);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(numFreeSmall, 1U);
+    EXPECT_EQ(numFreeLarge, 1U);
+    EXPECT_EQ(small3, small2);
+    EXPECT_NE(small3, small1);
+    EXPECT_EQ(large2, large);
+}
+
+TEST(MapleBufferPoolFirmwareTest, discoveryAndScreenWritesOnEveryBusFitSmallBuffers)
+{
+    // --- SETUP ---
+    static uint32_t small[MAPLE_NUM_SMALL_BUFFERS][MAPLE_SMALL_BUFFER_WORDS];
+    static uint32_t large[MAPLE_NUM_LARGE_BUFFERS][258];
+    FirmwarePool pool(small, large);
+    uint32_t capacity = 0;
+    uint32_t numBorrowed = 0;
+
+    // --- TEST EXECUTION ---
+    for (uint32_t i = 0; i < NUM_BUSSES; ++i)
+    {
+        // An info request (28 word reply) and a screen write (acknowledgement only) on every bus
+        numBorrowed += (pool.borrow(readBufferWords(MapleBusInterface::readTimeoutUs(28)),
+                                    capacity) != NULL);
+        numBorrowed += (pool.borrow(readBufferWords(MapleBusInterface::readTimeoutUs(0)),
+                                    capacity) != NULL);
+    }
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(numBorrowed, 2 * NUM_BUSSES);
+    // None of them needed a buffer for a full packet
+    EXPECT_EQ(pool.getNumFreeLarge(), static_cast<uint32_t>(MAPLE_NUM_LARGE_BUFFERS));
+}
+
+TEST(MapleBufferPoolFirmwareTest, everyBusWaitingOnLargeBuffersIsWokenOnGiveBack)
+{
+    // --- SETUP ---
+    static uint32_t small[MAPLE_NUM_SMALL_BUFFERS][MAPLE_SMALL_BUFFER_WORDS];
+    static uint32_t large[MAPLE_NUM_LARGE_BUFFERS][258];
+    FirmwarePool pool(small, large);
+    // Full packets on every bus at once, such as memory card block reads
+    const uint32_t numWords = readBufferWords(MapleBusInterface::readTimeoutUs(255));
+    uint32_t* buffers[NUM_BUSSES] = {};
+    uint32_t capacity = 0;
+
+    // --- TEST EXECUTION ---
+    uint32_t wokenBeforeGiveBack = 0;
+    for (uint32_t i = 0; i < NUM_BUSSES; ++i)
+    {
+        buffers[i] = pool.borrow(numWords, capacity);
+        if (buffers[i] == NULL)
+        {
+            // As MapleBus::startNextTransaction() does
+            pool.markWaiting(i);
+        }
+        wokenBeforeGiveBack |= pool.takeWoken();
+    }
+    // The first bus finishes its transaction
+    pool.giveBack(buffers[0]);
+    uint32_t woken = pool.takeWoken();
+    uint32_t wokenAgain = pool.takeWoken();
+    uint32_t* lastBuffer = NULL;
+    for (uint32_t i = 0; i < NUM_BUSSES; ++i)
+    {
+        if ((woken & (1U << i)) != 0)
+        {
+            lastBuffer = pool.borrow(numWords, capacity);
+        }
+    }
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(numWords, 257U);
+    // Only the last bus had to wait
+    EXPECT_EQ(buffers[NUM_BUSSES - 1], (uint32_t*)NULL);
+    EXPECT_EQ(wokenBeforeGiveBack, 0U);
+    // It is woken by the first give back rather than waiting to look again on its own
+    EXPECT_EQ(woken, 1U << (NUM_BUSSES - 1));
+    EXPECT_EQ(wokenAgain, 0U);
+    EXPECT_EQ(lastBuffer, buffers[0]);
+}
@@ -0,0 +1,128 @@
+// Compares the word-wide codec against the byte-at-a-time loop it replaced. This file is built with
+// the same optimization level as the firmware so that the numbers mean something.
+
+#include "MapleCodec.hpp"
+
+#include <stdio.h>
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+//! The byte-at-a-time swap and CRC that the codec replaced
+static inline void referenceSwapByteOrder(volatile uint32_t& dest, uint32_t source, uint8_t& crc)
+{
+    const uint8_t* src = reinterpret_cast<uint8_t*>(&source);
+    volatile uint8_t* dst = reinterpret_cast<volatile uint8_t*>(&dest) + 3;
+    for (uint32_t j = 0; j < 4; ++j, ++src, --dst)
+    {
+        *dst = *src;
+        crc ^= *src;
+    }
+}
+
+static void referenceEncode(volatile uint32_t* dest, uint32_t frameWord, const uint32_t* payload, uint32_t len)
+{
+    dest[0] = (len * 4 + 5) * 8;
+    uint8_t crc = 0;
+    referenceSwapByteOrder(dest[1], frameWord, crc);
+    for (uint32_t i = 0; i < len; ++i)
+    {
+        referenceSwapByteOrder(dest[i + 2], *payload++, crc);
+    }
+    dest[len + 2] = crc << 24;
+}
+
+static bool referenceDecode(uint32_t* dest, const volatile uint32_t* src, uint32_t& len)
+{
+    uint32_t numWords = (src[0] >> 24) + 1;
+    uint8_t crc = 0;
+    for (uint32_t i = 0; i < numWords; ++i)
+    {
+        volatile uint32_t word;
+        referenceSwapByteOrder(word, src[i], crc);
+        dest[i] = word;
+    }
+    len = numWords;
+    return (crc == src[numWords] && src[0] != 0);
+}
+
+//! Runs the given function the given number of times and returns the average nanoseconds per call
+template<typename F>
+static double nsPerCall(uint32_t iterations, F f)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; ++i)
+    {
+        f();
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+class MapleCodecBenchmark : public ::testing::TestWithParam<uint32_t>
+{};
+
+TEST_P(MapleCodecBenchmark, encodeAndDecode)
+{
+    static const uint32_t ITERATIONS = 20000;
+    const uint32_t len = GetParam();
+    uint32_t payload[255];
+    for (uint32_t i = 0; i < len; ++i)
+    {
+        payload[i] = i * 0x01010101U + 0x00C0FFEEU;
+    }
+    uint32_t frameWord = 0x0C010000 | len;
+    volatile uint32_t referenceOut[258];
+    volatile uint32_t codecOut[258];
+
+    double referenceEncodeNs = nsPerCall(ITERATIONS, [&]() {
+        referenceEncode(referenceOut, frameWord, payload, len);
+    });
+    double codecEncodeNs = nsPerCall(ITERATIONS, [&]() {
+        MapleCodec::encode(codecOut, frameWord, payload, len);
+    });
+
+    for (uint32_t i = 0; i < len + 3; ++i)
+    {
+        ASSERT_EQ(codecOut[i], referenceOut[i]);
+    }
+
+    // Turn the encoded words into what maple_in would have received
+    volatile uint32_t received[257];
+    for (uint32_t i = 0; i < len + 1; ++i)
+    {
+        received[i] = codecOut[i + 1];
+    }
+    received[len + 1] = codecOut[len + 2] >> 24;
+
+    uint32_t referenceDecoded[256];
+    uint32_t codecDecoded[256];
+    uint32_t referenceLen = 0;
+    uint32_t codecLen = 0;
+    bool referenceValid = false;
+    bool codecValid = false;
+
+    double referenceDecodeNs = nsPerCall(ITERATIONS, [&]() {
+        referenceValid = referenceDecode(referenceDecoded, received, referenceLen);
+    });
+    double codecDecodeNs = nsPerCall(ITERATIONS, [&]() {
+        codecValid = MapleCodec::decode(codecDecoded, received, 257, codecLen);
+    });
+
+    ASSERT_TRUE(referenceValid);
+    ASSERT_TRUE(codecValid);
+    ASSERT_EQ(codecLen, referenceLen);
+    for (uint32_t i = 0; i < codecLen; ++i)
+    {
+        ASSERT_EQ(codecDecoded[i], referenceDecoded[i]);
+    }
+
+    printf("[ BENCH    ] %3u payload words: encode %8.1f ns -> %8.1f ns, decode %8.1f ns -> %8.1f ns\n",
+           len, referenceEncodeNs, codecEncodeNs, referenceDecodeNs, codecDecodeNs);
+}
+
+// Controller poll, controller condition response, LCD write, and largest possible frame
+INSTANTIATE_TEST_CASE_P(
+        MapleCodecBenchmarks,
+        MapleCodecBenchmark,
+        ::testing::Values(1, 3, 50, 255));
@@ -0,0 +1,302 @@
+#include "MapleCodec.hpp"
+#include "MapleEncodedPacket.hpp"
+
+#include <stdlib.h>
+
+#include <gtest/gtest.h>
+
+//! The byte-at-a-time swap and CRC that the codec replaced; used as a reference
+static void referenceSwapByteOrder(volatile uint32_t& dest, uint32_t source, uint8_t& crc)
+{
+    const uint8_t* src = reinterpret_cast<uint8_t*>(&source);
+    volatile uint8_t* dst = reinterpret_cast<volatile uint8_t*>(&dest) + 3;
+    for (uint32_t j = 0; j < 4; ++j, ++src, --dst)
+    {
+        *dst = *src;
+        crc ^= *src;
+    }
+}
+
+class MapleCodecTest : public ::testing::Test
+{
+    protected:
+        virtual void SetUp()
+        {
+            srand(8675309);
+        }
+
+        virtual void TearDown()
+        {}
+};
+
+TEST_F(MapleCodecTest, swapByteOrder)
+{
+    EXPECT_EQ(MapleCodec::swapByteOrder(0x01020304), 0x04030201U);
+    EXPECT_EQ(MapleCodec::swapByteOrder(0xFF000000), 0x000000FFU);
+}
+
+TEST_F(MapleCodecTest, foldCrcMatchesByteXor)
+{
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        uint32_t word = (static_cast<uint32_t>(rand()) << 16) ^ static_cast<uint32_t>(rand());
+        uint8_t expected = (word & 0xFF) ^ (word >> 8 & 0xFF) ^ (word >> 16 & 0xFF) ^ (word >> 24);
+        EXPECT_EQ(MapleCodec::foldCrc(word), expected);
+    }
+}
+
+TEST_F(MapleCodecTest, encodeGetCondition)
+{
+    // --- SETUP ---
+    // GET_CONDITION from host 0x00 to 0x20 with function code 0x00000001
+    uint32_t payload = 0x00000001;
+    volatile uint32_t out[4] = {};
+
+    // --- TEST EXECUTION ---
+    uint32_t numWords = MapleCodec::encode(out, 0x09200001, &payload, 1);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(numWords, 4U);
+    // 1 frame word + 1 payload word + 1 CRC byte
+    EXPECT_EQ(out[0], 72U);
+    EXPECT_EQ(out[1], 0x01002009U);
+    EXPECT_EQ(out[2], 0x01000000U);
+    // 0x09 ^ 0x20 ^ 0x00 ^ 0x01 ^ 0x01
+    EXPECT_EQ(out[3], 0x29000000U);
+}
+
+TEST_F(MapleCodecTest, encodeMatchesReference)
+{
+    for (uint32_t len = 0; len <= 255; len += 17)
+    {
+        uint32_t payload[255];
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            payload[i] = (static_cast<uint32_t>(rand()) << 16) ^ static_cast<uint32_t>(rand());
+        }
+        uint32_t frameWord = 0x0C010000 | len;
+
+        volatile uint32_t expected[258] = {};
+        uint8_t crc = 0;
+        expected[0] = (len * 4 + 5) * 8;
+        referenceSwapByteOrder(expected[1], frameWord, crc);
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            referenceSwapByteOrder(expected[i + 2], payload[i], crc);
+        }
+        expected[len + 2] = crc << 24;
+
+        volatile uint32_t out[258] = {};
+        ASSERT_EQ(MapleCodec::encode(out, frameWord, payload, len), len + 3);
+        for (uint32_t i = 0; i < len + 3; ++i)
+        {
+            EXPECT_EQ(out[i], expected[i]) << "len " << len << " word " << i;
+        }
+    }
+}
+
+TEST_F(MapleCodecTest, decodeValid)
+{
+    // --- SETUP ---
+    // DATA_XFER response from 0x20 with 3 words of payload, as the maple_in state machine sees it
+    uint32_t words[5] = {0x03002008, 0x01000000, 0xFFFF0000, 0x80808080, 0};
+    uint8_t crc = 0;
+    volatile uint32_t scratch;
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        referenceSwapByteOrder(scratch, words[i], crc);
+    }
+    words[4] = crc;
+    uint32_t out[4] = {};
+    uint32_t len = 0;
+
+    // --- TEST EXECUTION ---
+    bool valid = MapleCodec::decode(out, words, 5, len);
+
+    // --- EXPECTATIONS ---
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(len, 4U);
+    EXPECT_EQ(out[0], 0x08200003U);
+    EXPECT_EQ(out[1], 0x00000001U);
+    EXPECT_EQ(out[2], 0x0000FFFFU);
+    EXPECT_EQ(out[3], 0x80808080U);
+}
+
+TEST_F(MapleCodecTest, decodeInPlace)
+{
+    // --- SETUP ---
+    uint32_t payload[2] = {0x00000004, 0x12345678};
+    uint32_t encoded[5] = {};
+    MapleCodec::encode(encoded, 0x07000002, payload, 2);
+    // The received buffer has the same layout as the encoded buffer without the bit count, except
+    // that the CRC byte comes in at the bottom of the last word
+    uint32_t words[4] = {encoded[1], encoded[2], encoded[3], encoded[4] >> 24};
+    uint32_t len = 0;
+
+    // --- TEST EXECUTION ---
+    bool valid = MapleCodec::decode(words, words, 4, len);
+
+    // --- EXPECTATIONS ---
+    EXPECT_TRUE(valid);
+    EXPECT_EQ(len, 3U);
+    EXPECT_EQ(words[0], 0x07000002U);
+    EXPECT_EQ(words[1], 0x00000004U);
+    EXPECT_EQ(words[2], 0x12345678U);
+}
+
+TEST_F(MapleCodecTest, decodeBadCrc)
+{
+    // ACK from 0x20 with no payload; CRC is 0x07 ^ 0x20
+    uint32_t words[2] = {0x00002007, 0x27};
+    uint32_t out[1] = {};
+    uint32_t len = 0;
+    EXPECT_TRUE(MapleCodec::decode(out, words, 2, len));
+    words[1] = 0x28;
+    EXPECT_FALSE(MapleCodec::decode(out, words, 2, len));
+    EXPECT_EQ(len, 0U);
+}
+
+TEST_F(MapleCodecTest, decodeEmpty)
+{
+    uint32_t words[2] = {0, 0};
+    uint32_t out[1] = {};
+    uint32_t len = 0;
+    EXPECT_FALSE(MapleCodec::decode(out, words, 2, len));
+}
+
+TEST_F(MapleCodecTest, decodeLengthOverrun)
+{
+    // Frame word says 255 words follow, but only 3 words were received
+    uint32_t words[3] = {0xFF002008, 0, 0};
+    uint32_t out[3] = {};
+    uint32_t len = 0;
+    EXPECT_FALSE(MapleCodec::decode(out, words, 3, len));
+}
+
+TEST_F(MapleCodecTest, encodeSegmentsMatchesContiguous)
+{
+    // --- SETUP ---
+    uint32_t payload[5] = {0x00000004, 0x00010000, 0x12345678, 0x9ABCDEF0, 0x0F0F0F0F};
+    const MapleCodec::Segment segments[3] = {
+        {&payload[0], 1},
+        {&payload[1], 1},
+        {&payload[2], 3}
+    };
+    uint32_t frameWord = 0x0C010005;
+    uint32_t expected[8] = {};
+    MapleCodec::encode(expected, frameWord, payload, 5);
+
+    uint32_t encoded[8] = {};
+
+    // --- TEST EXECUTION ---
+    EXPECT_EQ(MapleCodec::payloadLen(segments, 3), 5U);
+    uint32_t numWords = MapleCodec::encode(encoded, frameWord, segments, 3);
+
+    // --- EXPECTATIONS ---
+    ASSERT_EQ(numWords, 8U);
+    for (uint32_t i = 0; i < numWords; ++i)
+    {
+        EXPECT_EQ(encoded[i], expected[i]) << "word " << i;
+    }
+}
+
+TEST(MapleEncodedPacketTest, setSegments)
+{
+    // --- SETUP ---
+    uint32_t header[2] = {0x00000004, 0x00000000};
+    uint32_t data[3] = {0x11111111, 0x22222222, 0x33333333};
+    const MapleCodec::Segment segments[2] = {{header, 2}, {data, 3}};
+    uint32_t payload[5] = {header[0], header[1], data[0], data[1], data[2]};
+    MapleEncodedPacketBuffer<5> expected;
+    expected.set(0x0C, 0x01, 0x00, payload, 5);
+    MapleEncodedPacketBuffer<5> packet;
+    MapleEncodedPacketBuffer<4> tooSmall;
+
+    // --- TEST EXECUTION ---
+    packet.set(0x0C, 0x01, 0x00, segments, 2);
+    tooSmall.set(0x0C, 0x01, 0x00, segments, 2);
+
+    // --- EXPECTATIONS ---
+    ASSERT_TRUE(packet.isValid());
+    EXPECT_EQ(packet.getFrameWord(), 0x0C010005U);
+    ASSERT_EQ(packet.getNumWords(), expected.getNumWords());
+    for (uint32_t i = 0; i < packet.getNumWords(); ++i)
+    {
+        EXPECT_EQ(packet.getWords()[i], expected.getWords()[i]);
+    }
+    EXPECT_FALSE(tooSmall.isValid());
+}
+
+TEST(MapleEncodedPacketTest, setMatchesCodec)
+{
+    // --- SETUP ---
+    uint32_t payload = 0x00000001;
+    uint32_t expected[4] = {};
+    MapleCodec::encode(expected, 0x09200001, &payload, 1);
+    MapleEncodedPacketBuffer<1> packet;
+
+    // --- TEST EXECUTION ---
+    packet.set(0x09, 0x20, 0x00, &payload, 1);
+
+    // --- EXPECTATIONS ---
+    ASSERT_TRUE(packet.isValid());
+    EXPECT_EQ(packet.getNumWords(), 4U);
+    EXPECT_EQ(packet.getPayloadLen(), 1U);
+    EXPECT_EQ(packet.getNumBits(), 72U);
+    EXPECT_EQ(packet.getFrameWord(), 0x09200001U);
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(packet.getWords()[i], expected[i]);
+    }
+}
+
+TEST(MapleEncodedPacketTest, payloadTooLong)
+{
+    uint32_t payload[2] = {0, 0};
+    MapleEncodedPacketBuffer<1> packet;
+    packet.set(0x0C, 0x01, 0x00, payload, 2);
+    EXPECT_FALSE(packet.isValid());
+    EXPECT_EQ(packet.getNumWords(), 0U);
+}
+
+TEST(MapleEncodedPacketTest, setFrameWordFixesCrc)
+{
+    // --- SETUP ---
+    uint32_t payload[3] = {0x00000004, 0xDEADBEEF, 0x01234567};
+    MapleEncodedPacketBuffer<3> packet;
+    packet.set(0x0C, 0x01, 0x00, payload, 3);
+    uint32_t expected[6] = {};
+    MapleCodec::encode(expected, 0x0C410003, payload, 3);
+
+    // --- TEST EXECUTION ---
+    packet.setFrameWord(0x0C410003);
+
+    // --- EXPECTATIONS ---
+    for (uint32_t i = 0; i < 6; ++i)
+    {
+        EXPECT_EQ(packet.getWords()[i], expected[i]);
+    }
+}
+
+TEST(MapleEncodedPacketTest, copyWithNewFrameWord)
+{
+    // --- SETUP ---
+    uint32_t payload[2] = {0x00000004, 0xCAFEF00D};
+    MapleEncodedPacketBuffer<2> shared;
+    shared.set(0x0C, 0x01, 0x00, payload, 2);
+    MapleEncodedPacketBuffer<50> perBus;
+    uint32_t expected[5] = {};
+    MapleCodec::encode(expected, 0x0C810002, payload, 2);
+
+    // --- TEST EXECUTION ---
+    perBus.copy(shared, 0x0C810002);
+
+    // --- EXPECTATIONS ---
+    ASSERT_EQ(perBus.getNumWords(), 5U);
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        EXPECT_EQ(perBus.getWords()[i], expected[i]);
+    }
+    // The source is unchanged
+    EXPECT_EQ(shared.getFrameWord(), 0x0C010002U);
+}
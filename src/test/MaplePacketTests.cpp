@@ -0,0 +1,83 @@
+#include "MaplePacket.hpp"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    // Packets known at compile time are built and taken apart at compile time
+    constexpr uint32_t CONDITION_RESPONSE[4] = {
+        MaplePacket::makeFrameWord(0x08, 0x00, 0x20, 3), 0x00000001, 0x0000FFFF, 0x80808080
+    };
+    constexpr MaplePacket CONDITION_PACKET(CONDITION_RESPONSE, 4);
+    static_assert(CONDITION_RESPONSE[0] == 0x08002003, "Frame word fields out of place");
+    static_assert(CONDITION_PACKET.getCommand() == 0x08, "Command not decoded");
+    static_assert(CONDITION_PACKET.getSenderAddr() == 0x20, "Sender not decoded");
+    static_assert(CONDITION_PACKET.getFunctionData(0x08, 0x00000001, 2) == &CONDITION_RESPONSE[2],
+                  "Function data not found");
+    static_assert(MaplePacket::makeBlockAddr(1, 2, 0x0304) == 0x01020304,
+                  "Block address fields out of place");
+}
+
+TEST(MaplePacketTest, decodesFrameWord)
+{
+    // --- SETUP ---
+    uint32_t words[2] = {0x05002001, 0x00000001};
+
+    // --- TEST EXECUTION ---
+    MaplePacket packet(words, 2);
+
+    // --- EXPECTATIONS ---
+    EXPECT_TRUE(packet.isValid());
+    EXPECT_EQ(packet.getFrameWord(), 0x05002001U);
+    EXPECT_EQ(packet.getCommand(), 0x05);
+    EXPECT_EQ(packet.getRecipientAddr(), 0x00);
+    EXPECT_EQ(packet.getSenderAddr(), 0x20);
+    EXPECT_EQ(packet.getPayloadLen(), 1U);
+    EXPECT_EQ(packet.getPayload(), &words[1]);
+    EXPECT_EQ(packet.getFunctionCode(), 0x00000001U);
+}
+
+TEST(MaplePacketTest, payloadBoundedByWordsReceived)
+{
+    // --- SETUP ---
+    // The frame word claims more payload than was received
+    uint32_t words[3] = {0x08002010, 0x00000001, 0x12345678};
+
+    // --- TEST EXECUTION ---
+    MaplePacket packet(words, 3);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(packet.getPayloadLen(), 2U);
+    // A condition needs 2 words after the function code, which weren't all received
+    EXPECT_EQ(packet.getFunctionData(0x08, 0x00000001, 2), (const uint32_t*)NULL);
+    EXPECT_EQ(packet.getFunctionData(0x08, 0x00000001, 1), &words[2]);
+}
+
+TEST(MaplePacketTest, emptyPacket)
+{
+    // --- TEST EXECUTION ---
+    MaplePacket packet(static_cast<const uint32_t*>(NULL), 0);
+
+    // --- EXPECTATIONS ---
+    EXPECT_FALSE(packet.isValid());
+    EXPECT_EQ(packet.getPayloadLen(), 0U);
+    EXPECT_EQ(packet.getFunctionCode(), 0U);
+    EXPECT_EQ(packet.getFunctionData(0x00, 0x00000000, 0), (const uint32_t*)NULL);
+}
+
+TEST(MaplePacketTest, separatedPayload)
+{
+    // --- SETUP ---
+    uint32_t payload[3] = {0x00000001, 0xAAAAAAAA, 0x55555555};
+
+    // --- TEST EXECUTION ---
+    MaplePacket packet(0x08, payload, 3);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(packet.getCommand(), 0x08);
+    EXPECT_EQ(packet.getPayloadLen(), 3U);
+    // Wrong command or function code finds nothing
+    EXPECT_EQ(packet.getFunctionData(0x05, 0x00000001, 2), (const uint32_t*)NULL);
+    EXPECT_EQ(packet.getFunctionData(0x08, 0x00000004, 2), (const uint32_t*)NULL);
+    EXPECT_EQ(packet.getFunctionData(0x08, 0x00000001, 2), &payload[1]);
+}
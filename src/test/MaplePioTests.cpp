@@ -0,0 +1,430 @@
+// Runs the firmware's maple.pio programs, as assembled from source, on the PIO emulator. This checks
+// the waveform maple_out puts on the bus against an independent decoder, the time a write takes
+// against the write timeout, and maple_in's ability to receive what maple_out sends.
+
+#include "PioAssembler.hpp"
+#include "PioEmulator.hpp"
+#include "MapleCodec.hpp"
+#include "MapleTiming.hpp"
+#include "configuration.h"
+
+#include <stdio.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    //! Pin A of the bus under test (B is the next pin)
+    const uint32_t PIN_A = 10;
+    const uint32_t PIN_B = PIN_A + 1;
+
+    //! Encodes a frame with the given payload length filled with a recognizable pattern
+    std::vector<uint32_t> encodeFrame(uint32_t payloadLen)
+    {
+        std::vector<uint32_t> payload(payloadLen);
+        for (uint32_t i = 0; i < payloadLen; ++i)
+        {
+            payload[i] = (0x01234567 * (i + 1)) ^ 0xA5C3F00F;
+        }
+        // Command in the most significant byte, payload length in the least significant byte
+        const uint32_t frameWord = 0x0C200100 | payloadLen;
+        std::vector<uint32_t> encoded(MapleCodec::numEncodedWords(payloadLen));
+        MapleCodec::encode(&encoded[0], frameWord, payload.data(), payloadLen);
+        return encoded;
+    }
+
+    //! maple_out configured the way MapleOutStateMachine configures it
+    PioSmConfig mapleOutConfig(uint32_t clkDiv256)
+    {
+        PioSmConfig config;
+        config.clkDiv256 = clkDiv256;
+        config.sideSetBase = PIN_A;
+        config.setBase = PIN_A;
+        config.setCount = 2;
+        config.outShiftRight = false;
+        config.autoPull = true;
+        config.pullThreshold = 32;
+        return config;
+    }
+
+    //! maple_in configured the way MapleInStateMachine configures it
+    PioSmConfig mapleInConfig()
+    {
+        PioSmConfig config;
+        config.clkDiv256 = 256;
+        config.inBase = PIN_A;
+        config.jmpPin = PIN_A;
+        config.outShiftRight = true;
+        config.autoPull = false;
+        config.inShiftRight = false;
+        config.autoPush = true;
+        config.pushThreshold = 32;
+        // maple_in only ever samples the pins
+        config.connectedToPins = false;
+        return config;
+    }
+
+    //! Decodes the bus waveform one system cycle at a time, independently of maple_in: after the
+    //! start sequence (A LOW while B pulses, then A HIGH), A and B take turns as the clock; B is
+    //! sampled as A falls, then A is sampled as B falls, and so on
+    class WaveformDecoder
+    {
+        public:
+            WaveformDecoder() :
+                mLastA(true),
+                mLastB(true),
+                mSawALow(false),
+                mInData(false),
+                mClockIsB(false),
+                mBits(),
+                mFirstSampleCycle(0),
+                mLastSampleCycle(0)
+            {}
+
+            void sample(uint32_t levels, uint64_t cycle)
+            {
+                const bool a = ((levels >> PIN_A) & 1) != 0;
+                const bool b = ((levels >> PIN_B) & 1) != 0;
+                if (!mInData)
+                {
+                    if (!a)
+                    {
+                        mSawALow = true;
+                    }
+                    else if (mSawALow && !mLastA)
+                    {
+                        mInData = true;
+                    }
+                }
+                else if (!mClockIsB && mLastA && !a)
+                {
+                    addBit(b, cycle);
+                    mClockIsB = true;
+                }
+                else if (mClockIsB && mLastB && !b)
+                {
+                    addBit(a, cycle);
+                    mClockIsB = false;
+                }
+                mLastA = a;
+                mLastB = b;
+            }
+
+            //! @returns the bits decoded so far, packed most significant bit first
+            std::vector<uint32_t> getWords(uint32_t numBits) const
+            {
+                std::vector<uint32_t> words((numBits + 31) / 32, 0);
+                for (uint32_t i = 0; i < numBits && i < mBits.size(); ++i)
+                {
+                    words[i / 32] |= static_cast<uint32_t>(mBits[i]) << (31 - (i % 32));
+                }
+                return words;
+            }
+
+            uint32_t getNumBits() const { return mBits.size(); }
+
+            //! @returns the average time between bit samples in nanoseconds
+            double getNsPerBit() const
+            {
+                if (mBits.size() < 2)
+                {
+                    return 0;
+                }
+                const double cycles = static_cast<double>(mLastSampleCycle - mFirstSampleCycle);
+                return cycles / (mBits.size() - 1) * 1000000.0 / CPU_FREQ_KHZ;
+            }
+
+        private:
+            void addBit(bool bit, uint64_t cycle)
+            {
+                if (mBits.empty())
+                {
+                    mFirstSampleCycle = cycle;
+                }
+                mLastSampleCycle = cycle;
+                mBits.push_back(bit ? 1 : 0);
+            }
+
+            bool mLastA;
+            bool mLastB;
+            bool mSawALow;
+            bool mInData;
+            bool mClockIsB;
+            std::vector<uint8_t> mBits;
+            uint64_t mFirstSampleCycle;
+            uint64_t mLastSampleCycle;
+    };
+
+    //! Result of running one write
+    struct WriteResult
+    {
+        //! True iff maple_out reached its end of write IRQ
+        bool completed;
+        //! System cycles from enabling maple_out to its end of write IRQ
+        uint64_t cycles;
+        //! True iff maple_in signaled a start sequence
+        bool readStarted;
+        //! True iff maple_in signaled the end of the packet
+        bool readCompleted;
+        //! Words pushed by maple_in
+        std::vector<uint32_t> received;
+    };
+}
+
+class MaplePioTest : public ::testing::Test
+{
+    public:
+        MaplePioTest() :
+            mAssembler(),
+            mAssembled(mAssembler.assembleFile(MAPLE_PIO_PATH)),
+            mMapleOut(mAssembler.getProgram("maple_out")),
+            mMapleIn(mAssembler.getProgram("maple_in")),
+            mGpio()
+        {}
+
+    protected:
+        //! Writes the given encoded frame through maple_out with maple_in listening, feeding
+        //! maple_out's TX FIFO and draining maple_in's RX FIFO as the DMA would
+        //! @param[in] encoded  The encoded frame
+        //! @param[in] outClkDiv256  maple_out's clock divider
+        //! @param[in] decoder  Waveform decoder to feed (may be NULL)
+        WriteResult runWrite(const std::vector<uint32_t>& encoded,
+                             uint32_t outClkDiv256,
+                             WaveformDecoder* decoder)
+        {
+            WriteResult result = {false, 0, false, false, std::vector<uint32_t>()};
+            PioStateMachine out(*mMapleOut, mapleOutConfig(outClkDiv256), mGpio, 0);
+            PioStateMachine in(*mMapleIn, mapleInConfig(), mGpio, 0);
+            in.restart();
+            in.setEnabled(true);
+            out.restart();
+            out.setEnabled(true);
+
+            // Generous upper bound on the number of cycles a write may take
+            const uint64_t maxCycles =
+                (static_cast<uint64_t>(encoded.size()) * 32 + 64) * outClkDiv256 / 256 * 8;
+            uint32_t next = 0;
+            uint64_t cycle = 0;
+            for (; cycle < maxCycles && !(result.completed && result.readCompleted); ++cycle)
+            {
+                while (next < encoded.size() && out.putTx(encoded[next]))
+                {
+                    ++next;
+                }
+                mGpio.clock();
+                out.clock();
+                in.clock();
+                if (decoder != NULL)
+                {
+                    decoder->sample(mGpio.getLevels(), cycle);
+                }
+                uint32_t word = 0;
+                while (in.getRx(word))
+                {
+                    result.received.push_back(word);
+                }
+                if (!result.completed && out.isIrqSet(0))
+                {
+                    result.completed = true;
+                    result.cycles = cycle + 1;
+                    // As MapleOutStateMachine::stop() does
+                    out.setEnabled(false);
+                    out.exec(0xE003); // set pins, MASK_AB
+                    out.exec(0xE080); // set pindirs, 0
+                    out.clearIrq(0);
+                }
+                if (in.isIrqSet(0))
+                {
+                    if (!result.readStarted)
+                    {
+                        result.readStarted = true;
+                        in.clearIrq(0);
+                    }
+                    else
+                    {
+                        result.readCompleted = true;
+                    }
+                }
+            }
+            EXPECT_FALSE(out.hasFaulted());
+            EXPECT_FALSE(in.hasFaulted());
+            return result;
+        }
+
+        //! @returns true iff maple_in received exactly what was encoded
+        static bool receivedMatches(const WriteResult& result, const std::vector<uint32_t>& encoded)
+        {
+            // Everything but the bit count word and the CRC word is received as it was encoded
+            const uint32_t numWords = encoded.size() - 2;
+            std::vector<uint32_t> decoded(result.received.size() + 1);
+            uint32_t len = 0;
+            bool rv = (result.readCompleted
+                       && result.received.size() == numWords + 1
+                       && MapleCodec::decode(&decoded[0],
+                                             result.received.data(),
+                                             result.received.size(),
+                                             len)
+                       && len == numWords);
+            for (uint32_t i = 0; rv && i < len; ++i)
+            {
+                rv = (decoded[i] == MapleCodec::swapByteOrder(encoded[i + 1]));
+            }
+            return rv;
+        }
+
+        PioAssembler mAssembler;
+        bool mAssembled;
+        const PioProgram* mMapleOut;
+        const PioProgram* mMapleIn;
+        PioGpio mGpio;
+};
+
+TEST_F(MaplePioTest, programsAssemble)
+{
+    // --- EXPECTATIONS ---
+    ASSERT_TRUE(mAssembled) << mAssembler.getError();
+    ASSERT_NE(mMapleOut, (const PioProgram*)NULL);
+    ASSERT_NE(mMapleIn, (const PioProgram*)NULL);
+    // Both programs must fit in their PIO block's instruction memory
+    EXPECT_LE(mMapleOut->instructions.size(), 32U);
+    EXPECT_LE(mMapleIn->instructions.size(), 32U);
+    EXPECT_EQ(mMapleOut->defines.at("DOUBLE_PHASE_TICKS"), 4);
+    EXPECT_EQ(mMapleOut->defines.at("MASK_AB"), 3);
+    // "out x, 32 side MASK_AB" with optional 2 bit side-set
+    EXPECT_EQ(mMapleOut->instructions[0], 0x7C20);
+    // "mov y, ~null"
+    EXPECT_EQ(mMapleIn->instructions[0], 0xA04B);
+}
+
+TEST_F(MaplePioTest, mapleOutWaveformDecodes)
+{
+    // --- SETUP ---
+    ASSERT_TRUE(mAssembled) << mAssembler.getError();
+    const std::vector<uint32_t> encoded = encodeFrame(4);
+    WaveformDecoder decoder;
+
+    // --- TEST EXECUTION ---
+    WriteResult result = runWrite(
+        encoded,
+        MapleBusTiming::outClkDiv256(mMapleOut->defines.at("DOUBLE_PHASE_TICKS")),
+        &decoder);
+
+    // --- EXPECTATIONS ---
+    ASSERT_TRUE(result.completed);
+    const uint32_t numBits = encoded[0];
+    ASSERT_GE(decoder.getNumBits(), numBits);
+    const std::vector<uint32_t> words = decoder.getWords(numBits);
+    for (uint32_t i = 0; i < words.size(); ++i)
+    {
+        EXPECT_EQ(words[i], encoded[i + 1]) << "word " << i;
+    }
+    // Within 5% of the nominal bit period (a few bits take an extra PIO tick)
+    EXPECT_NEAR(decoder.getNsPerBit(), MAPLE_NS_PER_BIT, MAPLE_NS_PER_BIT * 0.05);
+    EXPECT_EQ(mGpio.getNumConflicts(), 0U);
+    // The line is released once the write is stopped
+    EXPECT_EQ((mGpio.getLevels() >> PIN_A) & 3, 3U);
+}
+
+TEST_F(MaplePioTest, lineReleasedAfterStop)
+{
+    // --- SETUP ---
+    ASSERT_TRUE(mAssembled) << mAssembler.getError();
+    WriteResult result = runWrite(
+        encodeFrame(1),
+        MapleBusTiming::outClkDiv256(mMapleOut->defines.at("DOUBLE_PHASE_TICKS")),
+        NULL);
+    ASSERT_TRUE(result.completed);
+    ASSERT_EQ(mGpio.getNumConflicts(), 0U);
+
+    // --- TEST EXECUTION ---
+    // The peripheral drives the line to respond, which it may only do if maple_out let go of it
+    mGpio.setExternal(PIN_A, true, false);
+    mGpio.setExternal(PIN_B, true, false);
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        mGpio.clock();
+    }
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ((mGpio.getLevels() >> PIN_A) & 3, 0U);
+    EXPECT_EQ(mGpio.getNumConflicts(), 0U);
+}
+
+TEST_F(MaplePioTest, writesCompleteWithinWriteTimeout)
+{
+    // --- SETUP ---
+    ASSERT_TRUE(mAssembled) << mAssembler.getError();
+    const uint32_t clkDiv256 =
+        MapleBusTiming::outClkDiv256(mMapleOut->defines.at("DOUBLE_PHASE_TICKS"));
+    const uint32_t lengths[] = {0, 1, 16, 255};
+
+    for (uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i)
+    {
+        // --- TEST EXECUTION ---
+        WriteResult result = runWrite(encodeFrame(lengths[i]), clkDiv256, NULL);
+
+        // --- EXPECTATIONS ---
+        ASSERT_TRUE(result.completed) << "payload length " << lengths[i];
+        const uint64_t writeUs = result.cycles * 1000 / CPU_FREQ_KHZ;
+        EXPECT_LT(writeUs, MapleBusTiming::WRITE_TIMEOUT_US[lengths[i]])
+            << "payload length " << lengths[i];
+    }
+}
+
+TEST_F(MaplePioTest, mapleInReceivesMapleOut)
+{
+    // --- SETUP ---
+    ASSERT_TRUE(mAssembled) << mAssembler.getError();
+    const uint32_t clkDiv256 =
+        MapleBusTiming::outClkDiv256(mMapleOut->defines.at("DOUBLE_PHASE_TICKS"));
+    const uint32_t lengths[] = {0, 1, 2, 7, 32};
+
+    for (uint32_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i)
+    {
+        const std::vector<uint32_t> encoded = encodeFrame(lengths[i]);
+
+        // --- TEST EXECUTION ---
+        WriteResult result = runWrite(encoded, clkDiv256, NULL);
+
+        // --- EXPECTATIONS ---
+        EXPECT_TRUE(result.readStarted) << "payload length " << lengths[i];
+        EXPECT_TRUE(receivedMatches(result, encoded)) << "payload length " << lengths[i];
+    }
+}
+
+TEST_F(MaplePioTest, mapleInRateMarginBenchmark)
+{
+    // --- SETUP ---
+    ASSERT_TRUE(mAssembled) << mAssembler.getError();
+    const uint32_t nominalClkDiv256 =
+        MapleBusTiming::outClkDiv256(mMapleOut->defines.at("DOUBLE_PHASE_TICKS"));
+    const std::vector<uint32_t> encoded = encodeFrame(2);
+
+    // --- TEST EXECUTION ---
+    // Speed the sender up until maple_in can no longer keep up
+    uint32_t fastestClkDiv256 = 0;
+    double fastestNsPerBit = 0;
+    for (uint32_t clkDiv256 = nominalClkDiv256; clkDiv256 >= 256; clkDiv256 -= 64)
+    {
+        WaveformDecoder decoder;
+        WriteResult result = runWrite(encoded, clkDiv256, &decoder);
+        if (!receivedMatches(result, encoded))
+        {
+            break;
+        }
+        fastestClkDiv256 = clkDiv256;
+        fastestNsPerBit = decoder.getNsPerBit();
+    }
+
+    // --- EXPECTATIONS ---
+    ASSERT_NE(fastestClkDiv256, 0U);
+    printf("[ BENCH    ] maple_in decodes maple_out down to %.1f ns per bit (clkdiv %u/256), "
+           "%.1fx the nominal %u ns rate\n",
+           fastestNsPerBit,
+           fastestClkDiv256,
+           MAPLE_NS_PER_BIT / fastestNsPerBit,
+           MAPLE_NS_PER_BIT);
+    // maple_in must have headroom over the nominal rate, since peripherals don't all keep time
+    EXPECT_LT(fastestNsPerBit, MAPLE_NS_PER_BIT * 0.75);
+}
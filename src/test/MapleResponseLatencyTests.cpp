@@ -0,0 +1,108 @@
+#include "MapleResponseLatency.hpp"
+#include "MapleBusInterface.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(MapleResponseLatencyTest, usesMaximumUntilLearned)
+{
+    // --- SETUP ---
+    MapleResponseLatency latency;
+
+    // --- TEST EXECUTION / EXPECTATIONS ---
+    for (uint32_t i = 0; i < MapleResponseLatency::MIN_SAMPLES - 1; ++i)
+    {
+        latency.responded(0x20, 50);
+        EXPECT_EQ(latency.getTimeoutUs(0x20), (uint32_t)MAPLE_RESPONSE_TIMEOUT_US);
+    }
+    latency.responded(0x20, 50);
+    EXPECT_LT(latency.getTimeoutUs(0x20), (uint32_t)MAPLE_RESPONSE_TIMEOUT_US);
+}
+
+TEST(MapleResponseLatencyTest, tightensToSteadyLatency)
+{
+    // --- SETUP ---
+    MapleResponseLatency latency;
+
+    // --- TEST EXECUTION ---
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        latency.responded(0x20, 60);
+    }
+
+    // --- EXPECTATIONS ---
+    // Deviation decays away (to the few microseconds integer math leaves), leaving the mean plus
+    // margin
+    EXPECT_GE(latency.getTimeoutUs(0x20), 60U + MAPLE_RESPONSE_TIMEOUT_MARGIN_US);
+    EXPECT_LE(latency.getTimeoutUs(0x20), 63U + MAPLE_RESPONSE_TIMEOUT_MARGIN_US);
+}
+
+TEST(MapleResponseLatencyTest, jitterWidensTimeout)
+{
+    // --- SETUP ---
+    MapleResponseLatency latency;
+
+    // --- TEST EXECUTION ---
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        latency.responded(0x20, (i % 2 == 0) ? 40 : 80);
+    }
+
+    // --- EXPECTATIONS ---
+    // Mean of 60 with a deviation of 20 is covered by 4 deviations
+    uint32_t timeoutUs = latency.getTimeoutUs(0x20);
+    EXPECT_GE(timeoutUs, 80U + MAPLE_RESPONSE_TIMEOUT_MARGIN_US);
+    EXPECT_LE(timeoutUs, 160U + MAPLE_RESPONSE_TIMEOUT_MARGIN_US);
+}
+
+TEST(MapleResponseLatencyTest, peripheralsAreTrackedSeparately)
+{
+    // --- SETUP ---
+    MapleResponseLatency latency;
+
+    // --- TEST EXECUTION ---
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        // Player bits are ignored
+        latency.responded(0x60, 60);
+        latency.responded(0x01, 200);
+    }
+
+    // --- EXPECTATIONS ---
+    EXPECT_LE(latency.getTimeoutUs(0x20), 63U + MAPLE_RESPONSE_TIMEOUT_MARGIN_US);
+    EXPECT_GE(latency.getTimeoutUs(0x41), 200U + MAPLE_RESPONSE_TIMEOUT_MARGIN_US);
+    EXPECT_LE(latency.getTimeoutUs(0x41), 203U + MAPLE_RESPONSE_TIMEOUT_MARGIN_US);
+    EXPECT_EQ(latency.getTimeoutUs(0x02), (uint32_t)MAPLE_RESPONSE_TIMEOUT_US);
+}
+
+TEST(MapleResponseLatencyTest, timeoutBacksOffUntilResponse)
+{
+    // --- SETUP ---
+    MapleResponseLatency latency;
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        latency.responded(0x20, 60);
+    }
+    uint32_t learnedUs = latency.getTimeoutUs(0x20);
+
+    // --- TEST EXECUTION / EXPECTATIONS ---
+    latency.timedOut(0x20);
+    EXPECT_EQ(latency.getTimeoutUs(0x20), learnedUs * 2);
+    latency.timedOut(0x20);
+    latency.timedOut(0x20);
+    latency.timedOut(0x20);
+    EXPECT_EQ(latency.getTimeoutUs(0x20), (uint32_t)MAPLE_RESPONSE_TIMEOUT_US);
+
+    latency.responded(0x20, 60);
+    EXPECT_EQ(latency.getTimeoutUs(0x20), learnedUs);
+}
+
+TEST(MapleResponseLatencyTest, readTimeoutScalesWithResponseLength)
+{
+    // --- TEST EXECUTION / EXPECTATIONS ---
+    // A condition response is much shorter than the worst case read
+    uint32_t conditionUs = MapleBusInterface::readTimeoutUs(3);
+    EXPECT_GT(conditionUs, (MapleCodec::numBits(3) * MAPLE_NS_PER_BIT) / 1000);
+    EXPECT_LT(conditionUs, 200U);
+    EXPECT_LT(MapleBusInterface::readTimeoutUs(28), 1000U);
+    EXPECT_GT(MapleBusInterface::readTimeoutUs(255), (uint32_t)DEFAULT_MAPLE_READ_TIMEOUT_US);
+}
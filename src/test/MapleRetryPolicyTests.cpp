@@ -0,0 +1,125 @@
+#include "MapleRetryPolicy.hpp"
+#include "configuration.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    //! Outcome of one transaction as MapleBus::finishRead() would report it
+    struct Outcome
+    {
+        //! Number of times the transaction was sent again
+        uint32_t numRetries;
+        //! The final action taken (ACTION_ACCEPT or ACTION_FAIL)
+        MapleRetryPolicy::Action action;
+    };
+
+    //! Runs a transaction whose every response is the same, the way MapleBus::finishRead() does
+    //! @param[in] policy  The policy under test
+    //! @param[in] valid  true iff each response passes CRC
+    //! @param[in] command  The command of each response
+    //! @param[in] lineOpen  true iff the line is open whenever a retry is started
+    Outcome runTransaction(MapleRetryPolicy& policy, bool valid, uint8_t command, bool lineOpen)
+    {
+        Outcome outcome = {0, MapleRetryPolicy::ACTION_RETRY};
+        policy.start();
+        // Bounded in case the policy never gives up
+        for (uint32_t i = 0; i < 100 && outcome.action == MapleRetryPolicy::ACTION_RETRY; ++i)
+        {
+            outcome.action = policy.onResponse(valid, command);
+            if (outcome.action == MapleRetryPolicy::ACTION_RETRY)
+            {
+                outcome.action = policy.retryStarted(lineOpen);
+                if (outcome.action == MapleRetryPolicy::ACTION_RETRY)
+                {
+                    ++outcome.numRetries;
+                }
+            }
+        }
+        return outcome;
+    }
+}
+
+TEST(MapleRetryPolicyTest, crcFailureIsRetriedUpToMaxThenFails)
+{
+    // --- SETUP ---
+    MapleRetryPolicy policy;
+
+    // --- TEST EXECUTION ---
+    Outcome outcome = runTransaction(policy, false, 0, true);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(outcome.numRetries, static_cast<uint32_t>(MAPLE_TRANSACTION_MAX_RETRIES));
+    // Reported to the observer as STATUS_CRC_ERROR
+    EXPECT_EQ(outcome.action, MapleRetryPolicy::ACTION_FAIL);
+    EXPECT_EQ(policy.getStats().numCrcRetries,
+              static_cast<uint32_t>(MAPLE_TRANSACTION_MAX_RETRIES));
+    EXPECT_EQ(policy.getStats().numResendRetries, 0U);
+    EXPECT_EQ(policy.getStats().numRetriesFailed, 1U);
+}
+
+TEST(MapleRetryPolicyTest, resendRequestIsRetriedUpToMaxThenAccepted)
+{
+    // --- SETUP ---
+    MapleRetryPolicy policy;
+
+    // --- TEST EXECUTION ---
+    Outcome outcome = runTransaction(policy, true, MapleRetryPolicy::REQUEST_RESEND_COMMAND, true);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(outcome.numRetries, static_cast<uint32_t>(MAPLE_TRANSACTION_MAX_RETRIES));
+    // The resend request is still a valid response, so it goes to the observer
+    EXPECT_EQ(outcome.action, MapleRetryPolicy::ACTION_ACCEPT);
+    EXPECT_EQ(policy.getStats().numResendRetries,
+              static_cast<uint32_t>(MAPLE_TRANSACTION_MAX_RETRIES));
+    EXPECT_EQ(policy.getStats().numCrcRetries, 0U);
+    EXPECT_EQ(policy.getStats().numRetriesFailed, 1U);
+}
+
+TEST(MapleRetryPolicyTest, validResponseIsAcceptedWithoutRetry)
+{
+    // --- SETUP ---
+    MapleRetryPolicy policy;
+
+    // --- TEST EXECUTION ---
+    Outcome outcome = runTransaction(policy, true, 0x08, true);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(outcome.numRetries, 0U);
+    EXPECT_EQ(outcome.action, MapleRetryPolicy::ACTION_ACCEPT);
+    EXPECT_EQ(policy.getStats().numCrcRetries, 0U);
+    EXPECT_EQ(policy.getStats().numResendRetries, 0U);
+    EXPECT_EQ(policy.getStats().numRetriesFailed, 0U);
+}
+
+TEST(MapleRetryPolicyTest, retryOnClosedLineFailsRightAway)
+{
+    // --- SETUP ---
+    MapleRetryPolicy policy;
+
+    // --- TEST EXECUTION ---
+    Outcome outcome = runTransaction(policy, false, 0, false);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(outcome.numRetries, 0U);
+    EXPECT_EQ(outcome.action, MapleRetryPolicy::ACTION_FAIL);
+    EXPECT_EQ(policy.getStats().numCrcRetries, 0U);
+    EXPECT_EQ(policy.getStats().numRetriesFailed, 1U);
+}
+
+TEST(MapleRetryPolicyTest, retriesAreRestoredForEachTransaction)
+{
+    // --- SETUP ---
+    MapleRetryPolicy policy;
+
+    // --- TEST EXECUTION ---
+    Outcome first = runTransaction(policy, false, 0, true);
+    Outcome second = runTransaction(policy, false, 0, true);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(first.numRetries, static_cast<uint32_t>(MAPLE_TRANSACTION_MAX_RETRIES));
+    EXPECT_EQ(second.numRetries, static_cast<uint32_t>(MAPLE_TRANSACTION_MAX_RETRIES));
+    EXPECT_EQ(policy.getStats().numCrcRetries,
+              2 * static_cast<uint32_t>(MAPLE_TRANSACTION_MAX_RETRIES));
+    EXPECT_EQ(policy.getStats().numRetriesFailed, 2U);
+}
@@ -0,0 +1,93 @@
+#include "MapleTiming.hpp"
+#include "MapleCodec.hpp"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    //! The write timeout as MapleBus used to compute it, in double precision
+    uint64_t doubleWriteTimeoutUs(uint32_t nsPerBit, uint32_t payloadLen)
+    {
+        uint32_t numBits = MapleCodec::numBits(payloadLen);
+        uint32_t totalWriteTimeNs = numBits * nsPerBit;
+        totalWriteTimeNs += 14 * nsPerBit;
+        totalWriteTimeNs *= (1 + (MAPLE_WRITE_TIMEOUT_EXTRA_PERCENT / 100.0));
+        // Relative to a start time of 0
+        return static_cast<uint64_t>(0 + (totalWriteTimeNs / 1000.0 + 0.5) + 1);
+    }
+
+    //! The maple_out clock divider as it used to be computed, converted to 8 fractional bits the
+    //! way the SDK does
+    uint32_t floatClkDiv256(uint32_t cpuKhz, uint32_t nsPerBit, uint32_t doublePhaseTicks)
+    {
+        float div = (cpuKhz * (nsPerBit / 3 * 2)) / doublePhaseTicks / 1000000.0;
+        uint32_t divInt = static_cast<uint32_t>(div);
+        uint32_t divFrac = static_cast<uint32_t>((div - divInt) * 256);
+        return (divInt << 8) | divFrac;
+    }
+
+    //! Checks every table entry of a timing model against the original formulas
+    template <uint32_t CPU_KHZ, uint32_t NS_PER_BIT>
+    void checkModel()
+    {
+        typedef MapleTiming<CPU_KHZ, NS_PER_BIT> Timing;
+        for (uint32_t len = 0; len < Timing::NUM_LENGTHS; ++len)
+        {
+            EXPECT_EQ(Timing::WRITE_TIMEOUT_US[len], doubleWriteTimeoutUs(NS_PER_BIT, len))
+                << "payload length " << len;
+            EXPECT_EQ(Timing::WRITE_TIMEOUT_US[len], Timing::writeTimeoutUs(len));
+            EXPECT_EQ(Timing::READ_TIMEOUT_US[len], Timing::readTimeoutUs(len));
+        }
+        EXPECT_EQ(Timing::outClkDiv256(4), floatClkDiv256(CPU_KHZ, NS_PER_BIT, 4));
+    }
+}
+
+TEST(MapleTimingTest, configuredModelMatchesOriginalFormulas)
+{
+    checkModel<CPU_FREQ_KHZ, MAPLE_NS_PER_BIT>();
+}
+
+TEST(MapleTimingTest, otherClocksMatchOriginalFormulas)
+{
+    checkModel<125000, 480>();
+    checkModel<133000, 510>();
+    checkModel<200000, 300>();
+}
+
+TEST(MapleTimingTest, readTimeoutMatchesOriginalFormula)
+{
+    for (uint32_t len = 0; len < MapleBusTiming::NUM_LENGTHS; ++len)
+    {
+        // As MapleBusInterface::readTimeoutUs() used to compute it
+        uint32_t bits = MapleCodec::numBits(len) + 16;
+        uint32_t timeNs = bits * MAPLE_NS_PER_BIT * (100 + MAPLE_READ_TIMEOUT_EXTRA_PERCENT) / 100;
+        EXPECT_EQ(MapleBusTiming::READ_TIMEOUT_US[len], ((timeNs + 999) / 1000) + 1);
+    }
+}
+
+TEST(MapleTimingTest, readTimeoutLooksBackUpToLength)
+{
+    for (uint32_t len = 0; len < MapleBusTiming::NUM_LENGTHS; ++len)
+    {
+        uint32_t timeoutUs = MapleBusTiming::READ_TIMEOUT_US[len];
+        EXPECT_EQ(MapleBusTiming::READ_TIMEOUT_US.lengthWithin(timeoutUs), len);
+        if (len > 0)
+        {
+            // Just short of a length's timeout only fits the length before it
+            EXPECT_EQ(MapleBusTiming::READ_TIMEOUT_US.lengthWithin(timeoutUs - 1), len - 1);
+        }
+    }
+    EXPECT_EQ(MapleBusTiming::READ_TIMEOUT_US.lengthWithin(0), 0U);
+    // Anything longer than the longest packet's timeout fits the longest packet
+    EXPECT_EQ(MapleBusTiming::READ_TIMEOUT_US.lengthWithin(
+                  MapleBusTiming::READ_TIMEOUT_US[MapleBusTiming::NUM_LENGTHS - 1] + 1000),
+              MapleBusTiming::NUM_LENGTHS - 1);
+}
+
+TEST(MapleTimingTest, evaluatedAtCompileTime)
+{
+    // These only compile if the model is a constant expression
+    static_assert(MapleBusTiming::writeTimeoutUs(3) > 0, "");
+    static_assert(MapleBusTiming::outClkDiv256(4) > 256, "");
+    static_assert(MapleBusTiming::WRITE_TIMEOUT_US.us[0] == MapleBusTiming::writeTimeoutUs(0), "");
+}
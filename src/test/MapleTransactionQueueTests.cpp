@@ -0,0 +1,160 @@
+#include "MapleTransactionQueue.hpp"
+
+#include <gtest/gtest.h>
+
+class MapleTransactionQueueTest : public ::testing::Test
+{
+    protected:
+        //! Observers only used for their addresses
+        MapleTransactionObserver* observer(uintptr_t id)
+        {
+            return reinterpret_cast<MapleTransactionObserver*>(id);
+        }
+
+        MapleTransaction transaction(uintptr_t id)
+        {
+            MapleTransaction t = {NULL,
+                                  true,
+                                  static_cast<uint32_t>(id),
+                                  observer(id),
+                                  MapleTransaction::TRAFFIC_BULK};
+            return t;
+        }
+};
+
+TEST_F(MapleTransactionQueueTest, fifoOrderAcrossWrap)
+{
+    // --- SETUP ---
+    MapleTransactionQueue<3> queue;
+    MapleTransaction t;
+
+    // --- TEST EXECUTION ---
+    EXPECT_TRUE(queue.push(transaction(1)));
+    EXPECT_TRUE(queue.push(transaction(2)));
+    EXPECT_TRUE(queue.pop(t));
+    EXPECT_EQ(t.readTimeoutUs, 1U);
+    EXPECT_TRUE(queue.push(transaction(3)));
+    EXPECT_TRUE(queue.push(transaction(4)));
+
+    // --- EXPECTATIONS ---
+    EXPECT_TRUE(queue.isFull());
+    EXPECT_FALSE(queue.push(transaction(5)));
+    for (uint32_t expected = 2; expected <= 4; ++expected)
+    {
+        ASSERT_TRUE(queue.pop(t));
+        EXPECT_EQ(t.readTimeoutUs, expected);
+    }
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_FALSE(queue.pop(t));
+}
+
+TEST_F(MapleTransactionQueueTest, removeObserverKeepsOrder)
+{
+    // --- SETUP ---
+    MapleTransactionQueue<4> queue;
+    MapleTransaction t;
+    // Rotate the head so that removal crosses the end of the buffer
+    queue.push(transaction(9));
+    queue.push(transaction(9));
+    queue.pop(t);
+    queue.pop(t);
+    queue.push(transaction(1));
+    queue.push(transaction(2));
+    queue.push(transaction(1));
+    queue.push(transaction(3));
+
+    // --- TEST EXECUTION ---
+    uint32_t numRemoved = queue.remove(observer(1));
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(numRemoved, 2U);
+    ASSERT_EQ(queue.size(), 2U);
+    ASSERT_TRUE(queue.pop(t));
+    EXPECT_EQ(t.observer, observer(2));
+    ASSERT_TRUE(queue.pop(t));
+    EXPECT_EQ(t.observer, observer(3));
+}
+
+class MapleTransactionArbitrationTest : public MapleTransactionQueueTest
+{
+    protected:
+        MapleTransactionArbitrationTest()
+        {
+            // One packet per sub peripheral address, plus the main peripheral
+            for (uint32_t i = 0; i < 6; ++i)
+            {
+                uint8_t addr = (i == 5) ? 0x20 : (1 << i);
+                mPackets[i].set(0x01, addr, 0x00, static_cast<const uint32_t*>(NULL), 0);
+            }
+        }
+
+        //! @param[in] id  Observer and read timeout of the transaction, to identify it
+        //! @param[in] packetIdx  Which packet (recipient) to send
+        //! @param[in] trafficClass  Traffic class of the transaction
+        MapleTransaction transaction(uintptr_t id,
+                                     uint32_t packetIdx,
+                                     MapleTransaction::TrafficClass trafficClass)
+        {
+            MapleTransaction t = {&mPackets[packetIdx],
+                                  true,
+                                  static_cast<uint32_t>(id),
+                                  observer(id),
+                                  trafficClass};
+            return t;
+        }
+
+        MapleEncodedPacketBuffer<0> mPackets[6];
+};
+
+TEST_F(MapleTransactionArbitrationTest, latencyCriticalGoesFirst)
+{
+    // --- SETUP ---
+    MapleTransactionQueue<4> queue;
+    MapleTransaction t;
+    queue.push(transaction(1, 0, MapleTransaction::TRAFFIC_BULK));
+    queue.push(transaction(2, 1, MapleTransaction::TRAFFIC_BULK));
+    queue.push(transaction(3, 5, MapleTransaction::TRAFFIC_LATENCY_CRITICAL));
+
+    // --- TEST EXECUTION / EXPECTATIONS ---
+    ASSERT_TRUE(queue.peek(t));
+    EXPECT_EQ(t.readTimeoutUs, 3U);
+    ASSERT_TRUE(queue.pop(t));
+    EXPECT_EQ(t.readTimeoutUs, 3U);
+    ASSERT_TRUE(queue.pop(t));
+    EXPECT_EQ(t.readTimeoutUs, 1U);
+    ASSERT_TRUE(queue.pop(t));
+    EXPECT_EQ(t.readTimeoutUs, 2U);
+    EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST_F(MapleTransactionArbitrationTest, bulkRecipientsTakeTurns)
+{
+    // --- SETUP ---
+    MapleTransactionQueue<8> queue;
+    MapleTransaction t;
+    // The first recipient floods the queue ahead of the others
+    queue.push(transaction(1, 0, MapleTransaction::TRAFFIC_BULK));
+    queue.push(transaction(2, 0, MapleTransaction::TRAFFIC_BULK));
+    queue.push(transaction(3, 0, MapleTransaction::TRAFFIC_BULK));
+    queue.push(transaction(4, 2, MapleTransaction::TRAFFIC_BULK));
+    queue.push(transaction(5, 0, MapleTransaction::TRAFFIC_BULK));
+    queue.push(transaction(6, 4, MapleTransaction::TRAFFIC_BULK));
+    queue.push(transaction(7, 2, MapleTransaction::TRAFFIC_BULK));
+
+    // --- TEST EXECUTION ---
+    uint32_t order[7] = {};
+    for (uint32_t i = 0; i < 7; ++i)
+    {
+        ASSERT_TRUE(queue.pop(t));
+        order[i] = t.readTimeoutUs;
+    }
+
+    // --- EXPECTATIONS ---
+    // Each recipient is served in turn, oldest first within each recipient
+    const uint32_t expected[7] = {1, 4, 6, 2, 7, 3, 5};
+    for (uint32_t i = 0; i < 7; ++i)
+    {
+        EXPECT_EQ(order[i], expected[i]);
+    }
+    EXPECT_TRUE(queue.isEmpty());
+}
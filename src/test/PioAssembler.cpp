@@ -0,0 +1,702 @@
+#include "PioAssembler.hpp"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+    //! @returns the given string without leading or trailing white space
+    std::string trim(const std::string& s)
+    {
+        size_t start = s.find_first_not_of(" \t\r\n");
+        if (start == std::string::npos)
+        {
+            return std::string();
+        }
+        size_t end = s.find_last_not_of(" \t\r\n");
+        return s.substr(start, end - start + 1);
+    }
+
+    //! @returns the given line without its comment
+    std::string stripComment(const std::string& line)
+    {
+        size_t pos = line.find(';');
+        size_t slashes = line.find("//");
+        if (slashes < pos)
+        {
+            pos = slashes;
+        }
+        return (pos == std::string::npos) ? line : line.substr(0, pos);
+    }
+
+    //! @returns true iff the given string is a valid symbol name
+    bool isSymbol(const std::string& s)
+    {
+        if (s.empty() || !(isalpha(static_cast<unsigned char>(s[0])) || s[0] == '_'))
+        {
+            return false;
+        }
+        for (size_t i = 1; i < s.size(); ++i)
+        {
+            if (!(isalnum(static_cast<unsigned char>(s[i])) || s[i] == '_'))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //! Looks a name up in a table of names
+    //! @param[in] name  The name to find
+    //! @param[in] names  Table of names indexed by value (NULL entries are skipped)
+    //! @param[in] numNames  Number of entries in names
+    //! @param[out] value  Index of the name found
+    //! @returns true iff the name was found
+    bool lookUp(const std::string& name, const char* const* names, uint32_t numNames, uint32_t& value)
+    {
+        // Keywords aren't case sensitive
+        std::string lowerName(name);
+        for (size_t i = 0; i < lowerName.size(); ++i)
+        {
+            lowerName[i] = tolower(static_cast<unsigned char>(lowerName[i]));
+        }
+        for (uint32_t i = 0; i < numNames; ++i)
+        {
+            if (names[i] != NULL && lowerName == names[i])
+            {
+                value = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //! Recursive descent evaluator used by PioAssembler::evaluate()
+    class ExpressionParser
+    {
+        public:
+            ExpressionParser(const std::string& expression,
+                             const std::map<std::string, int32_t>& symbols) :
+                mExpression(expression),
+                mPos(0),
+                mSymbols(symbols)
+            {}
+
+            bool parse(int32_t& value)
+            {
+                return parseSum(value) && (skipSpaces(), mPos == mExpression.size());
+            }
+
+        private:
+            void skipSpaces()
+            {
+                while (mPos < mExpression.size() && isspace(static_cast<unsigned char>(mExpression[mPos])))
+                {
+                    ++mPos;
+                }
+            }
+
+            bool parseSum(int32_t& value)
+            {
+                if (!parseProduct(value))
+                {
+                    return false;
+                }
+                while (true)
+                {
+                    skipSpaces();
+                    if (mPos >= mExpression.size()
+                        || (mExpression[mPos] != '+' && mExpression[mPos] != '-'))
+                    {
+                        return true;
+                    }
+                    char op = mExpression[mPos++];
+                    int32_t rhs = 0;
+                    if (!parseProduct(rhs))
+                    {
+                        return false;
+                    }
+                    value = (op == '+') ? (value + rhs) : (value - rhs);
+                }
+            }
+
+            bool parseProduct(int32_t& value)
+            {
+                if (!parseUnary(value))
+                {
+                    return false;
+                }
+                while (true)
+                {
+                    skipSpaces();
+                    if (mPos >= mExpression.size()
+                        || (mExpression[mPos] != '*' && mExpression[mPos] != '/'))
+                    {
+                        return true;
+                    }
+                    char op = mExpression[mPos++];
+                    int32_t rhs = 0;
+                    if (!parseUnary(rhs) || (op == '/' && rhs == 0))
+                    {
+                        return false;
+                    }
+                    value = (op == '*') ? (value * rhs) : (value / rhs);
+                }
+            }
+
+            bool parseUnary(int32_t& value)
+            {
+                skipSpaces();
+                if (mPos < mExpression.size() && (mExpression[mPos] == '-' || mExpression[mPos] == '~'))
+                {
+                    char op = mExpression[mPos++];
+                    if (!parseUnary(value))
+                    {
+                        return false;
+                    }
+                    value = (op == '-') ? -value : ~value;
+                    return true;
+                }
+                return parsePrimary(value);
+            }
+
+            bool parsePrimary(int32_t& value)
+            {
+                skipSpaces();
+                if (mPos >= mExpression.size())
+                {
+                    return false;
+                }
+                if (mExpression[mPos] == '(')
+                {
+                    ++mPos;
+                    if (!parseSum(value))
+                    {
+                        return false;
+                    }
+                    skipSpaces();
+                    if (mPos >= mExpression.size() || mExpression[mPos] != ')')
+                    {
+                        return false;
+                    }
+                    ++mPos;
+                    return true;
+                }
+                size_t start = mPos;
+                while (mPos < mExpression.size()
+                       && (isalnum(static_cast<unsigned char>(mExpression[mPos])) || mExpression[mPos] == '_'))
+                {
+                    ++mPos;
+                }
+                std::string token = mExpression.substr(start, mPos - start);
+                if (token.empty())
+                {
+                    return false;
+                }
+                if (isdigit(static_cast<unsigned char>(token[0])))
+                {
+                    int base = 10;
+                    size_t digits = 0;
+                    if (token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X'))
+                    {
+                        base = 16;
+                        digits = 2;
+                    }
+                    else if (token.size() > 2 && token[0] == '0' && (token[1] == 'b' || token[1] == 'B'))
+                    {
+                        base = 2;
+                        digits = 2;
+                    }
+                    char* end = NULL;
+                    std::string number = token.substr(digits);
+                    value = static_cast<int32_t>(strtoul(number.c_str(), &end, base));
+                    return (*end == '\0');
+                }
+                std::map<std::string, int32_t>::const_iterator iter = mSymbols.find(token);
+                if (iter == mSymbols.end())
+                {
+                    return false;
+                }
+                value = iter->second;
+                return true;
+            }
+
+        private:
+            const std::string& mExpression;
+            size_t mPos;
+            const std::map<std::string, int32_t>& mSymbols;
+    };
+
+    const char* const JMP_CONDITIONS[] = {"", "!x", "x--", "!y", "y--", "x!=y", "pin", "!osre"};
+    const char* const WAIT_SOURCES[] = {"gpio", "pin", "irq"};
+    const char* const IN_SOURCES[] = {"pins", "x", "y", "null", NULL, NULL, "isr", "osr"};
+    const char* const OUT_DESTINATIONS[] = {"pins", "x", "y", "null", "pindirs", "pc", "isr", "exec"};
+    const char* const MOV_DESTINATIONS[] = {"pins", "x", "y", NULL, "exec", "pc", "isr", "osr"};
+    const char* const MOV_SOURCES[] = {"pins", "x", "y", "null", NULL, "status", "isr", "osr"};
+    const char* const SET_DESTINATIONS[] = {"pins", "x", "y", NULL, "pindirs"};
+
+    const uint16_t OPCODE_JMP = 0x0000;
+    const uint16_t OPCODE_WAIT = 0x2000;
+    const uint16_t OPCODE_IN = 0x4000;
+    const uint16_t OPCODE_OUT = 0x6000;
+    const uint16_t OPCODE_PUSH_PULL = 0x8000;
+    const uint16_t OPCODE_MOV = 0xA000;
+    const uint16_t OPCODE_IRQ = 0xC000;
+    const uint16_t OPCODE_SET = 0xE000;
+}
+
+bool PioAssembler::assemble(const std::string& source)
+{
+    mPrograms.clear();
+    mError.clear();
+
+    std::istringstream stream(source);
+    std::string rawLine;
+    uint32_t lineNumber = 0;
+    bool inLanguageBlock = false;
+    PioProgram* program = NULL;
+    std::map<std::string, int32_t> globalDefines;
+    std::map<std::string, int32_t> symbols;
+    std::vector<PendingInstruction> pending;
+    bool wrapSet = false;
+
+    // Resolves the labels of the program being assembled and encodes its instructions
+    auto finishProgram = [&]() -> bool
+    {
+        if (program != NULL)
+        {
+            for (std::vector<PendingInstruction>::const_iterator iter = pending.begin();
+                 iter != pending.end();
+                 ++iter)
+            {
+                uint16_t code = 0;
+                if (!encode(*iter, *program, symbols, code))
+                {
+                    return false;
+                }
+                program->instructions.push_back(code);
+            }
+            if (program->instructions.empty() || program->instructions.size() > 32)
+            {
+                return fail(lineNumber, "program must have 1 to 32 instructions");
+            }
+            if (!wrapSet)
+            {
+                program->wrap = program->instructions.size() - 1;
+            }
+        }
+        pending.clear();
+        return true;
+    };
+
+    while (std::getline(stream, rawLine))
+    {
+        ++lineNumber;
+        std::string line = trim(rawLine);
+        if (inLanguageBlock)
+        {
+            inLanguageBlock = (line.compare(0, 2, "%}") != 0);
+            continue;
+        }
+        if (line.compare(0, 1, "%") == 0)
+        {
+            inLanguageBlock = true;
+            continue;
+        }
+        line = trim(stripComment(line));
+        if (line.empty())
+        {
+            continue;
+        }
+
+        if (line[0] == '.')
+        {
+            std::istringstream words(line);
+            std::string directive;
+            words >> directive;
+            if (directive == ".program")
+            {
+                if (!finishProgram())
+                {
+                    return false;
+                }
+                std::string name;
+                words >> name;
+                if (!isSymbol(name))
+                {
+                    return fail(lineNumber, "invalid program name");
+                }
+                program = &mPrograms[name];
+                *program = PioProgram();
+                program->wrapTarget = 0;
+                program->wrap = 0;
+                program->sideSetCount = 0;
+                program->sideSetOpt = false;
+                symbols = globalDefines;
+                wrapSet = false;
+            }
+            else if (directive == ".define")
+            {
+                std::string name;
+                words >> name;
+                if (name == "public")
+                {
+                    words >> name;
+                }
+                std::string expression;
+                std::getline(words, expression);
+                int32_t value = 0;
+                if (!isSymbol(name) || !evaluate(expression, symbols, value))
+                {
+                    return fail(lineNumber, "invalid define");
+                }
+                symbols[name] = value;
+                if (program != NULL)
+                {
+                    program->defines[name] = value;
+                }
+                else
+                {
+                    globalDefines[name] = value;
+                }
+            }
+            else if (program == NULL)
+            {
+                return fail(lineNumber, "directive outside of a program");
+            }
+            else if (directive == ".side_set")
+            {
+                std::string count;
+                std::string option;
+                words >> count;
+                int32_t value = 0;
+                if (!evaluate(count, symbols, value) || value < 0 || value > 5)
+                {
+                    return fail(lineNumber, "invalid side-set count");
+                }
+                program->sideSetCount = value;
+                while (words >> option)
+                {
+                    if (option == "opt")
+                    {
+                        program->sideSetOpt = true;
+                        ++program->sideSetCount;
+                    }
+                    else
+                    {
+                        return fail(lineNumber, "unsupported side-set option");
+                    }
+                }
+                if (program->sideSetCount > 5)
+                {
+                    return fail(lineNumber, "too many side-set bits");
+                }
+            }
+            else if (directive == ".wrap_target")
+            {
+                program->wrapTarget = pending.size();
+            }
+            else if (directive == ".wrap")
+            {
+                if (pending.empty())
+                {
+                    return fail(lineNumber, ".wrap before any instruction");
+                }
+                program->wrap = pending.size() - 1;
+                wrapSet = true;
+            }
+            else if (directive != ".origin" && directive != ".lang_opt")
+            {
+                return fail(lineNumber, "unknown directive");
+            }
+            continue;
+        }
+
+        if (program == NULL)
+        {
+            return fail(lineNumber, "instruction outside of a program");
+        }
+
+        // Labels
+        size_t colon = line.find(':');
+        if (colon != std::string::npos && line.compare(colon, 2, "::") != 0)
+        {
+            std::string label = trim(line.substr(0, colon));
+            if (label.compare(0, 7, "public ") == 0)
+            {
+                label = trim(label.substr(7));
+            }
+            if (!isSymbol(label) || symbols.count(label) > 0)
+            {
+                return fail(lineNumber, "invalid or duplicate label");
+            }
+            symbols[label] = pending.size();
+            line = trim(line.substr(colon + 1));
+            if (line.empty())
+            {
+                continue;
+            }
+        }
+
+        PendingInstruction instruction;
+        instruction.lineNumber = lineNumber;
+        if (line[line.size() - 1] == ']')
+        {
+            size_t open = line.rfind('[');
+            if (open == std::string::npos)
+            {
+                return fail(lineNumber, "unmatched ]");
+            }
+            instruction.delay = line.substr(open + 1, line.size() - open - 2);
+            line = trim(line.substr(0, open));
+        }
+        size_t side = line.find(" side ");
+        if (side != std::string::npos)
+        {
+            instruction.sideSet = trim(line.substr(side + 6));
+            line = trim(line.substr(0, side));
+        }
+        for (size_t i = 0; i < line.size(); ++i)
+        {
+            if (line[i] == ',')
+            {
+                line[i] = ' ';
+            }
+        }
+        std::istringstream words(line);
+        std::string word;
+        while (words >> word)
+        {
+            instruction.tokens.push_back(word);
+        }
+        pending.push_back(instruction);
+    }
+
+    return finishProgram();
+}
+
+bool PioAssembler::assembleFile(const std::string& path)
+{
+    std::ifstream file(path.c_str());
+    if (!file)
+    {
+        mError = "could not open " + path;
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return assemble(contents.str());
+}
+
+const PioProgram* PioAssembler::getProgram(const std::string& name) const
+{
+    std::map<std::string, PioProgram>::const_iterator iter = mPrograms.find(name);
+    return (iter == mPrograms.end()) ? NULL : &iter->second;
+}
+
+bool PioAssembler::evaluate(const std::string& expression,
+                            const std::map<std::string, int32_t>& symbols,
+                            int32_t& value)
+{
+    ExpressionParser parser(expression, symbols);
+    return parser.parse(value);
+}
+
+bool PioAssembler::encode(const PendingInstruction& instruction,
+                          const PioProgram& program,
+                          const std::map<std::string, int32_t>& symbols,
+                          uint16_t& code)
+{
+    const std::vector<std::string>& t = instruction.tokens;
+    const uint32_t line = instruction.lineNumber;
+    const std::string& op = t[0];
+    uint32_t index = 0;
+    int32_t value = 0;
+
+    if (op == "nop" && t.size() == 1)
+    {
+        // mov y, y
+        code = OPCODE_MOV | (2 << 5) | 2;
+    }
+    else if (op == "jmp" && (t.size() == 2 || t.size() == 3))
+    {
+        uint32_t condition = 0;
+        if (t.size() == 3 && !lookUp(t[1], JMP_CONDITIONS, 8, condition))
+        {
+            return fail(line, "invalid jmp condition");
+        }
+        if (!evaluate(t.back(), symbols, value) || value < 0 || value > 31)
+        {
+            return fail(line, "invalid jmp target");
+        }
+        code = OPCODE_JMP | (condition << 5) | value;
+    }
+    else if (op == "wait" && (t.size() == 4 || t.size() == 5))
+    {
+        int32_t polarity = 0;
+        if (!evaluate(t[1], symbols, polarity) || polarity < 0 || polarity > 1
+            || !lookUp(t[2], WAIT_SOURCES, 3, index)
+            || !evaluate(t[3], symbols, value) || value < 0 || value > 31)
+        {
+            return fail(line, "invalid wait");
+        }
+        if (t.size() == 5)
+        {
+            if (t[4] != "rel" || index != 2)
+            {
+                return fail(line, "invalid wait");
+            }
+            value |= 0x10;
+        }
+        code = OPCODE_WAIT | (polarity << 7) | (index << 5) | value;
+    }
+    else if ((op == "in" || op == "out") && t.size() == 3)
+    {
+        bool found = (op == "in") ? lookUp(t[1], IN_SOURCES, 8, index)
+                                  : lookUp(t[1], OUT_DESTINATIONS, 8, index);
+        if (!found || !evaluate(t[2], symbols, value) || value < 1 || value > 32)
+        {
+            return fail(line, "invalid " + op);
+        }
+        code = ((op == "in") ? OPCODE_IN : OPCODE_OUT) | (index << 5) | (value & 0x1F);
+    }
+    else if (op == "push" || op == "pull")
+    {
+        bool isPull = (op == "pull");
+        // Blocking is the default
+        code = OPCODE_PUSH_PULL | (isPull ? 0x80 : 0) | 0x20;
+        for (size_t i = 1; i < t.size(); ++i)
+        {
+            if ((!isPull && t[i] == "iffull") || (isPull && t[i] == "ifempty"))
+            {
+                code |= 0x40;
+            }
+            else if (t[i] == "noblock")
+            {
+                code &= ~0x20;
+            }
+            else if (t[i] != "block")
+            {
+                return fail(line, "invalid " + op);
+            }
+        }
+    }
+    else if (op == "mov" && t.size() == 3)
+    {
+        uint32_t source = 0;
+        uint32_t operation = 0;
+        std::string sourceName = t[2];
+        if (sourceName.compare(0, 1, "~") == 0 || sourceName.compare(0, 1, "!") == 0)
+        {
+            operation = 1;
+            sourceName = sourceName.substr(1);
+        }
+        else if (sourceName.compare(0, 2, "::") == 0)
+        {
+            operation = 2;
+            sourceName = sourceName.substr(2);
+        }
+        if (!lookUp(t[1], MOV_DESTINATIONS, 8, index) || !lookUp(sourceName, MOV_SOURCES, 8, source))
+        {
+            return fail(line, "invalid mov");
+        }
+        code = OPCODE_MOV | (index << 5) | (operation << 3) | source;
+    }
+    else if (op == "irq" && t.size() >= 2 && t.size() <= 4)
+    {
+        size_t next = 1;
+        uint32_t mode = 0;
+        if (t[1] == "set" || t[1] == "nowait")
+        {
+            ++next;
+        }
+        else if (t[1] == "wait")
+        {
+            mode = 0x20;
+            ++next;
+        }
+        else if (t[1] == "clear")
+        {
+            mode = 0x40;
+            ++next;
+        }
+        if (next >= t.size() || !evaluate(t[next], symbols, value) || value < 0 || value > 7)
+        {
+            return fail(line, "invalid irq");
+        }
+        if (next + 1 < t.size())
+        {
+            if (t[next + 1] != "rel" || next + 2 != t.size())
+            {
+                return fail(line, "invalid irq");
+            }
+            value |= 0x10;
+        }
+        else if (next + 1 != t.size())
+        {
+            return fail(line, "invalid irq");
+        }
+        code = OPCODE_IRQ | mode | value;
+    }
+    else if (op == "set" && t.size() == 3)
+    {
+        if (!lookUp(t[1], SET_DESTINATIONS, 5, index)
+            || !evaluate(t[2], symbols, value) || value < 0 || value > 31)
+        {
+            return fail(line, "invalid set");
+        }
+        code = OPCODE_SET | (index << 5) | value;
+    }
+    else
+    {
+        return fail(line, "unknown instruction");
+    }
+
+    // Side-set occupies the most significant bits of the delay/side-set field
+    const uint32_t delayBits = 5 - program.sideSetCount;
+    uint32_t field = 0;
+    if (!instruction.delay.empty())
+    {
+        if (!evaluate(instruction.delay, symbols, value)
+            || value < 0 || value >= static_cast<int32_t>(1 << delayBits))
+        {
+            return fail(line, "invalid delay");
+        }
+        field |= value;
+    }
+    if (!instruction.sideSet.empty())
+    {
+        const uint32_t valueBits = program.sideSetCount - (program.sideSetOpt ? 1 : 0);
+        if (program.sideSetCount == 0
+            || !evaluate(instruction.sideSet, symbols, value)
+            || value < 0 || value >= static_cast<int32_t>(1 << valueBits))
+        {
+            return fail(line, "invalid side-set");
+        }
+        uint32_t sideSet = value;
+        if (program.sideSetOpt)
+        {
+            sideSet |= (1 << valueBits);
+        }
+        field |= (sideSet << delayBits);
+    }
+    else if (program.sideSetCount > 0 && !program.sideSetOpt)
+    {
+        return fail(line, "side-set required");
+    }
+    code |= (field << 8);
+    return true;
+}
+
+bool PioAssembler::fail(uint32_t lineNumber, const std::string& message)
+{
+    if (mError.empty())
+    {
+        std::ostringstream error;
+        error << "line " << lineNumber << ": " << message;
+        mError = error.str();
+    }
+    return false;
+}
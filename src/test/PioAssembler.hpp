@@ -0,0 +1,92 @@
+#ifndef __PIO_ASSEMBLER_H__
+#define __PIO_ASSEMBLER_H__
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+//! A PIO program as pioasm would assemble it
+struct PioProgram
+{
+    //! Machine code, to be loaded at offset 0
+    std::vector<uint16_t> instructions;
+    //! Address which execution wraps back to
+    uint32_t wrapTarget;
+    //! Address after which execution wraps
+    uint32_t wrap;
+    //! Number of side-set bits, including the enable bit when side-set is optional
+    uint32_t sideSetCount;
+    //! True iff side-set is optional
+    bool sideSetOpt;
+    //! Every symbol defined with .define for this program (public or not), by name
+    std::map<std::string, int32_t> defines;
+};
+
+//! Assembles the subset of the PIO assembly language which pioasm accepts for RP2040 programs:
+//! every instruction and its operands, side-set, delays, labels, .define, .side_set, .wrap_target,
+//! and .wrap. Language specific blocks (% c-sdk { ... %}) are skipped. This lets the host tests
+//! run the very same programs as the firmware without needing the pico SDK's pioasm.
+class PioAssembler
+{
+    public:
+        //! Assembles every program in the given source
+        //! @param[in] source  The contents of a .pio file
+        //! @returns true iff the source assembled without error; see getError() otherwise
+        bool assemble(const std::string& source);
+
+        //! Reads and assembles the given .pio file
+        //! @param[in] path  Path to the .pio file
+        //! @returns true iff the file was read and assembled without error
+        bool assembleFile(const std::string& path);
+
+        //! @param[in] name  Name given to a program by .program
+        //! @returns the program or NULL if no such program was assembled
+        const PioProgram* getProgram(const std::string& name) const;
+
+        //! @returns a description of the first error encountered (empty when none)
+        inline const std::string& getError() const { return mError; }
+
+    private:
+        //! One instruction waiting for labels to be resolved
+        struct PendingInstruction
+        {
+            uint32_t lineNumber;
+            std::vector<std::string> tokens;
+            std::string sideSet;
+            std::string delay;
+        };
+
+        //! Evaluates an expression of integers, symbols, parentheses, unary - and ~, and the binary
+        //! operators * / + - (standard precedence)
+        //! @param[in] expression  The expression
+        //! @param[in] symbols  Symbols which may be referred to
+        //! @param[out] value  The result
+        //! @returns true iff the expression was valid
+        bool evaluate(const std::string& expression,
+                      const std::map<std::string, int32_t>& symbols,
+                      int32_t& value);
+
+        //! Encodes one instruction
+        //! @param[in] instruction  The instruction
+        //! @param[in] program  The program it belongs to (for side-set configuration)
+        //! @param[in] symbols  Defines and labels of the program
+        //! @param[out] code  The machine code
+        //! @returns true iff the instruction was valid
+        bool encode(const PendingInstruction& instruction,
+                    const PioProgram& program,
+                    const std::map<std::string, int32_t>& symbols,
+                    uint16_t& code);
+
+        //! Records an error against a line
+        //! @returns false
+        bool fail(uint32_t lineNumber, const std::string& message);
+
+    private:
+        //! Assembled programs by name
+        std::map<std::string, PioProgram> mPrograms;
+        //! First error encountered
+        std::string mError;
+};
+
+#endif // __PIO_ASSEMBLER_H__
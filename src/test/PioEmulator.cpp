@@ -0,0 +1,528 @@
+#include "PioEmulator.hpp"
+
+namespace
+{
+    //! @returns a mask of the given number of low bits (1 to 32)
+    inline uint32_t lowBits(uint32_t count)
+    {
+        return (count >= 32) ? 0xFFFFFFFF : ((1U << count) - 1);
+    }
+
+    //! @returns the bit count field of an IN or OUT instruction (0 means 32)
+    inline uint32_t bitCount(uint16_t instruction)
+    {
+        uint32_t count = instruction & 0x1F;
+        return (count == 0) ? 32 : count;
+    }
+
+    //! @returns the given word with its bits in reverse order
+    inline uint32_t reverseBits(uint32_t word)
+    {
+        uint32_t reversed = 0;
+        for (uint32_t i = 0; i < 32; ++i, word >>= 1)
+        {
+            reversed = (reversed << 1) | (word & 1);
+        }
+        return reversed;
+    }
+}
+
+PioGpio::PioGpio() :
+    mPioEnable(0),
+    mPioLevels(0),
+    mExternalEnable(0),
+    mExternalLevels(0),
+    mSynced{0xFFFFFFFF, 0xFFFFFFFF},
+    mNumConflicts(0)
+{}
+
+void PioGpio::setExternal(uint32_t pin, bool drive, bool level)
+{
+    const uint32_t mask = (1U << pin);
+    mExternalEnable = drive ? (mExternalEnable | mask) : (mExternalEnable & ~mask);
+    mExternalLevels = level ? (mExternalLevels | mask) : (mExternalLevels & ~mask);
+}
+
+void PioGpio::setPioOutput(uint32_t pin, bool enable, bool level)
+{
+    const uint32_t mask = (1U << pin);
+    mPioEnable = enable ? (mPioEnable | mask) : (mPioEnable & ~mask);
+    mPioLevels = level ? (mPioLevels | mask) : (mPioLevels & ~mask);
+}
+
+uint32_t PioGpio::getLevels() const
+{
+    // Undriven pins are pulled up
+    uint32_t levels = 0xFFFFFFFF;
+    levels = (levels & ~mExternalEnable) | (mExternalLevels & mExternalEnable);
+    levels = (levels & ~mPioEnable) | (mPioLevels & mPioEnable);
+    return levels;
+}
+
+void PioGpio::clock()
+{
+    if ((mPioEnable & mExternalEnable & (mPioLevels ^ mExternalLevels)) != 0)
+    {
+        ++mNumConflicts;
+    }
+    mSynced[1] = mSynced[0];
+    mSynced[0] = getLevels();
+}
+
+PioSmConfig::PioSmConfig() :
+    clkDiv256(256),
+    outBase(0),
+    outCount(32),
+    setBase(0),
+    setCount(5),
+    sideSetBase(0),
+    inBase(0),
+    jmpPin(0),
+    outShiftRight(true),
+    autoPull(false),
+    pullThreshold(32),
+    inShiftRight(true),
+    autoPush(false),
+    pushThreshold(32),
+    connectedToPins(true)
+{}
+
+PioStateMachine::PioStateMachine(const PioProgram& program,
+                                 const PioSmConfig& config,
+                                 PioGpio& gpio,
+                                 uint32_t smIdx) :
+    mProgram(program),
+    mConfig(config),
+    mGpio(gpio),
+    mSmIdx(smIdx),
+    mEnabled(false),
+    mDivAccumulator(0),
+    mPc(0),
+    mX(0),
+    mY(0),
+    mIsr(0),
+    mIsrCount(0),
+    mOsr(0),
+    mOsrCount(32),
+    mDelay(0),
+    mStalled(false),
+    mIrqWaiting(false),
+    mFaulted(false),
+    mIrqFlags(0),
+    mPinLevels(0),
+    mPinDirections(0),
+    mTxFifo(),
+    mRxFifo(),
+    mNumTicks(0)
+{}
+
+void PioStateMachine::restart()
+{
+    mTxFifo.clear();
+    mRxFifo.clear();
+    mDivAccumulator = 0;
+    mPc = 0;
+    mIsr = 0;
+    mIsrCount = 0;
+    // The OSR starts out empty
+    mOsrCount = 32;
+    mDelay = 0;
+    mStalled = false;
+    mIrqWaiting = false;
+}
+
+void PioStateMachine::setEnabled(bool enabled)
+{
+    mEnabled = enabled;
+}
+
+void PioStateMachine::exec(uint16_t instruction)
+{
+    bool jumped = false;
+    execute(instruction, jumped);
+    mStalled = false;
+    mIrqWaiting = false;
+}
+
+void PioStateMachine::clock()
+{
+    if (!mEnabled)
+    {
+        return;
+    }
+
+    // Fractional divider: the state machine ticks 256 times for every clkDiv256 system cycles
+    mDivAccumulator += 256;
+    if (mDivAccumulator < mConfig.clkDiv256)
+    {
+        return;
+    }
+    mDivAccumulator -= mConfig.clkDiv256;
+    ++mNumTicks;
+
+    if (mDelay > 0)
+    {
+        --mDelay;
+        return;
+    }
+
+    const uint16_t instruction = (mPc < mProgram.instructions.size())
+                                 ? mProgram.instructions[mPc]
+                                 : 0;
+    bool jumped = false;
+    mStalled = !execute(instruction, jumped);
+    if (!mStalled)
+    {
+        if (!jumped)
+        {
+            mPc = (mPc == mProgram.wrap) ? mProgram.wrapTarget : ((mPc + 1) & 0x1F);
+        }
+        const uint32_t delayBits = 5 - mProgram.sideSetCount;
+        mDelay = (instruction >> 8) & lowBits(delayBits);
+    }
+}
+
+bool PioStateMachine::putTx(uint32_t word)
+{
+    bool rv = false;
+    if (mTxFifo.size() < FIFO_DEPTH)
+    {
+        mTxFifo.push_back(word);
+        rv = true;
+    }
+    return rv;
+}
+
+bool PioStateMachine::getRx(uint32_t& word)
+{
+    bool rv = false;
+    if (!mRxFifo.empty())
+    {
+        word = mRxFifo.front();
+        mRxFifo.pop_front();
+        rv = true;
+    }
+    return rv;
+}
+
+bool PioStateMachine::execute(uint16_t instruction, bool& jumped)
+{
+    jumped = false;
+
+    // Side-set takes effect as the instruction issues, whether or not it stalls
+    if (mProgram.sideSetCount > 0)
+    {
+        const uint32_t delayBits = 5 - mProgram.sideSetCount;
+        const uint32_t field = (instruction >> (8 + delayBits)) & lowBits(mProgram.sideSetCount);
+        const uint32_t valueBits = mProgram.sideSetCount - (mProgram.sideSetOpt ? 1 : 0);
+        if (!mProgram.sideSetOpt || ((field >> valueBits) & 1) != 0)
+        {
+            writePins(mConfig.sideSetBase, valueBits, field, false);
+        }
+    }
+
+    const uint32_t opcode = (instruction >> 13) & 0x7;
+    const uint32_t arg1 = (instruction >> 5) & 0x7;
+    const uint32_t arg2 = instruction & 0x1F;
+
+    switch (opcode)
+    {
+        case 0: // JMP
+        {
+            bool condition = false;
+            switch (arg1)
+            {
+                case 0: condition = true; break;
+                case 1: condition = (mX == 0); break;
+                case 2: condition = (mX != 0); --mX; break;
+                case 3: condition = (mY == 0); break;
+                case 4: condition = (mY != 0); --mY; break;
+                case 5: condition = (mX != mY); break;
+                case 6: condition = ((mGpio.getSyncedLevels() >> mConfig.jmpPin) & 1) != 0; break;
+                default: condition = (mOsrCount < mConfig.pullThreshold); break;
+            }
+            if (condition)
+            {
+                mPc = arg2;
+                jumped = true;
+            }
+            return true;
+        }
+
+        case 1: // WAIT
+        {
+            const bool polarity = ((instruction >> 7) & 1) != 0;
+            const uint32_t source = (instruction >> 5) & 0x3;
+            bool level = false;
+            if (source == 0)
+            {
+                level = ((mGpio.getSyncedLevels() >> arg2) & 1) != 0;
+            }
+            else if (source == 1)
+            {
+                level = ((readInPins() >> arg2) & 1) != 0;
+            }
+            else if (source == 2)
+            {
+                const uint32_t flag = irqFlag(arg2);
+                level = isIrqSet(flag);
+                if (polarity && level)
+                {
+                    // Waiting for an IRQ flag to be set also clears it
+                    clearIrq(flag);
+                }
+            }
+            else
+            {
+                mFaulted = true;
+            }
+            return (level == polarity);
+        }
+
+        case 2: // IN
+        {
+            const uint32_t count = bitCount(instruction);
+            uint32_t data = 0;
+            switch (arg1)
+            {
+                case 0: data = readInPins(); break;
+                case 1: data = mX; break;
+                case 2: data = mY; break;
+                case 3: data = 0; break;
+                case 6: data = mIsr; break;
+                case 7: data = mOsr; break;
+                default: mFaulted = true; break;
+            }
+            if (mConfig.autoPush
+                && mIsrCount + count >= mConfig.pushThreshold
+                && mRxFifo.size() >= FIFO_DEPTH)
+            {
+                // Stalls until there is room to push
+                return false;
+            }
+            data &= lowBits(count);
+            if (count == 32)
+            {
+                mIsr = data;
+            }
+            else if (mConfig.inShiftRight)
+            {
+                mIsr = (mIsr >> count) | (data << (32 - count));
+            }
+            else
+            {
+                mIsr = (mIsr << count) | data;
+            }
+            mIsrCount = (mIsrCount + count > 32) ? 32 : (mIsrCount + count);
+            if (mConfig.autoPush && mIsrCount >= mConfig.pushThreshold)
+            {
+                pushIsr();
+            }
+            return true;
+        }
+
+        case 3: // OUT
+        {
+            const uint32_t count = bitCount(instruction);
+            if (mConfig.autoPull && mOsrCount >= mConfig.pullThreshold)
+            {
+                if (mTxFifo.empty())
+                {
+                    // Stalls until there is data to shift out
+                    return false;
+                }
+                mOsr = mTxFifo.front();
+                mTxFifo.pop_front();
+                mOsrCount = 0;
+            }
+            uint32_t data = 0;
+            if (count == 32)
+            {
+                data = mOsr;
+                mOsr = 0;
+            }
+            else if (mConfig.outShiftRight)
+            {
+                data = mOsr & lowBits(count);
+                mOsr >>= count;
+            }
+            else
+            {
+                data = mOsr >> (32 - count);
+                mOsr <<= count;
+            }
+            mOsrCount = (mOsrCount + count > 32) ? 32 : (mOsrCount + count);
+            switch (arg1)
+            {
+                case 0: writePins(mConfig.outBase, mConfig.outCount, data, false); break;
+                case 1: mX = data; break;
+                case 2: mY = data; break;
+                case 3: break;
+                case 4: writePins(mConfig.outBase, mConfig.outCount, data, true); break;
+                case 5: mPc = data & 0x1F; jumped = true; break;
+                case 6: mIsr = data; mIsrCount = count; break;
+                default: mFaulted = true; break;
+            }
+            return true;
+        }
+
+        case 4: // PUSH / PULL
+        {
+            const bool isPull = ((instruction >> 7) & 1) != 0;
+            const bool ifFullOrEmpty = ((instruction >> 6) & 1) != 0;
+            const bool block = ((instruction >> 5) & 1) != 0;
+            if (!isPull)
+            {
+                if (ifFullOrEmpty && mIsrCount < mConfig.pushThreshold)
+                {
+                    return true;
+                }
+                if (mRxFifo.size() >= FIFO_DEPTH)
+                {
+                    // A non-blocking push is dropped
+                    return !block;
+                }
+                pushIsr();
+            }
+            else
+            {
+                if (ifFullOrEmpty && mOsrCount < mConfig.pullThreshold)
+                {
+                    return true;
+                }
+                if (mTxFifo.empty())
+                {
+                    if (block)
+                    {
+                        return false;
+                    }
+                    // A non-blocking pull from an empty FIFO copies X
+                    mOsr = mX;
+                }
+                else
+                {
+                    mOsr = mTxFifo.front();
+                    mTxFifo.pop_front();
+                }
+                mOsrCount = 0;
+            }
+            return true;
+        }
+
+        case 5: // MOV
+        {
+            const uint32_t operation = (instruction >> 3) & 0x3;
+            uint32_t data = 0;
+            switch (instruction & 0x7)
+            {
+                case 0: data = readInPins(); break;
+                case 1: data = mX; break;
+                case 2: data = mY; break;
+                case 3: data = 0; break;
+                case 6: data = mIsr; break;
+                case 7: data = mOsr; break;
+                default: mFaulted = true; break;
+            }
+            if (operation == 1)
+            {
+                data = ~data;
+            }
+            else if (operation == 2)
+            {
+                data = reverseBits(data);
+            }
+            switch (arg1)
+            {
+                case 0: writePins(mConfig.outBase, mConfig.outCount, data, false); break;
+                case 1: mX = data; break;
+                case 2: mY = data; break;
+                case 5: mPc = data & 0x1F; jumped = true; break;
+                case 6: mIsr = data; mIsrCount = 0; break;
+                case 7: mOsr = data; mOsrCount = 0; break;
+                default: mFaulted = true; break;
+            }
+            return true;
+        }
+
+        case 6: // IRQ
+        {
+            const bool clear = ((instruction >> 6) & 1) != 0;
+            const bool wait = ((instruction >> 5) & 1) != 0;
+            const uint32_t flag = irqFlag(arg2);
+            if (clear)
+            {
+                clearIrq(flag);
+                return true;
+            }
+            if (!wait)
+            {
+                mIrqFlags |= (1U << flag);
+                return true;
+            }
+            if (!mIrqWaiting)
+            {
+                mIrqFlags |= (1U << flag);
+                mIrqWaiting = true;
+            }
+            if (isIrqSet(flag))
+            {
+                return false;
+            }
+            mIrqWaiting = false;
+            return true;
+        }
+
+        default: // SET
+        {
+            switch (arg1)
+            {
+                case 0: writePins(mConfig.setBase, mConfig.setCount, arg2, false); break;
+                case 1: mX = arg2; break;
+                case 2: mY = arg2; break;
+                case 4: writePins(mConfig.setBase, mConfig.setCount, arg2, true); break;
+                default: mFaulted = true; break;
+            }
+            return true;
+        }
+    }
+}
+
+void PioStateMachine::writePins(uint32_t base, uint32_t count, uint32_t values, bool directions)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t pin = (base + i) & 0x1F;
+        const uint32_t mask = (1U << pin);
+        uint32_t& bits = directions ? mPinDirections : mPinLevels;
+        bits = (((values >> i) & 1) != 0) ? (bits | mask) : (bits & ~mask);
+        if (mConfig.connectedToPins)
+        {
+            mGpio.setPioOutput(pin, (mPinDirections & mask) != 0, (mPinLevels & mask) != 0);
+        }
+    }
+}
+
+uint32_t PioStateMachine::readInPins() const
+{
+    const uint32_t levels = mGpio.getSyncedLevels();
+    const uint32_t base = mConfig.inBase & 0x1F;
+    return (base == 0) ? levels : ((levels >> base) | (levels << (32 - base)));
+}
+
+uint32_t PioStateMachine::irqFlag(uint32_t index) const
+{
+    uint32_t flag = index & 0x7;
+    if ((index & 0x10) != 0)
+    {
+        // Relative: the state machine index is added to the lower 2 bits
+        flag = (flag & 0x4) | ((flag + mSmIdx) & 0x3);
+    }
+    return flag;
+}
+
+void PioStateMachine::pushIsr()
+{
+    mRxFifo.push_back(mIsr);
+    mIsr = 0;
+    mIsrCount = 0;
+}
@@ -0,0 +1,224 @@
+#ifndef __PIO_EMULATOR_H__
+#define __PIO_EMULATOR_H__
+
+#include "PioAssembler.hpp"
+
+#include <stdint.h>
+#include <deque>
+
+//! The GPIO pins as seen by emulated state machines and anything else simulated on the bus. A pin
+//! reads as the level PIO drives it to when PIO drives it, else the level driven from outside,
+//! else HIGH (every pin is pulled up, just as the Maple Bus is).
+class PioGpio
+{
+    public:
+        //! Constructor - nothing drives any pin
+        PioGpio();
+
+        //! Drives or releases a pin from outside of PIO (such as a simulated peripheral)
+        //! @param[in] pin  The pin number
+        //! @param[in] drive  True to drive the pin, false to release it
+        //! @param[in] level  The level to drive (ignored when released)
+        void setExternal(uint32_t pin, bool drive, bool level);
+
+        //! Sets what a state machine connected to a pin drives it with
+        //! @param[in] pin  The pin number
+        //! @param[in] enable  True to drive the pin (pin direction is output)
+        //! @param[in] level  The level to drive
+        void setPioOutput(uint32_t pin, bool enable, bool level);
+
+        //! @returns the level of every pin right now (bit n is pin n)
+        uint32_t getLevels() const;
+
+        //! @returns the level of every pin as PIO sees it through its 2 cycle input synchronizers
+        inline uint32_t getSyncedLevels() const { return mSynced[1]; }
+
+        //! Advances one system clock cycle; call this before clocking the state machines
+        void clock();
+
+        //! @returns the number of cycles during which PIO and something outside of PIO drove a pin
+        //!          to different levels
+        inline uint32_t getNumConflicts() const { return mNumConflicts; }
+
+    private:
+        //! Pins driven by PIO
+        uint32_t mPioEnable;
+        //! Levels driven by PIO
+        uint32_t mPioLevels;
+        //! Pins driven from outside
+        uint32_t mExternalEnable;
+        //! Levels driven from outside
+        uint32_t mExternalLevels;
+        //! Levels passing through the input synchronizers
+        uint32_t mSynced[2];
+        //! Number of cycles with conflicting drivers
+        uint32_t mNumConflicts;
+};
+
+//! State machine configuration, as it would be set through pio_sm_config
+struct PioSmConfig
+{
+    //! Constructor - the same defaults as pio_get_default_sm_config()
+    PioSmConfig();
+
+    //! Clock divider in 1/256ths (256 runs the state machine every system clock cycle)
+    uint32_t clkDiv256;
+    //! First pin of OUT pins
+    uint32_t outBase;
+    //! Number of OUT pins
+    uint32_t outCount;
+    //! First pin of SET pins
+    uint32_t setBase;
+    //! Number of SET pins
+    uint32_t setCount;
+    //! First side-set pin
+    uint32_t sideSetBase;
+    //! First IN pin
+    uint32_t inBase;
+    //! Pin tested by jmp pin
+    uint32_t jmpPin;
+    //! True to shift the OSR to the right
+    bool outShiftRight;
+    //! True to refill the OSR automatically
+    bool autoPull;
+    //! Number of bits shifted out before the OSR is refilled
+    uint32_t pullThreshold;
+    //! True to shift the ISR to the right
+    bool inShiftRight;
+    //! True to push the ISR automatically
+    bool autoPush;
+    //! Number of bits shifted in before the ISR is pushed
+    uint32_t pushThreshold;
+    //! True iff the pins' function is set to this state machine's PIO block (pio_gpio_init()); a
+    //! state machine which isn't connected may still sample pins but never drives them
+    bool connectedToPins;
+};
+
+//! Emulates one RP2040 PIO state machine running assembled machine code, one system clock cycle at
+//! a time, honoring the fractional clock divider, delays, side-set, stalls, FIFOs, and wrapping.
+//! The state machine sits alone in its PIO block, so its IRQ flags are its own.
+class PioStateMachine
+{
+    public:
+        //! Depth of each FIFO
+        static const uint32_t FIFO_DEPTH = 4;
+
+        //! Constructor - the program is loaded at offset 0 and the state machine starts disabled
+        //! @param[in] program  The program to run
+        //! @param[in] config  Configuration of the state machine
+        //! @param[in] gpio  The pins
+        //! @param[in] smIdx  Index of the state machine within its block (for relative IRQs)
+        PioStateMachine(const PioProgram& program,
+                        const PioSmConfig& config,
+                        PioGpio& gpio,
+                        uint32_t smIdx = 0);
+
+        //! Clears FIFOs and all internal state and jumps to the start of the program, as the
+        //! firmware does before enabling a state machine
+        void restart();
+
+        //! Enables or disables the state machine
+        void setEnabled(bool enabled);
+
+        //! Executes a single instruction right away, as pio_sm_exec() does
+        void exec(uint16_t instruction);
+
+        //! Advances one system clock cycle
+        void clock();
+
+        //! Pushes a word into the TX FIFO
+        //! @returns false if the FIFO is full
+        bool putTx(uint32_t word);
+
+        //! Pops a word from the RX FIFO
+        //! @returns false if the FIFO is empty
+        bool getRx(uint32_t& word);
+
+        //! @returns the number of words in the TX FIFO
+        inline uint32_t getTxLevel() const { return mTxFifo.size(); }
+
+        //! @returns the number of words in the RX FIFO
+        inline uint32_t getRxLevel() const { return mRxFifo.size(); }
+
+        //! @returns true iff the given IRQ flag is set
+        inline bool isIrqSet(uint32_t flag) const { return ((mIrqFlags >> flag) & 1) != 0; }
+
+        //! Clears the given IRQ flag, as the firmware's ISR does
+        inline void clearIrq(uint32_t flag) { mIrqFlags &= ~(1U << flag); }
+
+        //! @returns the program counter
+        inline uint32_t getPc() const { return mPc; }
+
+        //! @returns true iff the current instruction is stalled
+        inline bool isStalled() const { return mStalled; }
+
+        //! @returns true iff an instruction which isn't emulated was executed
+        inline bool hasFaulted() const { return mFaulted; }
+
+        //! @returns the X scratch register
+        inline uint32_t getX() const { return mX; }
+
+        //! @returns the Y scratch register
+        inline uint32_t getY() const { return mY; }
+
+        //! @returns the number of state machine clock ticks so far
+        inline uint64_t getNumTicks() const { return mNumTicks; }
+
+    private:
+        //! Executes an instruction
+        //! @param[in] instruction  The instruction
+        //! @param[out] jumped  True iff the program counter was written
+        //! @returns true iff the instruction completed (false when stalled)
+        bool execute(uint16_t instruction, bool& jumped);
+
+        //! Drives pins
+        //! @param[in] base  First pin
+        //! @param[in] count  Number of pins
+        //! @param[in] values  Bit n is the level or direction of pin base + n
+        //! @param[in] directions  True to write pin directions instead of levels
+        void writePins(uint32_t base, uint32_t count, uint32_t values, bool directions);
+
+        //! @returns the synced pin levels rotated so that the first IN pin is bit 0
+        uint32_t readInPins() const;
+
+        //! @returns the absolute IRQ flag number of the index field of an IRQ or WAIT instruction
+        uint32_t irqFlag(uint32_t index) const;
+
+        //! Pushes the ISR into the RX FIFO
+        void pushIsr();
+
+    private:
+        //! Copy constructor - not implemented
+        PioStateMachine(const PioStateMachine&);
+
+        //! Assignment operator - not implemented
+        PioStateMachine& operator=(const PioStateMachine&);
+
+    private:
+        const PioProgram& mProgram;
+        const PioSmConfig mConfig;
+        PioGpio& mGpio;
+        const uint32_t mSmIdx;
+        bool mEnabled;
+        uint32_t mDivAccumulator;
+        uint32_t mPc;
+        uint32_t mX;
+        uint32_t mY;
+        uint32_t mIsr;
+        uint32_t mIsrCount;
+        uint32_t mOsr;
+        uint32_t mOsrCount;
+        uint32_t mDelay;
+        bool mStalled;
+        //! Set once an irq wait instruction has raised its flag and is waiting for it to clear
+        bool mIrqWaiting;
+        bool mFaulted;
+        uint32_t mIrqFlags;
+        uint32_t mPinLevels;
+        uint32_t mPinDirections;
+        std::deque<uint32_t> mTxFifo;
+        std::deque<uint32_t> mRxFifo;
+        uint64_t mNumTicks;
+};
+
+#endif // __PIO_EMULATOR_H__
@@ -0,0 +1,88 @@
+#include "PollingGovernor.hpp"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    // 1 kHz down to 16 ms, doubling after every 2 idle polls; each poll takes 100 us of bus time
+    const PollingGovernor::Profile PROFILE = {1000, 16000, 2, 100};
+}
+
+TEST(PollingGovernorTest, idleBacksOffAndActivityRecovers)
+{
+    // --- SETUP ---
+    PollingGovernor governor(PROFILE, NULL);
+    EXPECT_EQ(governor.getPeriodUs(), 1000U);
+
+    // --- TEST EXECUTION / EXPECTATIONS ---
+    governor.idle();
+    EXPECT_EQ(governor.getPeriodUs(), 1000U);
+    governor.idle();
+    EXPECT_EQ(governor.getPeriodUs(), 2000U);
+    for (uint32_t i = 0; i < 20; ++i)
+    {
+        governor.idle();
+    }
+    // Never backs off beyond the maximum period
+    EXPECT_EQ(governor.getPeriodUs(), 16000U);
+
+    governor.activity();
+    EXPECT_EQ(governor.getPeriodUs(), 1000U);
+}
+
+TEST(PollingGovernorTest, budgetLimitsRate)
+{
+    // --- SETUP ---
+    // Enough bus time for 1 poll every 1 ms plus 1 poll every 2 ms
+    PollingBudget budget(150);
+
+    // --- TEST EXECUTION ---
+    PollingGovernor first(PROFILE, &budget);
+    PollingGovernor second(PROFILE, &budget);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(first.getPeriodUs(), 1000U);
+    EXPECT_EQ(second.getPeriodUs(), 2000U);
+    EXPECT_EQ(budget.getAvailablePermille(), 0U);
+
+    // Once the first backs off, the second may speed up
+    first.idle();
+    first.idle();
+    second.activity();
+    EXPECT_EQ(first.getPeriodUs(), 2000U);
+    EXPECT_EQ(second.getPeriodUs(), 1000U);
+}
+
+TEST(PollingGovernorTest, exhaustedBudgetStillPollsAtMaxPeriod)
+{
+    // --- SETUP ---
+    PollingBudget budget(100);
+    PollingGovernor first(PROFILE, &budget);
+
+    // --- TEST EXECUTION ---
+    PollingGovernor second(PROFILE, &budget);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(second.getPeriodUs(), 16000U);
+}
+
+TEST(PollingGovernorTest, destructionReleasesBudget)
+{
+    // --- SETUP ---
+    PollingBudget budget(1000);
+
+    // --- TEST EXECUTION ---
+    {
+        PollingGovernor governor(PROFILE, &budget);
+        EXPECT_EQ(budget.getAvailablePermille(), 900U);
+    }
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(budget.getAvailablePermille(), 1000U);
+}
+
+TEST(PollingGovernorTest, transactionCost)
+{
+    // 240 bits at 480 ns per bit plus turnaround
+    EXPECT_EQ(PollingGovernor::transactionCostUs(1, 3), 215U);
+}
@@ -0,0 +1,171 @@
+#include "ScreenData.hpp"
+
+#include <string.h>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    //! Fills a screen with a single repeated word
+    void fillScreen(uint32_t* words, uint32_t value)
+    {
+        for (uint32_t i = 0; i < ScreenData::NUM_SCREEN_WORDS; ++i)
+        {
+            words[i] = value;
+        }
+    }
+
+    //! Encodes the newest screen with a one word header
+    bool encode(ScreenData& screenData, MapleEncodedPacket& packet, uint32_t& lastVersion)
+    {
+        static const uint32_t header[1] = {0x12345678};
+        return screenData.readData(packet, 0x0C, 0x01, 0x00, header, 1, lastVersion);
+    }
+
+    //! @returns the 32-bit FNV-1a hash of the first numWords words, one word at a time
+    uint32_t fnv1a(const uint32_t* words, uint32_t numWords)
+    {
+        uint32_t hash = 2166136261U;
+        for (uint32_t i = 0; i < numWords; ++i)
+        {
+            hash = (hash ^ words[i]) * 16777619U;
+        }
+        return hash;
+    }
+}
+
+TEST(ScreenDataTest, partialWriteCarriesOverRestOfScreen)
+{
+    // --- SETUP ---
+    ScreenData screenData;
+    uint32_t screen[ScreenData::NUM_SCREEN_WORDS];
+    fillScreen(screen, 0x11111111);
+    screenData.setData(screen);
+
+    // --- TEST EXECUTION ---
+    uint32_t rows[2] = {0x22222222, 0x33333333};
+    screenData.setData(rows, 46, 2);
+    uint32_t out[ScreenData::NUM_SCREEN_WORDS];
+    uint32_t version = screenData.readData(out);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(version, 3U);
+    for (uint32_t i = 0; i < 46; ++i)
+    {
+        EXPECT_EQ(out[i], 0x11111111U);
+    }
+    EXPECT_EQ(out[46], 0x22222222U);
+    EXPECT_EQ(out[47], 0x33333333U);
+}
+
+TEST(ScreenDataTest, encodesOnlyNewScreens)
+{
+    // --- SETUP ---
+    ScreenData screenData;
+    MapleEncodedPacketBuffer<ScreenData::NUM_SCREEN_WORDS + 1> packet;
+    uint32_t lastVersion = ScreenData::NO_VERSION;
+    uint32_t screen[ScreenData::NUM_SCREEN_WORDS];
+
+    // --- TEST EXECUTION / EXPECTATIONS ---
+    // The default screen is always encoded first
+    EXPECT_TRUE(encode(screenData, packet, lastVersion));
+    EXPECT_EQ(packet.getPayloadLen(), ScreenData::NUM_SCREEN_WORDS + 1);
+    EXPECT_FALSE(encode(screenData, packet, lastVersion));
+
+    fillScreen(screen, 0xAAAA5555);
+    screenData.setData(screen);
+    EXPECT_TRUE(encode(screenData, packet, lastVersion));
+    EXPECT_EQ(packet.getWords()[3], __builtin_bswap32(0xAAAA5555));
+
+    // Redrawing the same screen doesn't publish a new version, so nothing is encoded again
+    screenData.setData(screen);
+    EXPECT_FALSE(encode(screenData, packet, lastVersion));
+    EXPECT_FALSE(encode(screenData, packet, lastVersion));
+
+    screen[10] = 0;
+    screenData.setData(screen);
+    EXPECT_TRUE(encode(screenData, packet, lastVersion));
+}
+
+TEST(ScreenDataTest, newScreenWithSameHashIsEncoded)
+{
+    // --- SETUP ---
+    ScreenData screenData;
+    MapleEncodedPacketBuffer<ScreenData::NUM_SCREEN_WORDS + 1> packet;
+    uint32_t lastVersion = ScreenData::NO_VERSION;
+    uint32_t screen[ScreenData::NUM_SCREEN_WORDS];
+    fillScreen(screen, 0xAAAA5555);
+    screenData.setData(screen);
+    ASSERT_TRUE(encode(screenData, packet, lastVersion));
+
+    // A different screen with the same hash: change the second to last word, then pick the last
+    // word which brings the hash back to where it was before the last word
+    uint32_t other[ScreenData::NUM_SCREEN_WORDS];
+    memcpy(other, screen, sizeof(other));
+    const uint32_t last = ScreenData::NUM_SCREEN_WORDS - 1;
+    other[last - 1] ^= 0x00010000;
+    other[last] = fnv1a(screen, last) ^ screen[last] ^ fnv1a(other, last);
+    ASSERT_EQ(fnv1a(other, ScreenData::NUM_SCREEN_WORDS),
+              fnv1a(screen, ScreenData::NUM_SCREEN_WORDS));
+
+    // --- TEST EXECUTION ---
+    screenData.setData(other);
+    bool encoded = encode(screenData, packet, lastVersion);
+
+    // --- EXPECTATIONS ---
+    EXPECT_TRUE(encoded);
+    EXPECT_EQ(lastVersion, 3U);
+    // Screen words follow the bit count, frame and header words
+    EXPECT_EQ(packet.getWords()[3 + last], __builtin_bswap32(other[last]));
+}
+
+TEST(ScreenDataTest, readerNeverSeesTornScreen)
+{
+    // --- SETUP ---
+    ScreenData screenData;
+    static const uint32_t NUM_WRITES = 20000;
+
+    // --- TEST EXECUTION ---
+    std::thread writer([&screenData]() {
+        uint32_t screen[ScreenData::NUM_SCREEN_WORDS];
+        for (uint32_t i = 1; i <= NUM_WRITES; ++i)
+        {
+            fillScreen(screen, i);
+            screenData.setData(screen);
+        }
+    });
+
+    uint32_t numTorn = 0;
+    uint32_t numOutOfOrder = 0;
+    uint32_t lastVersion = 0;
+    uint32_t lastValue = 0;
+    while (lastValue < NUM_WRITES)
+    {
+        uint32_t out[ScreenData::NUM_SCREEN_WORDS];
+        uint32_t version = screenData.readData(out);
+        // Screen i is published as version i + 1 (the default screen is version 1)
+        if (version > 1)
+        {
+            for (uint32_t j = 0; j < ScreenData::NUM_SCREEN_WORDS; ++j)
+            {
+                if (out[j] != version - 1)
+                {
+                    ++numTorn;
+                    break;
+                }
+            }
+            if (version < lastVersion)
+            {
+                ++numOutOfOrder;
+            }
+            lastVersion = version;
+            lastValue = version - 1;
+        }
+    }
+    writer.join();
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(numTorn, 0U);
+    EXPECT_EQ(numOutOfOrder, 0U);
+}
@@ -0,0 +1,91 @@
+#include "SeqLock.hpp"
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    //! A value which is only consistent when every word was written together
+    struct Snapshot
+    {
+        uint32_t words[8];
+    };
+}
+
+TEST(SeqLockTest, readOnlyReturnsNewValues)
+{
+    // --- SETUP ---
+    SeqLock<uint32_t> seqLock;
+    uint32_t lastSequence = 0;
+    uint32_t value = 0;
+
+    // --- TEST EXECUTION / EXPECTATIONS ---
+    // Nothing written yet
+    EXPECT_FALSE(seqLock.read(value, lastSequence));
+
+    seqLock.write(5);
+    EXPECT_TRUE(seqLock.read(value, lastSequence));
+    EXPECT_EQ(value, 5U);
+    EXPECT_FALSE(seqLock.read(value, lastSequence));
+
+    // Only the latest of several writes is seen
+    seqLock.write(6);
+    seqLock.write(7);
+    EXPECT_TRUE(seqLock.read(value, lastSequence));
+    EXPECT_EQ(value, 7U);
+
+    // An unconditional read always copies out the latest value
+    value = 0;
+    seqLock.read(value);
+    EXPECT_EQ(value, 7U);
+}
+
+TEST(SeqLockTest, readerNeverSeesTornValue)
+{
+    // --- SETUP ---
+    SeqLock<Snapshot> seqLock;
+    static const uint32_t NUM_WRITES = 200000;
+
+    // --- TEST EXECUTION ---
+    std::thread writer([&seqLock]() {
+        Snapshot snapshot;
+        for (uint32_t i = 1; i <= NUM_WRITES; ++i)
+        {
+            for (uint32_t j = 0; j < 8; ++j)
+            {
+                snapshot.words[j] = i;
+            }
+            seqLock.write(snapshot);
+        }
+    });
+
+    uint32_t lastSequence = 0;
+    uint32_t lastValue = 0;
+    uint32_t numTorn = 0;
+    uint32_t numOutOfOrder = 0;
+    while (lastValue < NUM_WRITES)
+    {
+        Snapshot snapshot;
+        if (seqLock.read(snapshot, lastSequence))
+        {
+            for (uint32_t j = 1; j < 8; ++j)
+            {
+                if (snapshot.words[j] != snapshot.words[0])
+                {
+                    ++numTorn;
+                }
+            }
+            if (snapshot.words[0] <= lastValue)
+            {
+                ++numOutOfOrder;
+            }
+            lastValue = snapshot.words[0];
+        }
+    }
+    writer.join();
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(numTorn, 0U);
+    EXPECT_EQ(numOutOfOrder, 0U);
+}
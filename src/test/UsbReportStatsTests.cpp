@@ -0,0 +1,67 @@
+#include "UsbReportStats.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(UsbReportStatsTest, reportsSentOnTimeAreNeverLate)
+{
+    // --- SETUP ---
+    UsbReportStats stats;
+
+    // --- TEST EXECUTION ---
+    stats.recordFlush(true, true, 10);
+    stats.recordFlush(true, true, 11);
+    stats.recordFlush(true, true, 12);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(stats.getCounts().numSent, 3U);
+    EXPECT_EQ(stats.getCounts().numDeferred, 0U);
+    EXPECT_EQ(stats.getCounts().maxFramesDeferred, 0U);
+}
+
+TEST(UsbReportStatsTest, deferredReportCountsFramesFromFirstDeferral)
+{
+    // --- SETUP ---
+    UsbReportStats stats;
+
+    // --- TEST EXECUTION ---
+    stats.recordFlush(false, true, 20);
+    stats.recordFlush(false, true, 21);
+    stats.recordFlush(true, true, 23);
+    // A shorter wait afterwards doesn't lower the maximum
+    stats.recordFlush(false, true, 30);
+    stats.recordFlush(true, true, 31);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(stats.getCounts().numSent, 2U);
+    EXPECT_EQ(stats.getCounts().numDeferred, 3U);
+    EXPECT_EQ(stats.getCounts().maxFramesDeferred, 3U);
+}
+
+TEST(UsbReportStatsTest, frameNumberWrapIsHandled)
+{
+    // --- SETUP ---
+    UsbReportStats stats;
+
+    // --- TEST EXECUTION ---
+    // Frame numbers are 11 bits, so 0x7FE is followed by 0x7FF, 0x000, 0x001
+    stats.recordFlush(false, true, 0x7FE);
+    stats.recordFlush(true, true, 0x001);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(stats.getCounts().maxFramesDeferred, 3U);
+}
+
+TEST(UsbReportStatsTest, unsentReportWhileDisconnectedIsNotDeferred)
+{
+    // --- SETUP ---
+    UsbReportStats stats;
+
+    // --- TEST EXECUTION ---
+    stats.recordFlush(false, false, 100);
+    stats.recordFlush(true, true, 500);
+
+    // --- EXPECTATIONS ---
+    EXPECT_EQ(stats.getCounts().numSent, 1U);
+    EXPECT_EQ(stats.getCounts().numDeferred, 0U);
+    EXPECT_EQ(stats.getCounts().maxFramesDeferred, 0U);
+}
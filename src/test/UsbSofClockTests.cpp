@@ -0,0 +1,61 @@
+#include "UsbSofClock.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(UsbSofClockTest, lateObservationsFollowEarliest)
+{
+    // --- SETUP ---
+    UsbSofClock clock;
+    uint64_t sofTimeUs = 0;
+
+    // --- TEST EXECUTION / EXPECTATIONS ---
+    EXPECT_FALSE(clock.getFrameStart(5000, sofTimeUs));
+
+    clock.frameStarted(2046, 5030);
+    ASSERT_TRUE(clock.getFrameStart(5100, sofTimeUs));
+    EXPECT_EQ(sofTimeUs, 5030U);
+
+    // An earlier observation is closer to the truth
+    clock.frameStarted(2047, 6005);
+    ASSERT_TRUE(clock.getFrameStart(6100, sofTimeUs));
+    EXPECT_EQ(sofTimeUs, 6005U);
+
+    // A late one only nudges the estimate, even across a wrapped frame number
+    clock.frameStarted(2, 9005 + 32);
+    ASSERT_TRUE(clock.getFrameStart(9100, sofTimeUs));
+    EXPECT_EQ(sofTimeUs, 9005U + 2);
+
+    // Stale once frames stop arriving
+    EXPECT_FALSE(clock.getFrameStart(9007 + 4000, sofTimeUs));
+    clock.framesStopped();
+    EXPECT_FALSE(clock.getFrameStart(9100, sofTimeUs));
+}
+
+TEST(UsbSofClockTest, alignToFrame)
+{
+    EXPECT_EQ(UsbSofClock::alignToFrame(5000, 5000, 300), 5700U);
+    EXPECT_EQ(UsbSofClock::alignToFrame(5000, 5701, 300), 6700U);
+    EXPECT_EQ(UsbSofClock::alignToFrame(9000, 2100, 300), 2700U);
+    EXPECT_EQ(UsbSofClock::timeToNextFrame(5000, 7999), 1U);
+    EXPECT_EQ(UsbSofClock::timeToNextFrame(5000, 8000), 0U);
+}
+
+TEST(FramePhaseMonitorTest, eachMeasurementIsPublished)
+{
+    // --- SETUP ---
+    FramePhaseMonitor monitor;
+    FramePhaseStats stats;
+
+    // --- TEST EXECUTION / EXPECTATIONS ---
+    monitor.read(stats);
+    EXPECT_EQ(stats.numSamples, 0U);
+
+    monitor.record(300, 250);
+    monitor.record(200, 250);
+    monitor.read(stats);
+    EXPECT_EQ(stats.numSamples, 2U);
+    EXPECT_EQ(stats.numOnTime, 1U);
+    EXPECT_EQ(stats.minLeadUs, 200U);
+    EXPECT_EQ(stats.maxLeadUs, 300U);
+    EXPECT_EQ(stats.totalLeadUs, 500U);
+}
@@ -18,4 +18,11 @@ class MockedDreamcastPeripheral : public DreamcastPeripheral
                     (override));
 
         MOCK_METHOD(bool, task, (uint64_t currentTimeUs), (override));
+
+        MOCK_METHOD(uint64_t, getNextDueTime, (), (const, override));
+
+        MOCK_METHOD(void,
+                    transactionComplete,
+                    (Status status, const uint32_t* response, uint32_t len),
+                    (override));
 };
@@ -5,6 +5,20 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+//! Matches a MapleEncodedPacket by its frame word
+MATCHER_P(EncodedFrameWordIs, frameWord, "")
+{
+    return (arg.getFrameWord() == static_cast<uint32_t>(frameWord));
+}
+
+//! Matches a MapleTransaction by its packet's frame word and its observer
+MATCHER_P2(TransactionIs, frameWord, observer, "")
+{
+    return (arg.packet != NULL
+            && arg.packet->getFrameWord() == static_cast<uint32_t>(frameWord)
+            && arg.observer == observer);
+}
+
 class MockedMapleBus : public MapleBusInterface
 {
     public:
@@ -31,6 +45,29 @@ class MockedMapleBus : public MapleBusInterface
             return write(command, recipientAddr, payload, len, expectResponse, DEFAULT_MAPLE_READ_TIMEOUT_US);
         }
 
+        MOCK_METHOD(
+            bool,
+            write,
+            (
+                uint8_t command,
+                uint8_t recipientAddr,
+                const MapleCodec::Segment* segments,
+                uint8_t numSegments,
+                bool expectResponse,
+                uint32_t readTimeoutUs
+            ),
+            (override)
+        );
+
+        bool write(uint8_t command,
+                   uint8_t recipientAddr,
+                   const MapleCodec::Segment* segments,
+                   uint8_t numSegments,
+                   bool expectResponse)
+        {
+            return write(command, recipientAddr, segments, numSegments, expectResponse, DEFAULT_MAPLE_READ_TIMEOUT_US);
+        }
+
         MOCK_METHOD(
             bool,
             write,
@@ -71,13 +108,36 @@ class MockedMapleBus : public MapleBusInterface
             return write(words, len, expectResponse, DEFAULT_MAPLE_READ_TIMEOUT_US);
         }
 
+        MOCK_METHOD(
+            bool,
+            write,
+            (
+                const MapleEncodedPacket& packet,
+                bool expectResponse,
+                uint32_t readTimeoutUs
+            ),
+            (override)
+        );
+
+        bool write(const MapleEncodedPacket& packet,
+                   bool expectResponse)
+        {
+            return write(packet, expectResponse, DEFAULT_MAPLE_READ_TIMEOUT_US);
+        }
+
+        MOCK_METHOD(bool, submit, (const MapleTransaction& transaction), (override));
+
+        MOCK_METHOD(void, cancel, (const MapleTransactionObserver* observer), (override));
+
+        MOCK_METHOD(void, reserve, (uint64_t timeUs), (override));
+
         MOCK_METHOD(const uint32_t*, getReadData, (uint32_t& len, bool& newData), (override));
 
-        MOCK_METHOD(void, processEvents, (uint64_t currentTimeUs), (override));
+        MOCK_METHOD(uint32_t, processEvents, (uint64_t currentTimeUs), (override));
 
-        void processEvents()
+        uint32_t processEvents()
         {
-            processEvents(0);
+            return processEvents(0);
         }
 
         MOCK_METHOD(bool, isBusy, (), (override));